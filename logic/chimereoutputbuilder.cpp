@@ -1,6 +1,7 @@
 #include "chimereoutputbuilder.h"
 
-#include "emap/emissions.h"
+#include "emap/pointsourcetable.h"
+#include "emap/sparseraster.h"
 #include "infra/cast.h"
 #include "infra/conversion.h"
 #include "outputwriters.h"
@@ -35,7 +36,7 @@ Cell ChimereOutputBuilder::coordinate_to_chimere_cell(const inf::Point<double>&
     return Cell(_meta.rows - gridCell.r, gridCell.c + 1);
 }
 
-void ChimereOutputBuilder::add_point_output_entry(const EmissionEntry& emission)
+void ChimereOutputBuilder::add_point_output_entry(const PointSourceRow& emission)
 {
     assert(emission.coordinate().has_value());
     assert(emission.value().amount().has_value());
@@ -87,6 +88,41 @@ void ChimereOutputBuilder::add_diffuse_output_entry(const EmissionIdentifier& id
     _diffuseSources[id.pollutant][mappedCountry][chimereCell][mappedSectorName] += emission * 1000.0;
 }
 
+void ChimereOutputBuilder::add_diffuse_output_entries(const EmissionIdentifier& id, const SparseRaster& emissions)
+{
+    assert(id.sector.type() == EmissionSector::Type::Nfr);
+    const auto& meta = emissions.metadata();
+
+    // Convert the cells before taking the lock
+    std::vector<std::pair<Cell, double>> cellValues;
+    cellValues.reserve(emissions.size());
+    for (size_t i = 0; i < emissions.size(); ++i) {
+        if (emissions.value(i) == 0.0) {
+            continue;
+        }
+
+        const auto cellCenter = meta.convert_cell_centre_to_xy(emissions.cell(i));
+        const Point<double> loc(cellCenter.x, cellCenter.y);
+        if (_meta.is_on_map(loc)) {
+            cellValues.emplace_back(coordinate_to_chimere_cell(loc), emissions.value(i) * 1000.0);
+        }
+    }
+
+    if (cellValues.empty()) {
+        return;
+    }
+
+    // Only look up the mapping when there are cells on the map, like the single entry variant
+    const auto mappedSectorName = _cfg.sectors().map_nfr_to_output_name(id.sector.nfr_sector());
+    const auto mappedCountry    = _countryMapping.at(id.country.id());
+
+    std::scoped_lock lock(_mutex);
+    auto& cellData = _diffuseSources[id.pollutant][mappedCountry];
+    for (const auto& [cell, emission] : cellValues) {
+        cellData[cell][mappedSectorName] += emission;
+    }
+}
+
 static std::string_view grid_resolution_string(ModelGrid grid)
 {
     switch (grid) {
@@ -20,8 +20,9 @@ public:
                          std::unordered_map<CountryId, int32_t> countryMapping,
                          const RunConfiguration& cfg);
 
-    void add_point_output_entry(const EmissionEntry& emission) override;
+    void add_point_output_entry(const PointSourceRow& emission) override;
     void add_diffuse_output_entry(const EmissionIdentifier& id, inf::Point<double> loc, double emission, int32_t cellSizeInM) override;
+    void add_diffuse_output_entries(const EmissionIdentifier& id, const SparseRaster& emissions) override;
 
     void flush_pollutant(const Pollutant& pol, WriteMode mode) override;
     void flush(WriteMode mode) override;
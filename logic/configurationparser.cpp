@@ -1,20 +1,22 @@
 ﻿#include "emap/configurationparser.h"
 
+#include "infra/algo.h"
 #include "infra/cast.h"
 #include "infra/exception.h"
-#include "infra/gdal.h"
 #include "infra/log.h"
 #include "infra/string.h"
+#include "xlsxreader.h"
 
 #include <cassert>
 #include <filesystem>
+#include <optional>
 #include <toml++/toml.h>
+#include <unordered_set>
 
 namespace emap {
 
 using namespace inf;
 using namespace std::string_view_literals;
-namespace gdal = inf::gdal;
 
 static EmissionDestination emission_destination_from_string(std::string_view str)
 {
@@ -54,94 +56,104 @@ SectorParameterConfiguration parse_sector_parameters_config(const fs::path& diff
 {
     SectorParameterConfiguration result;
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds    = gdal::VectorDataSet::open(diffuseParametersPath);
-    auto layer = ds.layer(layer_name_for_sector_level(level, outputSectorLevelName));
-
-    const auto colPollutant = layer.layer_definition().required_field_index("Pollutant");
-    const auto colSector    = layer.layer_definition().required_field_index("Sector");
-    const auto colHc        = layer.layer_definition().required_field_index("hc(MW)");
-    const auto colH         = layer.layer_definition().required_field_index("h(m)");
-    const auto colS         = layer.layer_definition().required_field_index("s(m)");
-    const auto colTb        = layer.layer_definition().required_field_index("tb");
-    const auto colId        = layer.layer_definition().required_field_index("Id");
-
-    for (const auto& feature : layer) {
-        if (!feature.field_is_valid(0)) {
-            break; // abort on empty lines
-        }
+    xl::WorkBookReader workbook(diffuseParametersPath);
+
+    int32_t colPollutant = -1, colSector = -1, colHc = -1, colH = -1, colS = -1, colTb = -1, colId = -1;
+    int32_t lastRowNr = 0;
+    bool endOfTable   = false;
+
+    workbook.read_sheet(
+        layer_name_for_sector_level(level, outputSectorLevelName),
+        [&](const xl::Row& header) {
+            colPollutant = xl::required_column_index(header, "Pollutant");
+            colSector    = xl::required_column_index(header, "Sector");
+            colHc        = xl::required_column_index(header, "hc(MW)");
+            colH         = xl::required_column_index(header, "h(m)");
+            colS         = xl::required_column_index(header, "s(m)");
+            colTb        = xl::required_column_index(header, "tb");
+            colId        = xl::required_column_index(header, "Id");
+            lastRowNr    = header.row_number();
+        },
+        [&](const xl::Row& row) {
+            // abort on empty lines, empty rows are not present in the sheet so a gap in the row numbers is an empty line
+            endOfTable = endOfTable || row.is_empty(0) || row.row_number() != lastRowNr + 1;
+            lastRowNr  = row.row_number();
+            if (endOfTable) {
+                return;
+            }
 
-        SectorParameters config;
-        config.hc_MW = feature.field_as<double>(colHc);
-        config.h_m   = feature.field_as<double>(colH);
-        config.s_m   = feature.field_as<double>(colS);
-        config.tb    = feature.field_as<double>(colTb);
-        config.id    = feature.field_as<int32_t>(colId);
-
-        std::string sectorName(feature.field_as<std::string_view>(colSector));
-        auto pollutantName = feature.field_as<std::string_view>(colPollutant);
-        if (str::trimmed_view(pollutantName) == "*") {
-            result.add_parameter(sectorName, config);
-        } else {
-            result.add_pollutant_specific_parameter(sectorName, polInv.pollutant_from_string(pollutantName), config);
-        }
-    }
+            SectorParameters config;
+            config.hc_MW = row.as_double(colHc).value_or(0.0);
+            config.h_m   = row.as_double(colH).value_or(0.0);
+            config.s_m   = row.as_double(colS).value_or(0.0);
+            config.tb    = row.as_double(colTb).value_or(0.0);
+            config.id    = xl::required_int(row, colId);
+
+            std::string sectorName(row.as_string_view(colSector));
+            auto pollutantName = row.as_string_view(colPollutant);
+            if (str::trimmed_view(pollutantName) == "*") {
+                result.add_parameter(sectorName, config);
+            } else {
+                result.add_pollutant_specific_parameter(sectorName, polInv.pollutant_from_string(pollutantName), config);
+            }
+        });
 
     return result;
 }
 
-CountryInventory parse_countries(const fs::path& countriesSpec)
+static CountryInventory parse_countries(const xl::WorkBookReader& workbook)
 {
     std::vector<Country> countries;
-    InputConversions conversions;
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds = gdal::VectorDataSet::open(countriesSpec);
-
-    {
-        auto layer = ds.layer("country");
-
-        const auto colIsoCode = layer.layer_definition().required_field_index("country_iso_code");
-        const auto colLabel   = layer.layer_definition().required_field_index("country_label");
-        const auto colNumber  = layer.layer_definition().required_field_index("country_number");
-        const auto colType    = layer.layer_definition().required_field_index("type");
-
-        for (const auto& feature : layer) {
-            if (!feature.field_is_valid(0)) {
-                continue; // skip empty lines
+    int32_t colIsoCode = -1, colLabel = -1, colNumber = -1, colType = -1;
+    workbook.read_sheet(
+        "country",
+        [&](const xl::Row& header) {
+            colIsoCode = xl::required_column_index(header, "country_iso_code");
+            colLabel   = xl::required_column_index(header, "country_label");
+            colNumber  = xl::required_column_index(header, "country_number");
+            colType    = xl::required_column_index(header, "type");
+        },
+        [&](const xl::Row& row) {
+            if (row.is_empty(0)) {
+                return; // skip empty lines
             }
 
-            countries.emplace_back(CountryId(feature.field_as<int32_t>(colNumber)),
-                                   feature.field_as<std::string_view>(colIsoCode),
-                                   feature.field_as<std::string_view>(colLabel),
-                                   str::iequals(feature.field_as<std::string_view>(colType), "land"));
-        }
-    }
+            countries.emplace_back(CountryId(xl::required_int(row, colNumber)),
+                                   row.as_string_view(colIsoCode),
+                                   row.as_string_view(colLabel),
+                                   str::iequals(row.as_string_view(colType), "land"));
+        });
 
     return CountryInventory(std::move(countries));
 }
 
-static std::vector<IgnoredName> parse_ignore_list(const fs::path& ignoreSpec, const std::string& tab, const CountryInventory& countries)
+CountryInventory parse_countries(const fs::path& countriesSpec)
 {
-    std::vector<IgnoredName> ignored;
-
-    if (fs::is_regular_file(ignoreSpec)) {
-        CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-        auto ds    = gdal::VectorDataSet::open(ignoreSpec);
-        auto layer = ds.layer(tab);
+    return parse_countries(xl::WorkBookReader(countriesSpec));
+}
 
-        auto colExceptions = layer.layer_definition().field_index("country_exceptions");
+// The workbook is optional, no names are ignored when it is not present
+static std::vector<IgnoredName> parse_ignore_list(const xl::WorkBookReader* workbook, const std::string& tab, const CountryInventory& countries)
+{
+    std::vector<IgnoredName> ignored;
 
-        // When no ignores are present, gdal gets confused and does not recognise the header
-        if (const auto colName = layer.layer_definition().field_index("names"); colName >= 0) {
-            for (const auto& feature : layer) {
-                if (!feature.field_is_valid(0)) {
-                    continue; // skip empty lines
+    if (workbook != nullptr) {
+        int32_t colName = -1, colExceptions = -1;
+        workbook->read_sheet(
+            tab,
+            [&](const xl::Row& header) {
+                colName       = xl::column_index(header, "names");
+                colExceptions = xl::column_index(header, "country_exceptions");
+            },
+            [&](const xl::Row& row) {
+                if (colName < 0 || row.is_empty(0)) {
+                    return; // skip empty lines
                 }
 
                 std::unordered_set<CountryId> countryExceptions;
                 if (colExceptions >= 0) {
-                    auto ignoredCountries = str::trimmed_view(feature.field_as<std::string_view>(colExceptions));
+                    auto ignoredCountries = str::trimmed_view(row.as_string_view(colExceptions));
                     if (!ignoredCountries.empty()) {
                         for (auto country : str::split_view(ignoredCountries, ';')) {
                             countryExceptions.emplace(countries.country_from_string(country).id());
@@ -149,18 +161,26 @@ static std::vector<IgnoredName> parse_ignore_list(const fs::path& ignoreSpec, co
                     }
                 }
 
-                ignored.emplace_back(IgnoredName(feature.field_as<std::string_view>(colName), countryExceptions));
-            }
-        }
+                ignored.emplace_back(IgnoredName(row.as_string_view(colName), countryExceptions));
+            });
     }
 
     return ignored;
 }
 
-SectorInventory parse_sectors(const fs::path& sectorSpec,
-                              const fs::path& conversionSpec,
-                              const fs::path& ignoreSpec,
-                              const CountryInventory& countries)
+static std::optional<xl::WorkBookReader> open_optional_workbook(const fs::path& path)
+{
+    if (fs::is_regular_file(path)) {
+        return xl::WorkBookReader(path);
+    }
+
+    return {};
+}
+
+static SectorInventory parse_sectors(const xl::WorkBookReader& sectorWorkbook,
+                                     const xl::WorkBookReader& conversionWorkbook,
+                                     const xl::WorkBookReader* ignoreWorkbook,
+                                     const CountryInventory& countries)
 {
     std::vector<GnfrSector> gnfrSectors;
     std::vector<NfrSector> nfrSectors;
@@ -168,157 +188,166 @@ SectorInventory parse_sectors(const fs::path& sectorSpec,
     InputConversions gnfrConversions;
     InputConversions nfrConversions;
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds = gdal::VectorDataSet::open(sectorSpec);
-
     {
-        auto layer = ds.layer("GNFR");
-
-        const auto colNumber = layer.layer_definition().required_field_index("GNFR_number");
-        const auto colLabel  = layer.layer_definition().required_field_index("GNFR_label");
-        const auto colCode   = layer.layer_definition().required_field_index("GNFR_code");
-        const auto colType   = layer.layer_definition().required_field_index("type");
-
-        for (const auto& feature : layer) {
-            if (!feature.field_is_valid(0)) {
-                continue; // skip empty lines
-            }
+        int32_t colNumber = -1, colLabel = -1, colCode = -1, colType = -1;
+        sectorWorkbook.read_sheet(
+            "GNFR",
+            [&](const xl::Row& header) {
+                colNumber = xl::required_column_index(header, "GNFR_number");
+                colLabel  = xl::required_column_index(header, "GNFR_label");
+                colCode   = xl::required_column_index(header, "GNFR_code");
+                colType   = xl::required_column_index(header, "type");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
+                }
 
-            gnfrSectors.emplace_back(feature.field_as<std::string_view>(colLabel),
-                                     GnfrId(feature.field_as<int32_t>(colNumber)),
-                                     feature.field_as<std::string_view>(colCode),
-                                     "",
-                                     emission_destination_from_string(feature.field_as<std::string_view>(colType)));
-        }
+                gnfrSectors.emplace_back(row.as_string_view(colLabel),
+                                         GnfrId(xl::required_int(row, colNumber)),
+                                         row.as_string_view(colCode),
+                                         "",
+                                         emission_destination_from_string(row.as_string_view(colType)));
+            });
     }
 
     {
-        auto layer = ds.layer("NFR");
-
-        const auto colCode        = layer.layer_definition().required_field_index("NFR_code");
-        const auto colNumber      = layer.layer_definition().required_field_index("NFR_number");
-        const auto colDescription = layer.layer_definition().required_field_index("NFR_description");
-        const auto colType        = layer.layer_definition().required_field_index("type");
-        const auto colGnfr        = layer.layer_definition().required_field_index("GNFR");
-
-        for (const auto& feature : layer) {
-            if (!feature.field_is_valid(0)) {
-                continue; // skip empty lines
-            }
+        int32_t colCode = -1, colNumber = -1, colDescription = -1, colType = -1, colGnfr = -1;
+        sectorWorkbook.read_sheet(
+            "NFR",
+            [&](const xl::Row& header) {
+                colCode        = xl::required_column_index(header, "NFR_code");
+                colNumber      = xl::required_column_index(header, "NFR_number");
+                colDescription = xl::required_column_index(header, "NFR_description");
+                colType        = xl::required_column_index(header, "type");
+                colGnfr        = xl::required_column_index(header, "GNFR");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
+                }
 
-            const auto nfrCode  = feature.field_as<std::string_view>(colCode);
-            const auto gnfrName = feature.field_as<std::string_view>(colGnfr);
+                const auto nfrCode  = row.as_string_view(colCode);
+                const auto gnfrName = row.as_string_view(colGnfr);
 
-            const auto* gnfrSector = find_in_container(gnfrSectors, [=](const GnfrSector& sector) {
-                return sector.name() == gnfrName;
-            });
+                const auto* gnfrSector = find_in_container(gnfrSectors, [=](const GnfrSector& sector) {
+                    return sector.name() == gnfrName;
+                });
 
-            if (gnfrSector == nullptr) {
-                throw RuntimeError("Invalid GNFR sector ('{}') configured for NFR sector '{}'", feature.field_as<std::string_view>(colGnfr), nfrCode);
-            }
+                if (gnfrSector == nullptr) {
+                    throw RuntimeError("Invalid GNFR sector ('{}') configured for NFR sector '{}'", gnfrName, nfrCode);
+                }
 
-            const auto destination = emission_destination_from_string(feature.field_as<std::string_view>(colType));
+                const auto destination = emission_destination_from_string(row.as_string_view(colType));
 
-            nfrSectors.emplace_back(nfrCode, NfrId(feature.field_as<int32_t>(colNumber)), *gnfrSector, feature.field_as<std::string_view>(colDescription), destination);
-        }
+                nfrSectors.emplace_back(nfrCode, NfrId(xl::required_int(row, colNumber)), *gnfrSector, row.as_string_view(colDescription), destination);
+            });
     }
 
     {
-        auto ds = gdal::VectorDataSet::open(conversionSpec);
-
-        {
-            auto layer = ds.layer("gnfr");
-
-            const auto colCode = layer.layer_definition().required_field_index("GNFR_code");
-            const auto colName = layer.layer_definition().required_field_index("GNFR_names");
-
-            for (const auto& feature : layer) {
-                if (!feature.field_is_valid(0)) {
-                    continue; // skip empty lines
+        int32_t colCode = -1, colName = -1;
+        conversionWorkbook.read_sheet(
+            "gnfr",
+            [&](const xl::Row& header) {
+                colCode = xl::required_column_index(header, "GNFR_code");
+                colName = xl::required_column_index(header, "GNFR_names");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
                 }
 
-                gnfrConversions.add_conversion(feature.field_as<std::string_view>(colCode), feature.field_as<std::string_view>(colName), {});
-            }
-        }
+                gnfrConversions.add_conversion(row.as_string_view(colCode), row.as_string_view(colName), {});
+            });
     }
 
     {
-        auto ds = gdal::VectorDataSet::open(conversionSpec);
-
-        {
-            auto layer = ds.layer("nfr");
-
-            const auto colCode     = layer.layer_definition().required_field_index("NFR_code");
-            const auto colName     = layer.layer_definition().required_field_index("NFR_names");
-            const auto colPriority = layer.layer_definition().required_field_index("NFR_priority");
-
-            for (const auto& feature : layer) {
-                if (!feature.field_is_valid(0)) {
-                    continue; // skip empty lines
+        int32_t colCode = -1, colName = -1, colPriority = -1;
+        conversionWorkbook.read_sheet(
+            "nfr",
+            [&](const xl::Row& header) {
+                colCode     = xl::required_column_index(header, "NFR_code");
+                colName     = xl::required_column_index(header, "NFR_names");
+                colPriority = xl::required_column_index(header, "NFR_priority");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
                 }
 
-                nfrConversions.add_conversion(feature.field_as<std::string_view>(colCode), feature.field_as<std::string_view>(colName), feature.field_as<int32_t>(colPriority));
-            }
-        }
+                nfrConversions.add_conversion(row.as_string_view(colCode), row.as_string_view(colName), row.as_int(colPriority).value_or(0));
+            });
     }
 
-    auto ignoredNfrSectors  = parse_ignore_list(ignoreSpec, "nfr", countries);
-    auto ignoredGnfrSectors = parse_ignore_list(ignoreSpec, "gnfr", countries);
+    auto ignoredNfrSectors  = parse_ignore_list(ignoreWorkbook, "nfr", countries);
+    auto ignoredGnfrSectors = parse_ignore_list(ignoreWorkbook, "gnfr", countries);
 
     return SectorInventory(std::move(gnfrSectors), std::move(nfrSectors),
                            std::move(gnfrConversions), std::move(nfrConversions),
                            std::move(ignoredGnfrSectors), std::move(ignoredNfrSectors));
 }
 
-PollutantInventory parse_pollutants(const fs::path& pollutantSpec,
-                                    const fs::path& conversionSpec,
-                                    const fs::path& ignoreSpec,
-                                    const CountryInventory& countries)
+SectorInventory parse_sectors(const fs::path& sectorSpec,
+                              const fs::path& conversionSpec,
+                              const fs::path& ignoreSpec,
+                              const CountryInventory& countries)
+{
+    const auto ignoreWorkbook = open_optional_workbook(ignoreSpec);
+    return parse_sectors(xl::WorkBookReader(sectorSpec), xl::WorkBookReader(conversionSpec), ignoreWorkbook ? &(*ignoreWorkbook) : nullptr, countries);
+}
+
+static PollutantInventory parse_pollutants(const xl::WorkBookReader& pollutantWorkbook,
+                                           const xl::WorkBookReader& conversionWorkbook,
+                                           const xl::WorkBookReader* ignoreWorkbook,
+                                           const CountryInventory& countries)
 {
     std::vector<Pollutant> pollutants;
     InputConversions conversions;
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-
     {
-        auto ds = gdal::VectorDataSet::open(pollutantSpec);
-
-        {
-            auto layer = ds.layer("pollutant");
-
-            const auto colCode  = layer.layer_definition().required_field_index("pollutant_code");
-            const auto colLabel = layer.layer_definition().required_field_index("pollutant_label");
-
-            for (const auto& feature : layer) {
-                if (!feature.field_is_valid(0)) {
-                    continue; // skip empty lines
+        int32_t colCode = -1, colLabel = -1;
+        pollutantWorkbook.read_sheet(
+            "pollutant",
+            [&](const xl::Row& header) {
+                colCode  = xl::required_column_index(header, "pollutant_code");
+                colLabel = xl::required_column_index(header, "pollutant_label");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
                 }
 
-                pollutants.emplace_back(feature.field_as<std::string_view>(colCode), feature.field_as<std::string_view>(colLabel));
-            }
-        }
+                pollutants.emplace_back(row.as_string_view(colCode), row.as_string_view(colLabel));
+            });
     }
 
     {
-        auto ds = gdal::VectorDataSet::open(conversionSpec);
-
-        {
-            auto layer = ds.layer("pollutant");
-
-            const auto colCode = layer.layer_definition().required_field_index("pollutant_code");
-            const auto colName = layer.layer_definition().required_field_index("pollutant_names");
-
-            for (const auto& feature : layer) {
-                if (!feature.field_is_valid(0)) {
-                    continue; // skip empty lines
+        int32_t colCode = -1, colName = -1;
+        conversionWorkbook.read_sheet(
+            "pollutant",
+            [&](const xl::Row& header) {
+                colCode = xl::required_column_index(header, "pollutant_code");
+                colName = xl::required_column_index(header, "pollutant_names");
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(0)) {
+                    return; // skip empty lines
                 }
 
-                conversions.add_conversion(feature.field_as<std::string_view>(colCode), feature.field_as<std::string_view>(colName), {});
-            }
-        }
+                conversions.add_conversion(row.as_string_view(colCode), row.as_string_view(colName), {});
+            });
     }
 
-    return PollutantInventory(std::move(pollutants), std::move(conversions), parse_ignore_list(ignoreSpec, "pollutant", countries));
+    return PollutantInventory(std::move(pollutants), std::move(conversions), parse_ignore_list(ignoreWorkbook, "pollutant", countries));
+}
+
+PollutantInventory parse_pollutants(const fs::path& pollutantSpec,
+                                    const fs::path& conversionSpec,
+                                    const fs::path& ignoreSpec,
+                                    const CountryInventory& countries)
+{
+    const auto ignoreWorkbook = open_optional_workbook(ignoreSpec);
+    return parse_pollutants(xl::WorkBookReader(pollutantSpec), xl::WorkBookReader(conversionSpec), ignoreWorkbook ? &(*ignoreWorkbook) : nullptr, countries);
 }
 
 std::unordered_map<NfrId, std::string> parse_sector_mapping(const fs::path& mappingSpec, const SectorInventory& inv, const std::string& outputLevel)
@@ -327,25 +356,27 @@ std::unordered_map<NfrId, std::string> parse_sector_mapping(const fs::path& mapp
 
     // No mapping needed when output level is NFR
     if (!str::iequals(outputLevel, "NFR")) {
-        CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-        auto ds    = gdal::VectorDataSet::open(mappingSpec);
-        auto layer = ds.layer(0);
-
-        const auto colNfr    = layer.layer_definition().required_field_index("NFR_code");
-        const auto colMapped = layer.layer_definition().required_field_index(outputLevel);
-
-        for (const auto& feature : layer) {
-            if (!feature.field_is_valid(colNfr)) {
-                continue; // skip empty lines
-            }
+        xl::WorkBookReader workbook(mappingSpec);
+
+        int32_t colNfr = -1, colMapped = -1;
+        workbook.read_sheet(
+            0,
+            [&](const xl::Row& header) {
+                colNfr    = xl::required_column_index(header, "NFR_code");
+                colMapped = xl::required_column_index(header, outputLevel);
+            },
+            [&](const xl::Row& row) {
+                if (row.is_empty(colNfr)) {
+                    return; // skip empty lines
+                }
 
-            auto nfrSector = inv.try_nfr_sector_from_string(feature.field_as<std::string_view>(colNfr));
-            if (nfrSector.has_value()) {
-                result.emplace(nfrSector->id(), feature.field_as<std::string_view>(colMapped));
-            } else {
-                Log::warn("Unknown nfr id present in mapping file: {}", feature.field_as<std::string_view>(colNfr));
-            }
-        }
+                auto nfrSector = inv.try_nfr_sector_from_string(row.as_string_view(colNfr));
+                if (nfrSector.has_value()) {
+                    result.emplace(nfrSector->id(), row.as_string_view(colMapped));
+                } else {
+                    Log::warn("Unknown nfr id present in mapping file: {}", row.as_string_view(colNfr));
+                }
+            });
     }
 
     return result;
@@ -357,31 +388,32 @@ void parse_missing_pollutant_references(const fs::path& path, PollutantInventory
         return;
     }
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
+    xl::WorkBookReader workbook(path);
 
-    auto ds    = gdal::VectorDataSet::open(path);
-    auto layer = ds.layer(0);
-
-    const auto colCode      = layer.layer_definition().required_field_index("pollutant_code");
-    const auto colReference = layer.layer_definition().required_field_index("reference_pollutant_code");
+    int32_t colCode = -1, colReference = -1;
+    workbook.read_sheet(
+        0,
+        [&](const xl::Row& header) {
+            colCode      = xl::required_column_index(header, "pollutant_code");
+            colReference = xl::required_column_index(header, "reference_pollutant_code");
+        },
+        [&](const xl::Row& row) {
+            if (row.is_empty(0)) {
+                return; // skip empty lines
+            }
 
-    for (const auto& feature : layer) {
-        if (!feature.field_is_valid(0)) {
-            continue; // skip empty lines
-        }
+            try {
+                auto pollutant          = inv.pollutant_from_string(row.as_string_view(colCode));
+                auto referencePollutant = inv.pollutant_from_string(row.as_string_view(colReference));
 
-        try {
-            auto pollutant          = inv.pollutant_from_string(feature.field_as<std::string_view>(colCode));
-            auto referencePollutant = inv.pollutant_from_string(feature.field_as<std::string_view>(colReference));
+                if (pollutant.code() != referencePollutant.code()) {
+                    inv.add_fallback_for_pollutant(pollutant, referencePollutant);
+                }
 
-            if (pollutant.code() != referencePollutant.code()) {
-                inv.add_fallback_for_pollutant(pollutant, referencePollutant);
+            } catch (const std::exception& e) {
+                Log::warn("Error parsing pollutant reference when missing: {}", e.what());
             }
-
-        } catch (const std::exception& e) {
-            Log::warn("Error parsing pollutant reference when missing: {}", e.what());
-        }
-    }
+        });
 }
 
 struct NamedSection
@@ -597,6 +629,50 @@ static std::string read_string(const NamedSection& ns, std::string_view name, st
     return nodeValue.value<std::string>().value();
 }
 
+static RasterCompression raster_compression_from_string(std::string_view compression)
+{
+    if (str::iequals(compression, "none")) {
+        return RasterCompression::None;
+    }
+
+    if (str::iequals(compression, "deflate")) {
+        return RasterCompression::Deflate;
+    }
+
+    if (str::iequals(compression, "zstd")) {
+        return RasterCompression::Zstd;
+    }
+
+    throw RuntimeError("Invalid raster compression: '{}' (possible values: \"none\", \"deflate\", \"zstd\")", compression);
+}
+
+static RasterOutputOptions read_raster_options(const NamedSection& output)
+{
+    RasterOutputOptions options;
+    options.compression    = raster_compression_from_string(read_string(output, "raster_compression", "none"));
+    options.tiled          = output.section["raster_tiled"].value<bool>().value_or(false);
+    options.tileSize       = output.section["raster_tile_size"].value<int32_t>().value_or(256);
+    options.predictor      = output.section["raster_predictor"].value<bool>().value_or(false);
+    options.overviews      = output.section["raster_overviews"].value<bool>().value_or(false);
+    options.cloudOptimized = output.section["cloud_optimized_rasters"].value<bool>().value_or(false);
+
+    if (options.tileSize < 16 || options.tileSize > 4096 || options.tileSize % 16 != 0) {
+        throw RuntimeError("Invalid raster tile size in 'output' section ({}), the tile size should be a multiple of 16 between 16 and 4096", options.tileSize);
+    }
+
+    if (options.predictor && options.compression == RasterCompression::None) {
+        throw RuntimeError("The raster predictor in the 'output' section requires a raster compression (e.g. raster_compression = \"deflate\")");
+    }
+
+    if (options.cloudOptimized) {
+        // the cloud optimized layout is always tiled and contains the overviews
+        options.tiled     = true;
+        options.overviews = true;
+    }
+
+    return options;
+}
+
 static RunConfiguration parse_run_configuration_impl(std::string_view configContents, const fs::path& tomlPath)
 {
     try {
@@ -620,9 +696,15 @@ static RunConfiguration parse_run_configuration_impl(std::string_view configCont
         const auto codeConversionsNumbersPath = parametersPath / "code_conversions.xlsx";
         const auto ignorePath                 = parametersPath / "names_to_be_ignored.xlsx";
 
-        auto countryInventory   = parse_countries(idNumbersPath);
-        auto sectorInventory    = parse_sectors(idNumbersPath, codeConversionsNumbersPath, ignorePath, countryInventory);
-        auto pollutantInventory = parse_pollutants(idNumbersPath, codeConversionsNumbersPath, ignorePath, countryInventory);
+        // Every workbook is opened once, the inventories are parsed from the sheets
+        const xl::WorkBookReader idNumbersWorkbook(idNumbersPath);
+        const xl::WorkBookReader codeConversionsWorkbook(codeConversionsNumbersPath);
+        const auto ignoreWorkbook = open_optional_workbook(ignorePath);
+        const auto* ignoreSheets  = ignoreWorkbook ? &(*ignoreWorkbook) : nullptr;
+
+        auto countryInventory   = parse_countries(idNumbersWorkbook);
+        auto sectorInventory    = parse_sectors(idNumbersWorkbook, codeConversionsWorkbook, ignoreSheets, countryInventory);
+        auto pollutantInventory = parse_pollutants(idNumbersWorkbook, codeConversionsWorkbook, ignoreSheets, countryInventory);
 
         const auto grid                         = read_grid(model.section["grid"].value<std::string_view>());
         const auto scenario                     = read_string(model, "scenario", "");
@@ -645,30 +727,37 @@ static RunConfiguration parse_run_configuration_impl(std::string_view configCont
         outputConfig.createCountryRasters        = output.section["create_country_rasters"].value<bool>().value_or(false);
         outputConfig.createGridRasters           = output.section["create_grid_rasters"].value<bool>().value_or(false);
         outputConfig.createSpatialPatternRasters = output.section["create_spatial_pattern_rasters"].value<bool>().value_or(false);
+        outputConfig.rasterOptions               = read_raster_options(output);
 
         parse_missing_pollutant_references(basePath / dataPath / "03_spatial_disaggregation" / "pollutant_reference_when_missing.xlsx", pollutantInventory);
         sectorInventory.set_output_mapping(parse_sector_mapping(parametersPath / "mapping_sectors.xlsx", sectorInventory, outputConfig.outputLevelName));
 
         const auto optionsSection = table["options"];
         bool validate             = optionsSection["validation"].value_or<bool>(false);
-
-        return RunConfiguration(dataPath,
-                                spatialPatternExceptionsPath,
-                                emissionScalingsPath,
-                                boundariesPath,
-                                boundariesEezPath,
-                                grid,
-                                validate ? ValidationType::SumValidation : ValidationType::NoValidation,
-                                year,
-                                reportYear,
-                                scenario,
-                                combinePointSources,
-                                rescaleThreshold,
-                                std::move(includedPollutants),
-                                std::move(sectorInventory),
-                                std::move(pollutantInventory),
-                                std::move(countryInventory),
-                                outputConfig);
+        bool singlePrecision      = optionsSection["single_precision_spatial_patterns"].value_or<bool>(false);
+        bool inventorySnapshot    = optionsSection["emission_inventory_snapshot"].value_or<bool>(false);
+
+        RunConfiguration cfg(dataPath,
+                             spatialPatternExceptionsPath,
+                             emissionScalingsPath,
+                             boundariesPath,
+                             boundariesEezPath,
+                             grid,
+                             validate ? ValidationType::SumValidation : ValidationType::NoValidation,
+                             year,
+                             reportYear,
+                             scenario,
+                             combinePointSources,
+                             rescaleThreshold,
+                             std::move(includedPollutants),
+                             std::move(sectorInventory),
+                             std::move(pollutantInventory),
+                             std::move(countryInventory),
+                             outputConfig);
+
+        cfg.set_single_precision_spatial_patterns(singlePrecision);
+        cfg.set_emission_inventory_snapshot(inventorySnapshot);
+        return cfg;
     } catch (const toml::parse_error& e) {
         if (const auto& errorBegin = e.source().begin; errorBegin) {
             throw RuntimeError("Failed to parse run configuration: {} (line {} column {})", e.description(), errorBegin.line, errorBegin.column);
@@ -4,14 +4,59 @@
 #include "infra/algo.h"
 #include "infra/enumutils.h"
 #include "infra/exception.h"
+#include "infra/hash.h"
+#include "internedstore.h"
 
 #include <algorithm>
 #include <array>
+#include <string>
 
 namespace emap {
 
 using namespace inf;
 
+struct CountryInfo
+{
+    std::string isoCode;
+    std::string label;
+
+    bool operator==(const CountryInfo& other) const noexcept = default;
+};
+
+struct CountryInfoHash
+{
+    size_t operator()(const CountryInfo& info) const noexcept
+    {
+        size_t seed = 0;
+        inf::hash_combine(seed, info.isoCode, info.label);
+        return seed;
+    }
+};
+
+static InternedStore<CountryInfo, CountryInfoHash>& country_info_store()
+{
+    // Function local so the store is available for the countries constructed during static initialization
+    static InternedStore<CountryInfo, CountryInfoHash> store;
+    return store;
+}
+
+Country::Country(CountryId id, std::string_view isoCode, std::string_view label, bool isLand)
+: _id(id)
+, _info(country_info_store().intern(CountryInfo{std::string(isoCode), std::string(label)}))
+, _isLand(isLand)
+{
+}
+
+std::string_view Country::iso_code() const noexcept
+{
+    return country_info_store()[_info].isoCode;
+}
+
+std::string_view Country::full_name() const noexcept
+{
+    return country_info_store()[_info].label;
+}
+
 std::string_view Country::to_string() const noexcept
 {
     return iso_code();
@@ -20,6 +65,10 @@ std::string_view Country::to_string() const noexcept
 CountryInventory::CountryInventory(std::vector<Country> pollutants)
 : _countries(std::move(pollutants))
 {
+    _isoCodeIndex.reserve(_countries.size());
+    for (size_t i = 0; i < _countries.size(); ++i) {
+        _isoCodeIndex.try_emplace(std::string(_countries[i].iso_code()), i);
+    }
 }
 
 Country CountryInventory::country_from_string(std::string_view str) const
@@ -33,11 +82,11 @@ Country CountryInventory::country_from_string(std::string_view str) const
 
 std::optional<Country> CountryInventory::try_country_from_string(std::string_view str) const noexcept
 {
-    const auto* country = find_in_container(_countries, [str](const Country& pol) {
-        return pol.iso_code() == str;
-    });
+    if (auto iter = _isoCodeIndex.find(str); iter != _isoCodeIndex.end()) {
+        return _countries[iter->second];
+    }
 
-    return country ? *country : std::optional<Country>();
+    return {};
 }
 
 size_t CountryInventory::country_count() const noexcept
@@ -6,10 +6,17 @@
 #include "infra/algo.h"
 #include "infra/chrono.h"
 #include "infra/log.h"
+#include "emissioninventorysnapshot.h"
 #include "runsummary.h"
 
+#include <array>
 #include <cassert>
 #include <numeric>
+#include <span>
+#include <unordered_map>
+
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/task_group.h>
 
 namespace emap {
 
@@ -168,24 +175,26 @@ static std::unordered_map<EmissionIdentifier, double> create_nfr_correction_rati
     return result;
 }
 
-// Call the callback with the matching emissions from both arrays
+// Call the callback with the matching emissions from both tables
 template <typename Callback>
-static void zip_point_emissions(std::span<const EmissionEntry> pol1Points, std::span<const EmissionEntry> pol2Points, Callback&& callback)
+static void zip_point_emissions(const PointSourceTable& pol1Points, const PointSourceTable& pol2Points, Callback&& callback)
 {
-    auto pol2PointsCopy = container_as_vector(pol2Points);
-    std::sort(pol2PointsCopy.begin(), pol2PointsCopy.end(), [](const EmissionEntry& entry1, const EmissionEntry& entry2) {
-        return entry1.source_id() < entry2.source_id();
+    // Sort the row indexes instead of copying the rows
+    std::vector<size_t> pol2Order(pol2Points.size());
+    std::iota(pol2Order.begin(), pol2Order.end(), size_t(0));
+    std::sort(pol2Order.begin(), pol2Order.end(), [&pol2Points](size_t index1, size_t index2) {
+        return pol2Points[index1].source_id() < pol2Points[index2].source_id();
     });
 
-    for (auto& pol1Entry : pol1Points) {
+    for (const auto pol1Entry : pol1Points) {
         if (pol1Entry.value().amount().has_value()) {
-            auto iter = std::lower_bound(pol2PointsCopy.begin(), pol2PointsCopy.end(), pol1Entry.source_id(), [](const EmissionEntry& entry, std::string_view srcId) {
-                return entry.source_id() < srcId;
+            auto iter = std::lower_bound(pol2Order.begin(), pol2Order.end(), pol1Entry.source_id(), [&pol2Points](size_t index, std::string_view srcId) {
+                return pol2Points[index].source_id() < srcId;
             });
 
-            if (iter != pol2PointsCopy.end() && iter->source_id() == pol1Entry.source_id()) {
-                assert(iter->coordinate() == pol1Entry.coordinate());
-                callback(pol1Entry, *iter);
+            if (iter != pol2Order.end() && pol2Points[*iter].source_id() == pol1Entry.source_id()) {
+                assert(pol2Points[*iter].coordinate() == pol1Entry.coordinate());
+                callback(pol1Entry, pol2Points[*iter]);
             }
         }
     }
@@ -203,7 +212,7 @@ static void validate_pm10_pm25(const EmissionInventoryEntry& pm10Emissions, cons
         const auto pm10UserScale = pm10Emissions.point_user_scaling_factor();
         const auto pm25UserScale = pm25Emissions.point_user_scaling_factor();
 
-        zip_point_emissions(pm10Emissions.point_emissions(), pm25Emissions.point_emissions(), [diffThreshold, pm10AutoScale, pm25AutoScale, pm10UserScale, pm25UserScale](const EmissionEntry& pm10, const EmissionEntry& pm25) {
+        zip_point_emissions(pm10Emissions.point_emissions(), pm25Emissions.point_emissions(), [diffThreshold, pm10AutoScale, pm25AutoScale, pm10UserScale, pm25UserScale](const PointSourceRow& pm10, const PointSourceRow& pm25) {
             const auto pm10AutoScaled = pm10.value().amount().value() * pm10AutoScale;
             const auto pm25AutoScaled = pm25.value().amount().value() * pm25AutoScale;
             if (pm10AutoScaled < pm25AutoScaled) {
@@ -283,7 +292,7 @@ static void calculate_pmcoarse_emissions(const RunConfiguration& cfg, EmissionIn
                     }
 
                     // Make sure to also add PM2.5 point emissions with value 0 for the PMCoarse calculation
-                    for (const auto& pointEmission : pm10Entry->point_emissions()) {
+                    for (const auto pointEmission : pm10Entry->point_emissions()) {
                         auto pm25Id = pointEmission.id().with_pollutant(*pm25Pol);
                         if (!pm25Entry->has_point_emission(pm25Id, pointEmission.source_id())) {
                             EmissionEntry entry(pm25Id, EmissionValue(0));
@@ -291,14 +300,14 @@ static void calculate_pmcoarse_emissions(const RunConfiguration& cfg, EmissionIn
                             if (pointEmission.coordinate().has_value()) {
                                 entry.set_coordinate(pointEmission.coordinate().value());
                             }
-                            pm25Entry->add_point_emission(std::move(entry));
+                            pm25Entry->add_point_emission(entry);
                         }
                     }
 
                     // Verify pm10 is larger then pm2.5
                     validate_pm10_pm25(*pm10Entry, *pm25Entry);
 
-                    std::vector<EmissionEntry> pmCoarsePoints;
+                    PointSourceTable pmCoarsePoints;
 
                     // Calculate the PMCoarse point sources
                     auto pm10AutoScale = pm10Entry->point_auto_scaling_factor();
@@ -306,14 +315,14 @@ static void calculate_pmcoarse_emissions(const RunConfiguration& cfg, EmissionIn
 
                     auto pm25AutoScale = pm25Entry->point_auto_scaling_factor();
                     auto pm25UserScale = pm25Entry->point_user_scaling_factor();
-                    zip_point_emissions(pm10Entry->point_emissions(), pm25Entry->point_emissions(), [=, &pmCoarsePoints](const EmissionEntry& pm10, const EmissionEntry& pm25) {
+                    zip_point_emissions(pm10Entry->point_emissions(), pm25Entry->point_emissions(), [=, &pmCoarsePoints](const PointSourceRow& pm10, const PointSourceRow& pm25) {
                         try {
                             auto pm10Scaled = *pm10.value().amount() * pm10AutoScale * pm10UserScale;
                             auto pm25Scaled = *pm25.value().amount() * pm25AutoScale * pm25UserScale;
 
                             EmissionEntry entry(EmissionIdentifier(country, pm10.id().sector, *pmCoarsePol), EmissionValue(pm10Scaled - pm25Scaled));
                             entry.set_coordinate(pm10.coordinate().value());
-                            pmCoarsePoints.push_back(std::move(entry));
+                            pmCoarsePoints.push_back(entry);
                         } catch (const std::exception& e) {
                             throw RuntimeError("Sector {} with EIL nr {} ({})", pm10.id().sector, pm10.source_id(), e.what());
                         }
@@ -328,13 +337,32 @@ static void calculate_pmcoarse_emissions(const RunConfiguration& cfg, EmissionIn
                         Log::debug("{} {} PM2.5 value is bigger then PM10 value after scaling: PM2.5={} PM10={}", country.iso_code(), sector.name(), pm25Sum, pm10Sum);
                     }
 
-                    inv.add_emission(EmissionInventoryEntry(pmCoarseId, pmCoarseDiffuse, pmCoarsePoints));
+                    inv.add_emission(EmissionInventoryEntry(pmCoarseId, pmCoarseDiffuse, std::move(pmCoarsePoints)));
                 }
             }
         }
     }
 }
 
+// Groups the emissions with the same id, the collection is sorted on id so every group is a contiguous range
+static std::unordered_map<EmissionKey, std::span<const EmissionEntry>> group_emissions_by_id(const SingleEmissions& emissions)
+{
+    std::unordered_map<EmissionKey, std::span<const EmissionEntry>> result;
+
+    auto iter = emissions.begin();
+    while (iter != emissions.end()) {
+        const auto key = iter->id().key();
+        auto groupEnd  = std::find_if(iter, emissions.end(), [key](const EmissionEntry& em) {
+            return em.id().key() != key;
+        });
+
+        result.emplace(key, std::span<const EmissionEntry>(iter, groupEnd));
+        iter = groupEnd;
+    }
+
+    return result;
+}
+
 static EmissionInventory create_emission_inventory_impl(const SingleEmissions& totalEmissionsNfr,
                                                         const std::optional<SingleEmissions>& extraEmissions,
                                                         const SingleEmissions& pointSourceEmissions,
@@ -345,6 +373,8 @@ static EmissionInventory create_emission_inventory_impl(const SingleEmissions& t
     EmissionInventory result(totalEmissionsNfr.year());
     std::vector<EmissionInventoryEntry> entries;
 
+    const auto pointSourcesById = group_emissions_by_id(pointSourceEmissions);
+
     for (const auto& em : totalEmissionsNfr) {
         assert(em.sector().type() == EmissionSector::Type::Nfr);
 
@@ -352,16 +382,17 @@ static EmissionInventory create_emission_inventory_impl(const SingleEmissions& t
         double diffuseEmissionAutoScale = 1.0;
         double pointEmissionSum         = 0.0;
         double pointEmissionAutoScale   = 1.0;
-        std::vector<EmissionEntry> pointSourceEntries;
+        PointSourceTable pointSourceEntries;
 
         if (em.country().is_belgium()) {
             // For belgian regions we calculate the diffuse emissions by subtracting the point source emissions
             // from the total emissions
 
-            pointSourceEntries = pointSourceEmissions.emissions_with_id(em.id());
-            pointEmissionSum   = std::accumulate(pointSourceEntries.cbegin(), pointSourceEntries.cend(), 0.0, [](double total, const auto& current) {
-                return total + current.value().amount().value_or(0.0);
-            });
+            if (auto pointSources = find_in_map_optional(pointSourcesById, em.id().key()); pointSources.has_value()) {
+                pointSourceEntries = PointSourceTable(*pointSources);
+            }
+
+            pointEmissionSum = pointSourceEntries.amount_sum();
 
             if (diffuseEmission > 0 && pointEmissionSum > (diffuseEmission * diffuseEmissionAutoScale)) {
                 // Check if the difference is caused by floating point rounding
@@ -406,7 +437,7 @@ static EmissionInventory create_emission_inventory_impl(const SingleEmissions& t
         entry.set_diffuse_user_scaling(scalings.diffuse_scaling_for_id(em.id(), result.year()).value_or(1.0));
         entry.set_point_auto_scaling(pointEmissionAutoScale);
         entry.set_point_user_scaling(scalings.point_scaling_for_id(em.id(), result.year()).value_or(1.0));
-        entries.push_back(entry);
+        entries.push_back(std::move(entry));
     }
 
     result.set_emissions(std::move(entries));
@@ -575,26 +606,48 @@ SingleEmissions read_country_point_sources(const RunConfiguration& cfg, const Co
     return result;
 }
 
-SingleEmissions read_nfr_emissions(date::year year, const RunConfiguration& cfg, RunSummary& runSummary)
+static std::optional<fs::path> try_find_nfr_totals_path(date::year year, const RunConfiguration& cfg)
 {
-    chrono::DurationRecorder duration;
-
-    date::year reportYear = cfg.reporting_year();
-    fs::path totalEmissionsNfrPath;
-    while (totalEmissionsNfrPath.empty()) {
+    for (auto reportYear = cfg.reporting_year(); cfg.reporting_year() - reportYear <= date::years(10); --reportYear) {
         if (auto path = cfg.total_emissions_path_nfr(year, reportYear); fs::is_regular_file(path)) {
-            totalEmissionsNfrPath = path;
-        } else {
-            --reportYear;
+            return path;
         }
+    }
 
-        if (cfg.reporting_year() - reportYear > date::years(10)) {
-            throw RuntimeError("NFR emissions could not be found");
-        }
+    return {};
+}
+
+static fs::path find_nfr_totals_path(date::year year, const RunConfiguration& cfg)
+{
+    if (auto path = try_find_nfr_totals_path(year, cfg); path.has_value()) {
+        return *path;
     }
 
-    auto nfrTotalEmissions = parse_emissions(EmissionSector::Type::Nfr, throw_if_not_exists(totalEmissionsNfrPath), year, cfg, RespectIgnoreList::Yes);
-    runSummary.add_totals_source(totalEmissionsNfrPath);
+    throw RuntimeError("NFR emissions could not be found");
+}
+
+// The nfr emissions of a year and the input files they were read from
+struct NfrTotals
+{
+    SingleEmissions emissions;
+    std::vector<fs::path> sources;
+};
+
+static void add_totals_sources(const NfrTotals& totals, RunSummary& runSummary)
+{
+    for (const auto& source : totals.sources) {
+        runSummary.add_totals_source(source);
+    }
+}
+
+static std::vector<NfrTotals> read_nfr_totals(std::span<const date::year> years, const RunConfiguration& cfg)
+{
+    chrono::DurationRecorder duration;
+
+    std::vector<fs::path> totalEmissionsNfrPaths;
+    for (auto year : years) {
+        totalEmissionsNfrPaths.push_back(find_nfr_totals_path(year, cfg));
+    }
 
     static const std::array<const Country*, 3> belgianRegions = {
         &country::BEB,
@@ -602,15 +655,55 @@ SingleEmissions read_nfr_emissions(date::year year, const RunConfiguration& cfg,
         &country::BEW,
     };
 
-    for (auto* region : belgianRegions) {
-        const auto& path = cfg.total_emissions_path_nfr_belgium(*region);
-        merge_unique_emissions(nfrTotalEmissions, parse_emissions_belgium(path, year, cfg));
-        runSummary.add_totals_source(path);
+    // The regional workbooks are parsed concurrently with the nfr totals, they are merged in a fixed order afterwards
+    // The workbooks contain a sheet per year, every workbook is only opened once for all the requested years
+    std::vector<NfrTotals> nfrTotals;
+    for (auto year : years) {
+        nfrTotals.push_back(NfrTotals{SingleEmissions(year), {}});
+    }
+
+    std::vector<std::vector<SingleEmissions>> regionEmissions(belgianRegions.size());
+
+    tbb::task_group tasks;
+    for (size_t i = 0; i < years.size(); ++i) {
+        tasks.run([&, i]() {
+            nfrTotals[i].emissions = parse_emissions(EmissionSector::Type::Nfr, throw_if_not_exists(totalEmissionsNfrPaths[i]), years[i], cfg, RespectIgnoreList::Yes);
+        });
+    }
+
+    tbb::parallel_for(size_t(0), belgianRegions.size(), [&](size_t i) {
+        regionEmissions[i] = parse_emissions_belgium(cfg.total_emissions_path_nfr_belgium(*belgianRegions[i]), years, cfg);
+    });
+
+    tasks.wait();
+
+    for (size_t yearIndex = 0; yearIndex < years.size(); ++yearIndex) {
+        nfrTotals[yearIndex].sources.push_back(totalEmissionsNfrPaths[yearIndex]);
+        for (size_t i = 0; i < belgianRegions.size(); ++i) {
+            merge_unique_emissions(nfrTotals[yearIndex].emissions, std::move(regionEmissions[i][yearIndex]));
+            nfrTotals[yearIndex].sources.push_back(cfg.total_emissions_path_nfr_belgium(*belgianRegions[i]));
+        }
     }
 
     Log::debug("Parse nfr emissions took: {}", duration.elapsed_time_string());
 
-    return nfrTotalEmissions;
+    return nfrTotals;
+}
+
+SingleEmissions read_nfr_emissions(date::year year, const RunConfiguration& cfg, RunSummary& runSummary)
+{
+    return std::move(read_nfr_emissions(std::span<const date::year>(&year, 1), cfg, runSummary).front());
+}
+
+std::vector<SingleEmissions> read_nfr_emissions(std::span<const date::year> years, const RunConfiguration& cfg, RunSummary& runSummary)
+{
+    std::vector<SingleEmissions> result;
+    for (auto& totals : read_nfr_totals(years, cfg)) {
+        add_totals_sources(totals, runSummary);
+        result.push_back(std::move(totals.emissions));
+    }
+
+    return result;
 }
 
 static SingleEmissions read_gnfr_emissions(const RunConfiguration& cfg, RunSummary& runSummary, date::year& reportYear)
@@ -659,32 +752,69 @@ static ScalingFactors read_scaling_factors(const fs::path& p, const RunConfigura
     return scalings;
 }
 
-EmissionInventory make_emission_inventory(const RunConfiguration& cfg, RunSummary& summary)
+static EmissionInventory build_emission_inventory(const RunConfiguration& cfg, RunSummary& summary)
 {
-    // Read scaling factors
-    const auto scalings             = read_scaling_factors(cfg.emission_scalings_path(), cfg);
-    const auto pointSourcesFlanders = read_country_point_sources(cfg, country::BEF, summary);
-    auto nfrTotalEmissions          = read_nfr_emissions(cfg.year(), cfg, summary);
-    assert(nfrTotalEmissions.validate_uniqueness());
-
-    // Optional additional emissions that suplement or override existing emissions
-    std::optional<SingleEmissions> extraEmissions;
-    const auto extraNfrPath = cfg.total_extra_emissions_path_nfr();
-    if (fs::exists(extraNfrPath)) {
-        extraEmissions = parse_emissions(EmissionSector::Type::Nfr, extraNfrPath, cfg.year(), cfg, RespectIgnoreList::No);
-        summary.add_totals_source(extraNfrPath);
-    }
+    chrono::DurationRecorder duration;
 
+    // The inputs are independent, read them concurrently
+    ScalingFactors scalings;
+    SingleEmissions pointSourcesFlanders(cfg.year());
+    SingleEmissions nfrTotalEmissions(cfg.year());
+    std::optional<SingleEmissions> extraEmissions; // Optional additional emissions that suplement or override existing emissions
+    SingleEmissions gnfrTotalEmissions(cfg.year());
     date::year gnfrReportYear;
-    auto gnfrTotalEmissions = read_gnfr_emissions(cfg, summary, gnfrReportYear);
+    std::optional<NfrTotals> olderNfrTotals;
+
+    // The older nfr data is needed for interpolation when there is no gnfr data for the reporting year: year = report_year - 2
+    // Whether the gnfr data of the reporting year contains the requested year is only known after parsing it,
+    // so the older nfr data is read together with the nfr data of the year, the regional workbooks are only opened once
+    const bool interpolationYear = cfg.year() == (cfg.reporting_year() - date::years(2));
+    const bool readOlderNfr      = interpolationYear && try_find_nfr_totals_path(cfg.year() - date::years(1), cfg).has_value();
+
+    tbb::task_group tasks;
+    tasks.run([&]() {
+        scalings = read_scaling_factors(cfg.emission_scalings_path(), cfg);
+    });
+    tasks.run([&]() {
+        pointSourcesFlanders = read_country_point_sources(cfg, country::BEF, summary);
+    });
+    tasks.run([&]() {
+        if (readOlderNfr) {
+            // The sources of the older data are only added to the summary when the data is used
+            const std::array<date::year, 2> years = {cfg.year(), cfg.year() - date::years(1)};
+            auto totals                           = read_nfr_totals(years, cfg);
+            add_totals_sources(totals[0], summary);
+            nfrTotalEmissions = std::move(totals[0].emissions);
+            olderNfrTotals    = std::move(totals[1]);
+        } else {
+            nfrTotalEmissions = read_nfr_emissions(cfg.year(), cfg, summary);
+        }
+    });
+    tasks.run([&]() {
+        if (const auto extraNfrPath = cfg.total_extra_emissions_path_nfr(); fs::exists(extraNfrPath)) {
+            extraEmissions = parse_emissions(EmissionSector::Type::Nfr, extraNfrPath, cfg.year(), cfg, RespectIgnoreList::No);
+            summary.add_totals_source(extraNfrPath);
+        }
+    });
+    tasks.run([&]() {
+        gnfrTotalEmissions = read_gnfr_emissions(cfg, summary, gnfrReportYear);
+    });
+    tasks.wait();
+
+    assert(nfrTotalEmissions.validate_uniqueness());
     assert(gnfrTotalEmissions.validate_uniqueness());
+    Log::debug("Reading the emission inventory inputs took: {}", duration.elapsed_time_string());
 
-    if (gnfrReportYear < cfg.reporting_year() && (cfg.year() == (cfg.reporting_year() - date::years(2)))) {
+    if (gnfrReportYear < cfg.reporting_year() && interpolationYear) {
         // no gnfr data was available for the reporting year, older data was read
         // and interpolation is needed for recent years: year = report_year - 2
-        auto olderNfrTotalEmissions = read_nfr_emissions(cfg.year() - date::years(1), cfg, summary);
+        if (!olderNfrTotals.has_value()) {
+            throw RuntimeError("NFR emissions for {} could not be found", static_cast<int>(cfg.year() - date::years(1)));
+        }
+
+        add_totals_sources(*olderNfrTotals, summary);
         return create_emission_inventory(std::move(nfrTotalEmissions),
-                                         std::move(olderNfrTotalEmissions),
+                                         std::move(olderNfrTotals->emissions),
                                          std::move(gnfrTotalEmissions),
                                          extraEmissions,
                                          pointSourcesFlanders,
@@ -701,4 +831,22 @@ EmissionInventory make_emission_inventory(const RunConfiguration& cfg, RunSummar
                                          summary);
     }
 }
+
+EmissionInventory make_emission_inventory(const RunConfiguration& cfg, RunSummary& summary)
+{
+    if (!cfg.emission_inventory_snapshot()) {
+        return build_emission_inventory(cfg, summary);
+    }
+
+    const auto snapshotPath = cfg.cache_dir_path() / "emission_inventory.snapshot";
+    const auto fingerprint  = emission_inventory_fingerprint(cfg);
+    if (auto inventory = load_emission_inventory_snapshot(snapshotPath, fingerprint, cfg, summary); inventory.has_value()) {
+        Log::info("Emission inventory loaded from snapshot: {}", snapshotPath);
+        return std::move(*inventory);
+    }
+
+    auto inventory = build_emission_inventory(cfg, summary);
+    save_emission_inventory_snapshot(snapshotPath, fingerprint, inventory, summary);
+    return inventory;
+}
 }
@@ -0,0 +1,481 @@
+#include "emissioninventorysnapshot.h"
+
+#include "emap/runconfiguration.h"
+#include "emap/stablehash.h"
+#include "infra/cast.h"
+#include "infra/exception.h"
+#include "infra/log.h"
+#include "infra/string.h"
+#include "runsummary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+
+namespace emap {
+
+using namespace inf;
+
+static constexpr std::string_view s_snapshotHeader = "emap-emission-inventory-snapshot";
+static constexpr uint32_t s_snapshotVersion        = 1;
+
+static void append_file_stamp(std::string& fingerprint, const fs::path& path)
+{
+    std::error_code ec;
+    if (!path.empty() && fs::is_regular_file(path, ec)) {
+        fingerprint += fmt::format("file\t{}\t{}\t{}\n",
+                                   str::from_u8(path.generic_u8string()),
+                                   fs::file_size(path, ec),
+                                   fs::last_write_time(path, ec).time_since_epoch().count());
+    }
+}
+
+static void append_directory_stamps(std::string& fingerprint, const fs::path& dir)
+{
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        return;
+    }
+
+    std::vector<fs::path> files;
+    for (const auto& dirEntry : fs::directory_iterator(dir)) {
+        if (dirEntry.is_regular_file()) {
+            files.push_back(dirEntry.path());
+        }
+    }
+
+    // the directory iteration order is unspecified
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+        append_file_stamp(fingerprint, file);
+    }
+}
+
+uint64_t emission_inventory_fingerprint(const RunConfiguration& cfg)
+{
+    std::string fingerprint = fmt::format("{} {}\n", s_snapshotHeader, s_snapshotVersion);
+    fingerprint += fmt::format("config\t{}\t{}\t{}\t{}\t{}\t{}\n",
+                               static_cast<int>(cfg.year()),
+                               static_cast<int>(cfg.reporting_year()),
+                               cfg.scenario(),
+                               cfg.combine_identical_point_sources(),
+                               cfg.point_source_rescale_threshold(),
+                               static_cast<int>(cfg.model_grid()));
+
+    for (const auto& pol : cfg.included_pollutants()) {
+        fingerprint += fmt::format("included\t{}\n", pol.code());
+    }
+
+    for (const auto& country : cfg.countries().list()) {
+        fingerprint += fmt::format("country\t{}\t{}\n", country.iso_code(), country.is_sea());
+    }
+
+    for (const auto& pol : cfg.pollutants().list()) {
+        fingerprint += fmt::format("pollutant\t{}\n", pol.code());
+    }
+
+    for (const auto& sector : cfg.sectors().gnfr_sectors()) {
+        fingerprint += fmt::format("gnfr\t{}\n", sector.name());
+    }
+
+    for (const auto& sector : cfg.sectors().nfr_sectors()) {
+        fingerprint += fmt::format("nfr\t{}\t{}\n", sector.name(), sector.gnfr().name());
+    }
+
+    // The emission totals of all years, the point sources, the model parameters and the user scalings
+    // Only the size and modification time of the files are used, the contents are not read
+    // The fallback totals of older reporting years (nfr_{year}_{reportyear}.txt, gnfr_allyears_{reportyear}.txt)
+    // are stored in the totals directory of the reporting year, so they are included in the directory stamps
+    append_directory_stamps(fingerprint, cfg.total_emissions_path_gnfr(cfg.reporting_year()).parent_path());
+
+    append_directory_stamps(fingerprint, cfg.point_source_emissions_dir_path(country::BEF));
+    append_directory_stamps(fingerprint, cfg.sector_parameters_config_path().parent_path());
+    append_file_stamp(fingerprint, cfg.emission_scalings_path());
+
+    return stable_hash(fingerprint);
+}
+
+class SnapshotWriter
+{
+public:
+    template <typename T>
+    void write(T value)
+    {
+        static_assert(std::is_arithmetic_v<T>);
+        _data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void write_optional(const std::optional<T>& value)
+    {
+        write<uint8_t>(value.has_value() ? 1 : 0);
+        if (value.has_value()) {
+            write(*value);
+        }
+    }
+
+    void write_string(std::string_view str)
+    {
+        write(truncate<uint32_t>(str.size()));
+        _data.append(str);
+    }
+
+    void write_path(const fs::path& path)
+    {
+        write_string(str::from_u8(path.generic_u8string()));
+    }
+
+    void write_id(const EmissionIdentifier& id)
+    {
+        write_string(id.country.iso_code());
+        write<uint8_t>(id.sector.type() == EmissionSector::Type::Gnfr ? 1 : 0);
+        write_string(id.sector.name());
+        write_string(id.pollutant.code());
+    }
+
+    const std::string& data() const noexcept
+    {
+        return _data;
+    }
+
+private:
+    std::string _data;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(std::string_view data, const RunConfiguration& cfg)
+    : _data(data)
+    {
+        // The snapshot stores the names of the identifiers, they are resolved to the objects of the current run
+        for (const auto& country : cfg.countries().list()) {
+            _countries.emplace(country.iso_code(), country);
+        }
+
+        for (const auto& pol : cfg.pollutants().list()) {
+            _pollutants.emplace(pol.code(), pol);
+        }
+
+        for (const auto& sector : cfg.sectors().gnfr_sectors()) {
+            _gnfrSectors.emplace(sector.name(), EmissionSector(sector));
+        }
+
+        for (const auto& sector : cfg.sectors().nfr_sectors()) {
+            _nfrSectors.emplace(sector.name(), EmissionSector(sector));
+        }
+    }
+
+    template <typename T>
+    T read()
+    {
+        static_assert(std::is_arithmetic_v<T>);
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    std::optional<T> read_optional()
+    {
+        std::optional<T> result;
+        if (read<uint8_t>() != 0) {
+            result = read<T>();
+        }
+
+        return result;
+    }
+
+    // Number of elements that follow, every element takes at least one byte so larger values indicate a corrupt snapshot
+    template <typename T>
+    size_t read_count()
+    {
+        const auto count = read<T>();
+        if (count > _data.size()) {
+            throw RuntimeError("Invalid element count in the snapshot");
+        }
+
+        return static_cast<size_t>(count);
+    }
+
+    std::string_view read_string()
+    {
+        return take(read<uint32_t>());
+    }
+
+    fs::path read_path()
+    {
+        return file::u8path(read_string());
+    }
+
+    EmissionIdentifier read_id()
+    {
+        const auto country   = lookup(_countries, read_string(), "country");
+        const bool isGnfr    = read<uint8_t>() != 0;
+        const auto sector    = lookup(isGnfr ? _gnfrSectors : _nfrSectors, read_string(), "sector");
+        const auto pollutant = lookup(_pollutants, read_string(), "pollutant");
+        return EmissionIdentifier(country, sector, pollutant);
+    }
+
+    bool at_end() const noexcept
+    {
+        return _data.empty();
+    }
+
+private:
+    std::string_view take(size_t size)
+    {
+        if (_data.size() < size) {
+            throw RuntimeError("Unexpected end of the snapshot");
+        }
+
+        const auto result = _data.substr(0, size);
+        _data.remove_prefix(size);
+        return result;
+    }
+
+    template <typename T>
+    static T lookup(const std::unordered_map<std::string, T>& map, std::string_view name, std::string_view type)
+    {
+        if (auto iter = map.find(std::string(name)); iter != map.end()) {
+            return iter->second;
+        }
+
+        throw RuntimeError("Unknown {} in the snapshot: {}", type, name);
+    }
+
+    std::string_view _data;
+    std::unordered_map<std::string, Country> _countries;
+    std::unordered_map<std::string, Pollutant> _pollutants;
+    std::unordered_map<std::string, EmissionSector> _gnfrSectors;
+    std::unordered_map<std::string, EmissionSector> _nfrSectors;
+};
+
+static void write_point_emission(SnapshotWriter& writer, const PointSourceRow& entry)
+{
+    writer.write_id(entry.id());
+    writer.write_optional(entry.value().amount());
+
+    const auto coordinate = entry.coordinate();
+    writer.write<uint8_t>(coordinate.has_value() ? 1 : 0);
+    if (coordinate.has_value()) {
+        writer.write(coordinate->x);
+        writer.write(coordinate->y);
+    }
+
+    writer.write(entry.height());
+    writer.write(entry.diameter());
+    writer.write(entry.temperature());
+    writer.write(entry.warmth_contents());
+    writer.write(entry.flow_rate());
+    writer.write_optional(entry.dv());
+    writer.write_string(entry.source_id());
+}
+
+static EmissionEntry read_point_emission(SnapshotReader& reader)
+{
+    const auto id = reader.read_id();
+    EmissionEntry entry(id, EmissionValue(reader.read_optional<double>()));
+
+    if (reader.read<uint8_t>() != 0) {
+        const auto x = reader.read<double>();
+        const auto y = reader.read<double>();
+        entry.set_coordinate(Coordinate(x, y));
+    }
+
+    entry.set_height(reader.read<double>());
+    entry.set_diameter(reader.read<double>());
+    entry.set_temperature(reader.read<double>());
+    entry.set_warmth_contents(reader.read<double>());
+    entry.set_flow_rate(reader.read<double>());
+    entry.set_dv(reader.read_optional<int32_t>());
+    entry.set_source_id(reader.read_string());
+    return entry;
+}
+
+static std::string read_binary_file(const fs::path& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        throw RuntimeError("Failed to open {}", file::u8string(path));
+    }
+
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+std::optional<EmissionInventory> load_emission_inventory_snapshot(const fs::path& path, uint64_t fingerprint, const RunConfiguration& cfg, RunSummary& summary)
+{
+    if (!fs::is_regular_file(path)) {
+        return {};
+    }
+
+    try {
+        const auto contents = read_binary_file(path);
+        SnapshotReader reader(contents, cfg);
+
+        if (reader.read_string() != s_snapshotHeader || reader.read<uint32_t>() != s_snapshotVersion) {
+            throw RuntimeError("Unsupported snapshot version");
+        }
+
+        if (reader.read<uint64_t>() != fingerprint) {
+            Log::debug("The emission inventory inputs were modified, the snapshot is outdated");
+            return {};
+        }
+
+        const date::year year(reader.read<int32_t>());
+
+        std::vector<EmissionInventoryEntry> entries(reader.read_count<uint64_t>());
+        for (auto& entry : entries) {
+            const auto id          = reader.read_id();
+            const auto diffuse     = reader.read<double>();
+            const auto diffuseUser = reader.read<double>();
+            const auto diffuseAuto = reader.read<double>();
+            const auto pointUser   = reader.read<double>();
+            const auto pointAuto   = reader.read<double>();
+            const auto pointCount  = reader.read_count<uint64_t>();
+
+            PointSourceTable pointEmissions;
+            pointEmissions.reserve(pointCount);
+            for (size_t i = 0; i < pointCount; ++i) {
+                pointEmissions.push_back(read_point_emission(reader));
+            }
+
+            entry = EmissionInventoryEntry(id, diffuse, std::move(pointEmissions));
+            entry.set_diffuse_user_scaling(diffuseUser);
+            entry.set_diffuse_auto_scaling(diffuseAuto);
+            entry.set_point_user_scaling(pointUser);
+            entry.set_point_auto_scaling(pointAuto);
+        }
+
+        // The run summary records are only applied when the complete snapshot is valid
+        std::vector<fs::path> pointSources(reader.read_count<uint32_t>());
+        for (auto& pointSource : pointSources) {
+            pointSource = reader.read_path();
+        }
+
+        std::vector<fs::path> totalsSources(reader.read_count<uint32_t>());
+        for (auto& totalsSource : totalsSources) {
+            totalsSource = reader.read_path();
+        }
+
+        std::vector<RunSummary::GnfrCorrection> gnfrCorrections(reader.read_count<uint32_t>());
+        for (auto& correction : gnfrCorrections) {
+            correction.id                 = reader.read_id();
+            correction.validatedGnfrTotal = reader.read_optional<double>();
+            correction.summedGnfrTotal    = reader.read<double>();
+            correction.correction         = reader.read<double>();
+        }
+
+        std::vector<RunSummary::ValidatedGnfrCorrection> validatedGnfrCorrections(reader.read_count<uint32_t>());
+        for (auto& correction : validatedGnfrCorrections) {
+            correction.id                 = reader.read_id();
+            correction.validatedGnfrTotal = reader.read<double>();
+            correction.correctedGnfrTotal = reader.read<double>();
+            correction.nfrTotal           = reader.read<double>();
+            correction.olderNfrTotal      = reader.read<double>();
+        }
+
+        if (!reader.at_end()) {
+            throw RuntimeError("Unexpected data at the end of the snapshot");
+        }
+
+        for (const auto& pointSource : pointSources) {
+            summary.add_point_source(pointSource);
+        }
+
+        for (const auto& totalsSource : totalsSources) {
+            summary.add_totals_source(totalsSource);
+        }
+
+        for (const auto& correction : gnfrCorrections) {
+            summary.add_gnfr_correction(correction.id, correction.validatedGnfrTotal, correction.summedGnfrTotal, correction.correction);
+        }
+
+        for (const auto& correction : validatedGnfrCorrections) {
+            summary.add_gnfr_correction(correction.id, correction.validatedGnfrTotal, correction.correctedGnfrTotal, correction.nfrTotal, correction.olderNfrTotal);
+        }
+
+        return EmissionInventory(year, std::move(entries));
+    } catch (const std::exception& e) {
+        Log::warn("Ignoring invalid emission inventory snapshot ({})", e.what());
+    }
+
+    return {};
+}
+
+void save_emission_inventory_snapshot(const fs::path& path, uint64_t fingerprint, const EmissionInventory& inventory, const RunSummary& summary)
+{
+    SnapshotWriter writer;
+    writer.write_string(s_snapshotHeader);
+    writer.write(s_snapshotVersion);
+    writer.write(fingerprint);
+    writer.write(static_cast<int32_t>(static_cast<int>(inventory.year())));
+
+    writer.write(uint64_t(inventory.size()));
+    for (const auto& entry : inventory) {
+        writer.write_id(entry.id());
+        writer.write(entry.diffuse_emissions());
+        writer.write(entry.diffuse_user_scaling_factor());
+        writer.write(entry.diffuse_auto_scaling_factor());
+        writer.write(entry.point_user_scaling_factor());
+        writer.write(entry.point_auto_scaling_factor());
+
+        const auto& pointEmissions = entry.point_emissions();
+        writer.write(uint64_t(pointEmissions.size()));
+        for (const auto pointEmission : pointEmissions) {
+            write_point_emission(writer, pointEmission);
+        }
+    }
+
+    writer.write(truncate<uint32_t>(summary.used_point_sources().size()));
+    for (const auto& pointSource : summary.used_point_sources()) {
+        writer.write_path(pointSource);
+    }
+
+    writer.write(truncate<uint32_t>(summary.used_totals_sources().size()));
+    for (const auto& totalsSource : summary.used_totals_sources()) {
+        writer.write_path(totalsSource);
+    }
+
+    writer.write(truncate<uint32_t>(summary.gnfr_corrections().size()));
+    for (const auto& correction : summary.gnfr_corrections()) {
+        writer.write_id(correction.id);
+        writer.write_optional(correction.validatedGnfrTotal);
+        writer.write(correction.summedGnfrTotal);
+        writer.write(correction.correction);
+    }
+
+    writer.write(truncate<uint32_t>(summary.validated_gnfr_corrections().size()));
+    for (const auto& correction : summary.validated_gnfr_corrections()) {
+        writer.write_id(correction.id);
+        writer.write(correction.validatedGnfrTotal);
+        writer.write(correction.correctedGnfrTotal);
+        writer.write(correction.nfrTotal);
+        writer.write(correction.olderNfrTotal);
+    }
+
+    try {
+        // Write to a temporary file first so an interrupted run never leaves a truncated snapshot behind
+        fs::create_directories(path.parent_path());
+        auto tempPath = path;
+        tempPath += ".tmp";
+
+        {
+            std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+            stream.write(writer.data().data(), writer.data().size());
+            if (!stream.good()) {
+                throw RuntimeError("Failed to write {}", file::u8string(tempPath));
+            }
+        }
+
+        fs::rename(tempPath, path);
+    } catch (const std::exception& e) {
+        Log::warn("Failed to write the emission inventory snapshot: {}", e.what());
+    }
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "emap/emissioninventory.h"
+#include "infra/filesystem.h"
+
+#include <cstdint>
+#include <optional>
+
+namespace emap {
+
+class RunConfiguration;
+class RunSummary;
+
+/* Binary snapshot of a built emission inventory
+ * The snapshot is keyed by a fingerprint of the configuration and the emission input files it was built from,
+ * it contains the point sources, the applied scaling factors and the run summary records of the inventory build */
+
+// Fingerprint of all the inputs the emission inventory depends on
+uint64_t emission_inventory_fingerprint(const RunConfiguration& cfg);
+
+// Returns the stored inventory when the snapshot matches the fingerprint and restores the run summary records of the inventory build
+// A missing, invalid or outdated snapshot is ignored
+std::optional<EmissionInventory> load_emission_inventory_snapshot(const fs::path& path, uint64_t fingerprint, const RunConfiguration& cfg, RunSummary& summary);
+
+// The snapshot is only a cache, failing to store it is not an error
+void save_emission_inventory_snapshot(const fs::path& path, uint64_t fingerprint, const EmissionInventory& inventory, const RunSummary& summary);
+
+}
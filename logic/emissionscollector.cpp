@@ -1,6 +1,7 @@
 #include "emissionscollector.h"
 #include "emap/gridprocessing.h"
 #include "emap/outputbuilderfactory.h"
+#include "rasterwriter.h"
 
 #include "gdx/denserasterio.h"
 #include "gdx/rasterarea.h"
@@ -11,11 +12,12 @@ namespace emap {
 
 using namespace inf;
 
-static void add_point_sources_to_grid(const EmissionIdentifier& id, std::span<const EmissionEntry> pointEmissions, gdx::DenseRaster<double>& raster)
+static void add_point_sources_to_grid(const EmissionIdentifier& id, const PointSourceTable& pointEmissions, SparseRaster& raster)
 {
     const auto& meta = raster.metadata();
 
     size_t mismatches = 0;
+    std::vector<std::pair<Cell, double>> cellValues;
 
     // Add the point sources to the grid
     for (auto pointEmission : pointEmissions) {
@@ -23,12 +25,7 @@ static void add_point_sources_to_grid(const EmissionIdentifier& id, std::span<co
             if (auto coord = pointEmission.coordinate(); coord.has_value()) {
                 auto cell = meta.convert_xy_to_cell(coord->x, coord->y);
                 if (meta.is_on_map(cell)) {
-                    if (raster.is_nodata(cell)) {
-                        raster[cell] = *amount;
-                        raster.mark_as_data(cell);
-                    } else {
-                        raster[cell] += *amount;
-                    }
+                    cellValues.emplace_back(cell, *amount);
                 } else {
                     Log::debug("Point source not on map: {} (Cell {} Grid rows {} cols {})", *coord, cell, meta.rows, meta.cols);
                     ++mismatches;
@@ -40,10 +37,13 @@ static void add_point_sources_to_grid(const EmissionIdentifier& id, std::span<co
     if (mismatches > 0) {
         Log::warn("{}: Not all point sources could be added to the map: {} point sources, skipped {}", id, pointEmissions.size(), mismatches);
     }
+
+    raster.add_to_cells(std::move(cellValues));
 }
 
-EmissionsCollector::EmissionsCollector(const RunConfiguration& cfg)
+EmissionsCollector::EmissionsCollector(const RunConfiguration& cfg, RasterWriter& rasterWriter)
 : _cfg(cfg)
+, _rasterWriter(rasterWriter)
 , _outputBuilder(make_output_builder(cfg))
 {
 }
@@ -56,64 +56,60 @@ void EmissionsCollector::start_pollutant(const Pollutant& pol, const GridData& g
     _grid      = grid;
 }
 
-void EmissionsCollector::add_emissions(const CountryCellCoverage& countryInfo, const NfrSector& nfr, gdx::DenseRaster<double> diffuseEmissions, std::span<const EmissionEntry> pointEmissions)
+template <typename Map, typename Key>
+EmissionsCollector::CollectedRaster& EmissionsCollector::collected_raster(Map& rasters, Key&& key)
+{
+    std::scoped_lock lock(_mutex);
+    return rasters.try_emplace(std::forward<Key>(key)).first->second;
+}
+
+void EmissionsCollector::add_emissions(const CountryCellCoverage& countryInfo, const NfrSector& nfr, SparseRaster diffuseEmissions, const PointSourceTable& pointEmissions)
 {
     assert(_pollutant.has_value());
     if (diffuseEmissions.contains_only_nodata()) {
         return;
     }
 
-    const auto& meta = diffuseEmissions.metadata();
-
     EmissionIdentifier emissionId(countryInfo.country, EmissionSector(nfr), *_pollutant);
 
-    for (auto cell : gdx::RasterCells(diffuseEmissions)) {
-        if (diffuseEmissions.is_nodata(cell) || diffuseEmissions[cell] == 0.0) {
-            continue;
-        }
-
-        const auto cellCenter = meta.convert_cell_centre_to_xy(cell);
-        _outputBuilder->add_diffuse_output_entry(emissionId, Point(cellCenter.x, cellCenter.y), diffuseEmissions[cell], truncate<int32_t>(meta.cell_size_x()));
-    }
+    _outputBuilder->add_diffuse_output_entries(emissionId, diffuseEmissions);
 
-    for (auto& entry : pointEmissions) {
+    for (const auto entry : pointEmissions) {
         _outputBuilder->add_point_output_entry(entry);
     }
 
     if (diffuseEmissions.empty() && !pointEmissions.empty()) {
-        diffuseEmissions = gdx::DenseRaster<double>(countryInfo.outputSubgridExtent, std::numeric_limits<double>::quiet_NaN());
+        diffuseEmissions = SparseRaster(countryInfo.outputSubgridExtent);
     }
 
     add_point_sources_to_grid(emissionId, pointEmissions, diffuseEmissions);
 
     if (!diffuseEmissions.empty() && _cfg.output_grid_rasters()) {
         // The emissions need to be aggregated
-        auto mappedSectorName = _cfg.sectors().map_nfr_to_output_name(nfr);
+        auto& collected = collected_raster(_collectedEmissions, _cfg.sectors().map_nfr_to_output_name(nfr));
 
-        std::scoped_lock lock(_mutex);
-        if (auto iter = _collectedEmissions.find(mappedSectorName); iter != _collectedEmissions.end()) {
-            add_to_raster(iter->second, diffuseEmissions);
-        } else {
-            gdx::DenseRaster<double> total(_grid->meta, std::numeric_limits<double>::quiet_NaN());
-            add_to_raster(total, diffuseEmissions);
-            _collectedEmissions.emplace(mappedSectorName, std::move(total));
+        std::scoped_lock lock(collected.mutex);
+        if (!collected.raster.has_value()) {
+            collected.raster.emplace(_grid->meta, std::numeric_limits<double>::quiet_NaN());
         }
+
+        add_to_raster(*collected.raster, diffuseEmissions);
     }
 
     if (!diffuseEmissions.empty() && _cfg.output_country_rasters()) {
         if (_cfg.output_sector_level() == SectorLevel::NFR) {
             // Sectors can be dumped without aggregation
-            gdx::write_raster(std::move(diffuseEmissions), _cfg.output_path_for_country_raster(emissionId, *_grid));
+            _rasterWriter.write(diffuseEmissions.to_dense(), _cfg.output_path_for_country_raster(emissionId, *_grid));
         } else {
             // Aggregate the country data per mapped sector
             // The emissions need to be aggregated
-            auto id = std::make_pair(std::string(emissionId.country.iso_code()), _cfg.sectors().map_nfr_to_output_name(nfr));
+            auto& collected = collected_raster(_collectedCountryEmissions, std::make_pair(std::string(emissionId.country.iso_code()), _cfg.sectors().map_nfr_to_output_name(nfr)));
 
-            std::scoped_lock lock(_mutex);
-            if (auto iter = _collectedCountryEmissions.find(id); iter != _collectedCountryEmissions.end()) {
-                add_to_raster(iter->second, diffuseEmissions);
+            std::scoped_lock lock(collected.mutex);
+            if (collected.raster.has_value()) {
+                add_to_raster(*collected.raster, diffuseEmissions);
             } else {
-                _collectedCountryEmissions.emplace(id, std::move(diffuseEmissions));
+                collected.raster = diffuseEmissions.to_dense();
             }
         }
     }
@@ -131,14 +127,22 @@ void EmissionsCollector::flush_pollutant_to_disk(WriteMode mode)
 
     _outputBuilder->flush_pollutant(*_pollutant, convert_write_mode(mode));
 
-    for (auto& [name, raster] : _collectedEmissions) {
+    for (auto& [name, collected] : _collectedEmissions) {
+        if (!collected.raster.has_value()) {
+            continue;
+        }
+
         const auto outputPath = _cfg.output_dir_for_rasters() / file::u8path(fmt::format("{}_{}_{}.tif", _pollutant->code(), name, _grid->name));
-        gdx::write_raster(std::move(raster), outputPath);
+        _rasterWriter.write(std::move(*collected.raster), outputPath);
     }
 
-    for (auto& [id, raster] : _collectedCountryEmissions) {
+    for (auto& [id, collected] : _collectedCountryEmissions) {
+        if (!collected.raster.has_value()) {
+            continue;
+        }
+
         const auto outputPath = _cfg.output_dir_for_rasters() / file::u8path(fmt::format("{}_{}_{}_{}.tif", _pollutant->code(), id.second, id.first, _grid->name));
-        gdx::write_raster(std::move(raster), outputPath);
+        _rasterWriter.write(std::move(*collected.raster), outputPath);
     }
 
     _collectedEmissions.clear();
@@ -1,14 +1,21 @@
 #pragma once
 
+#include "emap/pointsourcetable.h"
 #include "emap/runconfiguration.h"
+#include "emap/sparseraster.h"
 #include "gdx/denseraster.h"
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
 
 namespace emap {
 
 class IOutputBuilder;
+class RasterWriter;
 struct CountryCellCoverage;
 
 class EmissionsCollector
@@ -20,24 +27,37 @@ public:
         Append,
     };
 
-    EmissionsCollector(const RunConfiguration& cfg);
+    // The output rasters are written by the raster writer
+    EmissionsCollector(const RunConfiguration& cfg, RasterWriter& rasterWriter);
     ~EmissionsCollector() noexcept;
 
     void start_pollutant(const Pollutant& pol, const GridData& grid);
 
-    void add_emissions(const CountryCellCoverage& countryInfo, const NfrSector& nfr, gdx::DenseRaster<double> diffuseEmissions, std::span<const EmissionEntry> pointEmissions);
+    void add_emissions(const CountryCellCoverage& countryInfo, const NfrSector& nfr, SparseRaster diffuseEmissions, const PointSourceTable& pointEmissions);
 
     void flush_pollutant_to_disk(WriteMode mode);
     void final_flush_to_disk(WriteMode mode);
 
 private:
+    // Every aggregated raster has its own lock, so only the emissions of the same output sector are merged sequentially
+    struct CollectedRaster
+    {
+        std::mutex mutex;
+        std::optional<gdx::DenseRaster<double>> raster;
+    };
+
+    template <typename Map, typename Key>
+    CollectedRaster& collected_raster(Map& rasters, Key&& key);
+
+    // Only guards the insertions in the raster maps, the map nodes remain valid until the pollutant is flushed
     std::mutex _mutex;
 
     const RunConfiguration& _cfg;
+    RasterWriter& _rasterWriter;
     std::optional<Pollutant> _pollutant;
     std::optional<GridData> _grid;
-    std::unordered_map<std::string, gdx::DenseRaster<double>> _collectedEmissions;
-    std::map<std::pair<std::string, std::string>, gdx::DenseRaster<double>> _collectedCountryEmissions;
+    std::unordered_map<std::string, CollectedRaster> _collectedEmissions;
+    std::map<std::pair<std::string, std::string>, CollectedRaster> _collectedCountryEmissions;
     std::unique_ptr<IOutputBuilder> _outputBuilder;
 };
 
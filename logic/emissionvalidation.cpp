@@ -2,7 +2,6 @@
 #include "brnanalyzer.h"
 #include "emap/configurationparser.h"
 #include "emap/modelpaths.h"
-#include "gdx/algo/sum.h"
 #include "outputreaders.h"
 
 #include "infra/exception.h"
@@ -20,16 +19,16 @@ EmissionValidation::EmissionValidation(const RunConfiguration& cfg)
 void EmissionValidation::add_point_emissions(const EmissionIdentifier& id, double pointEmissionsTotal)
 {
     std::scoped_lock lock(_mutex);
-    _pointEmissionSums[id] += pointEmissionsTotal;
+    _pointEmissionSums[id.key()] += pointEmissionsTotal;
 }
 
-void EmissionValidation::add_diffuse_emissions(const EmissionIdentifier& id, const gdx::DenseRaster<double>& raster, double emissionsOutsideOfTheGrid)
+void EmissionValidation::add_diffuse_emissions(const EmissionIdentifier& id, const SparseRaster& raster, double emissionsOutsideOfTheGrid)
 {
-    const auto sum = gdx::sum(raster);
+    const auto sum = raster.sum();
 
     std::scoped_lock lock(_mutex);
-    _diffuseEmissionSums[id] += sum;
-    _diffuseEmissionOutsideGridSums[id] += emissionsOutsideOfTheGrid;
+    _diffuseEmissionSums[id.key()] += sum;
+    _diffuseEmissionOutsideGridSums[id.key()] += emissionsOutsideOfTheGrid;
 }
 
 void EmissionValidation::set_grid_countries(const std::unordered_set<CountryId>& countries)
@@ -78,9 +77,9 @@ std::vector<EmissionValidation::SummaryEntry> EmissionValidation::create_summary
         summaryEntry.emissionInventoryDiffuse = invEntry.scaled_diffuse_emissions_sum();
         summaryEntry.emissionInventoryPoint   = invEntry.scaled_point_emissions_sum();
 
-        summaryEntry.spreadDiffuseTotal              = find_in_map_optional(_diffuseEmissionSums, summaryEntry.id);
-        summaryEntry.spreadDiffuseOutsideOfGridTotal = find_in_map_optional(_diffuseEmissionOutsideGridSums, summaryEntry.id);
-        summaryEntry.spreadPointTotal                = find_in_map_optional(_pointEmissionSums, summaryEntry.id);
+        summaryEntry.spreadDiffuseTotal              = find_in_map_optional(_diffuseEmissionSums, summaryEntry.id.key());
+        summaryEntry.spreadDiffuseOutsideOfGridTotal = find_in_map_optional(_diffuseEmissionOutsideGridSums, summaryEntry.id.key());
+        summaryEntry.spreadPointTotal                = find_in_map_optional(_pointEmissionSums, summaryEntry.id.key());
 
         if (_cfg.output_sector_level() == SectorLevel::NFR) {
             int32_t countryCode = static_cast<int32_t>(invEntry.id().country.id());
@@ -2,7 +2,7 @@
 
 #include "emap/emissioninventory.h"
 #include "emap/runconfiguration.h"
-#include "gdx/denseraster.h"
+#include "emap/sparseraster.h"
 
 #include <mutex>
 #include <unordered_map>
@@ -48,7 +48,7 @@ public:
     EmissionValidation(const RunConfiguration& cfg);
 
     void add_point_emissions(const EmissionIdentifier& id, double pointEmissionsTotal);
-    void add_diffuse_emissions(const EmissionIdentifier& id, const gdx::DenseRaster<double>& raster, double insideGridRatio);
+    void add_diffuse_emissions(const EmissionIdentifier& id, const SparseRaster& raster, double insideGridRatio);
     void set_grid_countries(const std::unordered_set<CountryId>& countries);
 
     std::vector<SummaryEntry> create_summary(const EmissionInventory& emissionInv);
@@ -57,9 +57,9 @@ private:
     std::mutex _mutex;
     const RunConfiguration& _cfg;
     std::unordered_set<CountryId> _gridCountries;
-    std::unordered_map<EmissionIdentifier, double> _diffuseEmissionSums;
-    std::unordered_map<EmissionIdentifier, double> _diffuseEmissionOutsideGridSums;
-    std::unordered_map<EmissionIdentifier, double> _pointEmissionSums;
+    std::unordered_map<EmissionKey, double> _diffuseEmissionSums;
+    std::unordered_map<EmissionKey, double> _diffuseEmissionOutsideGridSums;
+    std::unordered_map<EmissionKey, double> _pointEmissionSums;
 };
 
 }
\ No newline at end of file
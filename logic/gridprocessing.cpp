@@ -13,9 +13,12 @@
 #include "infra/math.h"
 #include "infra/progressinfo.h"
 #include "infra/rect.h"
+#include "rasterkernels.h"
 
 #include <cassert>
 #include <mutex>
+#include <span>
+#include <type_traits>
 
 #include <oneapi/tbb/parallel_for_each.h>
 
@@ -169,6 +172,27 @@ static gdx::DenseRaster<double> cutout_country(const gdx::DenseRaster<double>& r
     return result;
 }
 
+/* Sparse variant of cutout_country, only the cells of the country are stored */
+template <typename T>
+static SparseRaster cutout_country_cells(const gdx::DenseRaster<T>& ras, const CountryCellCoverage& countryCoverage)
+{
+    std::vector<std::pair<Cell, double>> cellValues;
+    cellValues.reserve(countryCoverage.cells.size());
+
+    for (const auto& cellInfo : countryCoverage.cells) {
+        assert(ras.metadata().is_on_map(cellInfo.countryGridCell));
+        if (!ras.metadata().is_on_map(cellInfo.countryGridCell) || ras.is_nodata(cellInfo.countryGridCell)) {
+            continue;
+        }
+
+        cellValues.emplace_back(cellInfo.countryGridCell, ras[cellInfo.countryGridCell] * cellInfo.coverage);
+    }
+
+    SparseRaster result(ras.metadata(), std::is_same_v<T, float> ? SparseRaster::Precision::Single : SparseRaster::Precision::Double);
+    result.add_to_cells(std::move(cellValues));
+    return result;
+}
+
 gdx::DenseRaster<double> read_raster_north_up(const fs::path& rasterInput, const GeoMetadata& extent)
 {
     auto ras = gdx::read_dense_raster<double>(rasterInput, extent);
@@ -184,47 +208,69 @@ void normalize_raster(gdx::DenseRaster<double>& ras) noexcept
 {
     // normalize the raster so the sum is 1
     if (const auto sum = gdx::sum(ras); sum != 0.0) {
-        gdx::transform(ras, ras, [sum](const auto& val) {
-            return val / sum;
-        });
+        divide_values(std::span<double>(ras.data(), ras.size()), sum);
+    }
+}
+
+void normalize_raster(SparseRaster& ras) noexcept
+{
+    // normalize the raster so the sum is 1
+    if (const auto sum = ras.sum(); sum != 0.0) {
+        ras /= sum;
     }
 }
 
 void add_to_raster(gdx::DenseRaster<double>& collectedRaster, const gdx::DenseRaster<double>& countryRaster)
 {
-    auto intersection = inf::metadata_intersection(collectedRaster.metadata(), countryRaster.metadata());
-    if (intersection.rows == 0 || intersection.cols == 0) {
+    add_raster_nan_aware(collectedRaster, countryRaster);
+}
+
+void add_to_raster(gdx::DenseRaster<double>& collectedRaster, const SparseRaster& countryRaster)
+{
+    const auto& collectedMeta = collectedRaster.metadata();
+    const auto& countryMeta   = countryRaster.metadata();
+    if (countryRaster.contains_only_nodata()) {
         return;
     }
 
-    auto subGrid1 = gdx::sub_area(collectedRaster, intersection);
-    auto subGrid2 = gdx::sub_area(countryRaster, intersection);
-
-    if (subGrid1.cols() != subGrid2.cols() || subGrid1.rows() != subGrid2.rows()) {
+    if (collectedMeta.cell_size_x() != countryMeta.cell_size_x() || collectedMeta.cell_size_y() != countryMeta.cell_size_y()) {
         throw RuntimeError("Country raster should be a subgrid of the grid raster");
     }
 
-    std::transform(subGrid1.begin(), subGrid1.end(), subGrid2.begin(), subGrid1.begin(), [](double res, double toAdd) {
-        if (std::isnan(toAdd)) {
-            return res;
-        }
+    // Offset of the country raster in the collected raster
+    const auto topLeft = countryMeta.convert_cell_centre_to_xy(Cell(0, 0));
+    const auto offset  = collectedMeta.convert_xy_to_cell(topLeft.x, topLeft.y);
 
-        if (std::isnan(res)) {
-            return toAdd;
+    for (size_t i = 0; i < countryRaster.size(); ++i) {
+        const auto countryCell = countryRaster.cell(i);
+        const Cell cell(countryCell.r + offset.r, countryCell.c + offset.c);
+        if (!collectedMeta.is_on_map(cell)) {
+            continue;
         }
 
-        return res + toAdd;
-    });
+        auto& val = collectedRaster[cell];
+        if (std::isnan(val)) {
+            val = countryRaster.value(i);
+        } else {
+            val += countryRaster.value(i);
+        }
+    }
 }
 
-gdx::DenseRaster<double> spread_values_uniformly_over_cells(double valueToSpread, const CountryCellCoverage& countryCoverage)
+SparseRaster spread_values_uniformly_over_cells(double valueToSpread, const CountryCellCoverage& countryCoverage)
 {
     const auto totalCoverage = std::accumulate(countryCoverage.cells.begin(), countryCoverage.cells.end(), 0.0, [](double current, const CountryCellCoverage::CellInfo& cellInfo) {
         return current + cellInfo.coverage;
     });
 
-    auto raster = cutout_country(gdx::DenseRaster<double>(countryCoverage.outputSubgridExtent, 1.0), countryCoverage);
-    raster *= (valueToSpread / totalCoverage);
+    std::vector<std::pair<Cell, double>> cellValues;
+    cellValues.reserve(countryCoverage.cells.size());
+    for (const auto& cellInfo : countryCoverage.cells) {
+        cellValues.emplace_back(cellInfo.countryGridCell, cellInfo.coverage * (valueToSpread / totalCoverage));
+    }
+
+    SparseRaster raster(countryCoverage.outputSubgridExtent);
+    raster.add_to_cells(std::move(cellValues));
     return raster;
 }
 
@@ -594,6 +640,16 @@ gdx::DenseRaster<double> extract_country_from_raster(const fs::path& rasterInput
     return extract_country_from_raster(gdx::read_dense_raster<double>(rasterInput), countryCoverage);
 }
 
+SparseRaster extract_country_cells_from_raster(const gdx::DenseRaster<double>& raster, const CountryCellCoverage& countryCoverage)
+{
+    return cutout_country_cells(gdx::resample_raster(raster, countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average), countryCoverage);
+}
+
+SparseRaster extract_country_cells_from_raster(const gdx::DenseRaster<float>& raster, const CountryCellCoverage& countryCoverage)
+{
+    return cutout_country_cells(gdx::resample_raster(raster, countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average), countryCoverage);
+}
+
 void erase_area_in_raster(gdx::DenseRaster<double>& rasterInput, const inf::GeoMetadata& extent)
 {
     auto rasterArea = gdx::sub_area(rasterInput, extent);
@@ -602,15 +658,12 @@ void erase_area_in_raster(gdx::DenseRaster<double>& rasterInput, const inf::GeoM
 
 double erase_area_in_raster_and_sum_erased_values(gdx::DenseRaster<double>& rasterInput, const inf::GeoMetadata& extent)
 {
-    double sum = 0.0;
-
-    auto rasterArea = gdx::sub_area_values(rasterInput, extent);
-    std::for_each(rasterArea.begin(), rasterArea.end(), [&sum](auto& val) {
-        sum += val;
-        val = gdx::DenseRaster<double>::NaN;
-    });
+    return sum_and_erase_area(rasterInput, extent);
+}
 
-    return sum;
+double erase_area_in_raster_and_sum_erased_values(SparseRaster& rasterInput, const inf::GeoMetadata& extent)
+{
+    return rasterInput.erase_area_and_sum(extent);
 }
 
 }
@@ -8,6 +8,8 @@
 #include "infra/geometadata.h"
 #include "infra/log.h"
 
+#include "rasterkernels.h"
+
 namespace emap {
 
 class GridRasterBuilder
@@ -21,24 +23,7 @@ public:
 
     void add_raster(const gdx::DenseRaster<double>& ras)
     {
-        auto intersection = inf::metadata_intersection(_raster.metadata(), ras.metadata());
-        if (intersection.rows == 0 || intersection.cols == 0) {
-            return;
-        }
-
-        auto subGrid1 = gdx::sub_area(_raster, intersection);
-        auto subGrid2 = gdx::sub_area(ras, intersection);
-        std::transform(subGrid1.begin(), subGrid1.end(), subGrid2.begin(), subGrid1.begin(), [](double res, double toAdd) {
-            if (std::isnan(toAdd)) {
-                return res;
-            }
-
-            if (std::isnan(res)) {
-                return toAdd;
-            }
-
-            return res + toAdd;
-        });
+        add_raster_nan_aware(_raster, ras);
     }
 
     double current_sum() const
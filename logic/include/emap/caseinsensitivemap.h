@@ -0,0 +1,69 @@
+#pragma once
+
+#include "emap/stablehash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace emap {
+
+/* Hashing and comparison of names that ignore the (ascii) case of the characters
+ * The functors are transparent so the maps can be probed with a string_view without allocating a key */
+
+constexpr char fold_case(char c) noexcept
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+struct CaseInsensitiveHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const noexcept
+    {
+        return static_cast<size_t>(stable_hash(str, fold_case));
+    }
+};
+
+struct CaseInsensitiveEqual
+{
+    using is_transparent = void;
+
+    bool operator()(std::string_view lhs, std::string_view rhs) const noexcept
+    {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (fold_case(lhs[i]) != fold_case(rhs[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+// Hashing of names that have to match exactly, allows lookups with a string_view
+struct StringHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const noexcept
+    {
+        return std::hash<std::string_view>()(str);
+    }
+};
+
+template <typename T>
+using CaseInsensitiveMap = std::unordered_map<std::string, T, CaseInsensitiveHash, CaseInsensitiveEqual>;
+
+template <typename T>
+using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "emap/caseinsensitivemap.h"
 #include "emap/inputconversion.h"
 #include "infra/span.h"
 
+#include <cstdint>
 #include <fmt/core.h>
 #include <optional>
 #include <string_view>
@@ -17,20 +19,13 @@ struct CountryId : type_safe::strong_typedef<CountryId, int32_t>,
     using strong_typedef::strong_typedef;
 };
 
+/* Trivially copyable country handle, the iso code and label are interned in a process wide store
+ * Copies of the country do not allocate */
 class Country
 {
 public:
-    Country() noexcept
-    {
-    }
-
-    Country(CountryId id, std::string_view isoCode, std::string_view label, bool isLand)
-    : _id(id)
-    , _isoCode(isoCode)
-    , _label(label)
-    , _isLand(isLand)
-    {
-    }
+    Country() noexcept = default;
+    Country(CountryId id, std::string_view isoCode, std::string_view label, bool isLand);
 
     const CountryId& id() const noexcept
     {
@@ -47,15 +42,8 @@ public:
         return !_isLand;
     }
 
-    std::string_view iso_code() const noexcept
-    {
-        return static_cast<const std::string&>(_isoCode);
-    }
-
-    std::string_view full_name() const noexcept
-    {
-        return _label;
-    }
+    std::string_view iso_code() const noexcept;
+    std::string_view full_name() const noexcept;
 
     bool operator==(const Country& other) const noexcept
     {
@@ -70,10 +58,9 @@ public:
     std::string_view to_string() const noexcept;
 
 private:
-    CountryId _id = CountryId(0);
-    std::string _isoCode;
-    std::string _label;
-    bool _isLand = true;
+    CountryId _id  = CountryId(0);
+    uint32_t _info = 0; // index of the iso code and label in the interned country info
+    bool _isLand   = true;
 };
 
 namespace country {
@@ -96,6 +83,8 @@ public:
 
 private:
     std::vector<Country> _countries;
+    // Index of the iso codes in the country list
+    StringMap<size_t> _isoCodeIndex;
 };
 
 }
@@ -106,7 +95,7 @@ struct hash<emap::Country>
 {
     size_t operator()(const emap::Country& country) const
     {
-        return hash<std::string_view>()(country.iso_code());
+        return hash<emap::CountryId>()(country.id());
     }
 };
 }
@@ -1,8 +1,12 @@
 ﻿#pragma once
 
 #include "emap/emissions.h"
+#include "emap/pointsourcetable.h"
 #include "infra/math.h"
 
+#include <span>
+#include <vector>
+
 namespace emap {
 
 class RunSummary;
@@ -19,10 +23,17 @@ public:
     {
     }
 
-    EmissionInventoryEntry(EmissionIdentifier id, double diffuseEmissions, std::vector<EmissionEntry> pointEmissionEntries) noexcept
+    EmissionInventoryEntry(EmissionIdentifier id, double diffuseEmissions, const std::vector<EmissionEntry>& pointEmissionEntries)
+    : _id(id)
+    , _diffuseEmission(diffuseEmissions)
+    , _pointEmissions(pointEmissionEntries)
+    {
+    }
+
+    EmissionInventoryEntry(EmissionIdentifier id, double diffuseEmissions, PointSourceTable pointEmissions) noexcept
     : _id(id)
     , _diffuseEmission(diffuseEmissions)
-    , _pointEmissionEntries(std::move(pointEmissionEntries))
+    , _pointEmissions(std::move(pointEmissions))
     {
     }
 
@@ -43,38 +54,29 @@ public:
 
     double point_emission_sum() const noexcept
     {
-        return std::accumulate(_pointEmissionEntries.cbegin(), _pointEmissionEntries.cend(), 0.0, [](double total, const auto& current) {
-            return total + current.value().amount().value_or(0.0);
-        });
+        return _pointEmissions.amount_sum();
     }
 
-    std::span<const EmissionEntry> point_emissions() const noexcept
+    const PointSourceTable& point_emissions() const noexcept
     {
-        return _pointEmissionEntries;
+        return _pointEmissions;
     }
 
-    std::vector<EmissionEntry> scaled_point_emissions() const noexcept
+    PointSourceTable scaled_point_emissions() const
     {
-        std::vector<EmissionEntry> result;
-        result.reserve(_pointEmissionEntries.size());
-        std::transform(_pointEmissionEntries.begin(), _pointEmissionEntries.end(), std::back_inserter(result), [this](const EmissionEntry& entry) {
-            auto scaledEntry = entry;
-            scaledEntry.set_value(entry.value() * _pointAutoScaling * _pointUserScaling);
-            return scaledEntry;
-        });
-        return result;
+        return _pointEmissions.scaled(_pointAutoScaling * _pointUserScaling);
     }
 
     bool has_point_emission(const EmissionIdentifier& id, std::string_view sourceId) const noexcept
     {
-        return std::any_of(_pointEmissionEntries.begin(), _pointEmissionEntries.end(), [&](const EmissionEntry& em) {
+        return std::any_of(_pointEmissions.begin(), _pointEmissions.end(), [&](const PointSourceRow& em) {
             return em.id() == id && em.source_id() == sourceId;
         });
     }
 
-    void add_point_emission(EmissionEntry&& entry) noexcept
+    void add_point_emission(const EmissionEntry& entry)
     {
-        _pointEmissionEntries.push_back(std::move(entry));
+        _pointEmissions.push_back(entry);
     }
 
     double scaled_total_emissions_sum() const noexcept
@@ -135,7 +137,7 @@ public:
 private:
     EmissionIdentifier _id;
     double _diffuseEmission = 0.0;
-    std::vector<EmissionEntry> _pointEmissionEntries;
+    PointSourceTable _pointEmissions;
     double _pointAutoScaling   = 1.0; // Automatic correction of the point sources when they exceed the total emission
     double _pointUserScaling   = 1.0; // User defined scaling of the point sources
     double _diffuseAutoScaling = 1.0;
@@ -227,13 +229,24 @@ public:
     }
 
     const TEmission& emission_with_id(const EmissionIdentifier& id) const
+    {
+        if (const auto* emission = find_emission_with_id(id); emission != nullptr) {
+            return *emission;
+        }
+
+        throw inf::RuntimeError("No emission found with id: {}", id);
+    }
+
+    /* Returns nullptr when there is no emission with the given id
+     * The pointer is invalidated when emissions are added to the collection */
+    const TEmission* find_emission_with_id(const EmissionIdentifier& id) const noexcept
     {
         auto emissionIter = find_sorted(id);
         if (emissionIter != _emissions.end() && emissionIter->id() == id) {
-            return *emissionIter;
+            return &(*emissionIter);
         }
 
-        throw inf::RuntimeError("No emission found with id: {}", id);
+        return nullptr;
     }
 
     const TEmission& emission_with_id_at_coordinate(const EmissionIdentifier& id, Coordinate coord) const
@@ -258,9 +271,8 @@ public:
 
     std::optional<TEmission> try_emission_with_id(const EmissionIdentifier& id) const noexcept
     {
-        auto emissionIter = find_sorted(id);
-        if (emissionIter != _emissions.end() && emissionIter->id() == id) {
-            return *emissionIter;
+        if (const auto* emission = find_emission_with_id(id); emission != nullptr) {
+            return *emission;
         }
 
         return {};
@@ -268,12 +280,16 @@ public:
 
     std::vector<TEmission> emissions_with_id(const EmissionIdentifier& id) const
     {
-        std::vector<TEmission> result;
-        std::copy_if(_emissions.begin(), _emissions.end(), std::back_inserter(result), [&id](const TEmission& em) {
-            return em.id() == id;
-        });
+        const auto range = emission_range_with_id(id);
+        return std::vector<TEmission>(range.begin(), range.end());
+    }
 
-        return result;
+    /* The emissions are sorted on their id, so all the emissions with the same id are contiguous
+     * The span is invalidated when emissions are added to the collection */
+    std::span<const TEmission> emission_range_with_id(const EmissionIdentifier& id) const noexcept
+    {
+        auto [begin, end] = std::equal_range(_emissions.begin(), _emissions.end(), id.key(), KeyCompare());
+        return std::span<const TEmission>(begin, end);
     }
 
     std::vector<TEmission> emissions_with_id_at_coordinate(const EmissionIdentifier& id, Coordinate coord) const
@@ -332,22 +348,31 @@ private:
     void sort_emissions()
     {
         std::sort(_emissions.begin(), _emissions.end(), [](const TEmission& lhs, const TEmission& rhs) {
-            return lhs.id() < rhs.id();
+            return lhs.id().key() < rhs.id().key();
         });
     }
 
+    struct KeyCompare
+    {
+        bool operator()(const TEmission& lhs, EmissionKey key) const noexcept
+        {
+            return lhs.id().key() < key;
+        }
+
+        bool operator()(EmissionKey key, const TEmission& rhs) const noexcept
+        {
+            return key < rhs.id().key();
+        }
+    };
+
     auto find_sorted(const EmissionIdentifier& id)
     {
-        return std::lower_bound(_emissions.begin(), _emissions.end(), id, [](const TEmission& lhs, const EmissionIdentifier& id) {
-            return lhs.id() < id;
-        });
+        return std::lower_bound(_emissions.begin(), _emissions.end(), id.key(), KeyCompare());
     }
 
     auto find_sorted(const EmissionIdentifier& id) const
     {
-        return std::lower_bound(_emissions.begin(), _emissions.end(), id, [](const TEmission& lhs, const EmissionIdentifier& id) {
-            return lhs.id() < id;
-        });
+        return std::lower_bound(_emissions.begin(), _emissions.end(), id.key(), KeyCompare());
     }
 
     date::year _year;
@@ -397,6 +422,8 @@ EmissionInventory create_emission_inventory(SingleEmissions totalEmissionsNfr,
                                             RunSummary& runSummary);
 
 SingleEmissions read_nfr_emissions(date::year year, const RunConfiguration& cfg, RunSummary& runSummary);
+// Reads the nfr emissions of all the requested years, the result contains the emissions in the order of the requested years
+std::vector<SingleEmissions> read_nfr_emissions(std::span<const date::year> years, const RunConfiguration& cfg, RunSummary& runSummary);
 SingleEmissions read_country_point_sources(const RunConfiguration& cfg, const Country& country, RunSummary& runSummary);
 
 EmissionInventory make_emission_inventory(const RunConfiguration& cfg, RunSummary& summary);
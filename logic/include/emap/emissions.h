@@ -9,12 +9,15 @@
 #include "infra/point.h"
 #include "infra/span.h"
 
+#include <compare>
+#include <cstdint>
 #include <date/date.h>
 #include <fmt/core.h>
 #include <numeric>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace emap {
@@ -71,6 +74,40 @@ private:
     std::optional<double> _amount;
 };
 
+/* Packed identification of an emission: the country id, the sector id and type and the pollutant ordinal
+ * Trivially copyable, comparisons and hashing are integer operations
+ * The ordering matches the country, sector, pollutant order of the emission identifier */
+class EmissionKey
+{
+public:
+    constexpr EmissionKey() noexcept = default;
+    EmissionKey(const Country& country, const EmissionSector& sector, const Pollutant& pollutant) noexcept
+    {
+        const auto sectorType = sector.type() == EmissionSector::Type::Gnfr ? 1u : 0u;
+        const auto sectorId   = (static_cast<uint64_t>(static_cast<uint32_t>(sector.id())) << 1) | sectorType;
+
+        _value = (static_cast<uint64_t>(static_cast<uint32_t>(static_cast<int32_t>(country.id())) & s_countryMask) << s_countryShift) |
+                 ((sectorId & s_sectorMask) << s_sectorShift) |
+                 static_cast<uint64_t>(pollutant.ordinal());
+    }
+
+    constexpr uint64_t value() const noexcept
+    {
+        return _value;
+    }
+
+    constexpr auto operator<=>(const EmissionKey& other) const noexcept = default;
+
+private:
+    // 20 bits country | 28 bits sector (id and type) | 16 bits pollutant
+    static constexpr uint64_t s_countryShift = 44;
+    static constexpr uint64_t s_sectorShift  = 16;
+    static constexpr uint64_t s_countryMask  = (uint64_t(1) << 20) - 1;
+    static constexpr uint64_t s_sectorMask   = (uint64_t(1) << 28) - 1;
+
+    uint64_t _value = 0;
+};
+
 struct EmissionIdentifier
 {
     EmissionIdentifier() noexcept = default;
@@ -81,9 +118,14 @@ struct EmissionIdentifier
     {
     }
 
+    EmissionKey key() const noexcept
+    {
+        return EmissionKey(country, sector, pollutant);
+    }
+
     bool operator==(const EmissionIdentifier& other) const noexcept
     {
-        return country == other.country && sector == other.sector && pollutant == other.pollutant;
+        return key() == other.key();
     }
 
     bool operator!=(const EmissionIdentifier& other) const noexcept
@@ -93,17 +135,7 @@ struct EmissionIdentifier
 
     bool operator<(const EmissionIdentifier& other) const noexcept
     {
-        if (country.id() < other.country.id()) {
-            return true;
-        } else if (country.id() == other.country.id()) {
-            if (sector.id() < other.sector.id()) {
-                return true;
-            } else if (sector.id() == other.sector.id()) {
-                return pollutant.code() < other.pollutant.code();
-            }
-        }
-
-        return false;
+        return key() < other.key();
     }
 
     EmissionIdentifier with_pollutant(const Pollutant& pol) const noexcept
@@ -121,6 +153,9 @@ struct EmissionIdentifier
     Pollutant pollutant;
 };
 
+// Copying identifiers happens in the hot paths, it should not allocate
+static_assert(std::is_trivially_copyable_v<EmissionIdentifier>);
+
 class EmissionEntry
 {
 public:
@@ -332,14 +367,21 @@ struct fmt::formatter<emap::EmissionSector::Type>
 };
 
 namespace std {
+template <>
+struct hash<emap::EmissionKey>
+{
+    size_t operator()(const emap::EmissionKey& key) const noexcept
+    {
+        return hash<uint64_t>()(key.value());
+    }
+};
+
 template <>
 struct hash<emap::EmissionIdentifier>
 {
-    size_t operator()(const emap::EmissionIdentifier& id) const
+    size_t operator()(const emap::EmissionIdentifier& id) const noexcept
     {
-        size_t seed = 0;
-        inf::hash_combine(seed, id.country.id(), id.pollutant.code(), id.sector.id());
-        return seed;
+        return hash<emap::EmissionKey>()(id.key());
     }
 };
 }
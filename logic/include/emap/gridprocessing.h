@@ -3,6 +3,7 @@
 #include "emap/country.h"
 #include "emap/griddefinition.h"
 #include "emap/sector.h"
+#include "emap/sparseraster.h"
 #include "infra/filesystem.h"
 
 #include "infra/gdalalgo.h"
@@ -70,16 +71,18 @@ struct CountryCellCoverage
 
 // normalizes the raster so the sum is 1
 void normalize_raster(gdx::DenseRaster<double>& ras) noexcept;
+void normalize_raster(SparseRaster& ras) noexcept;
 
 // Add cells from the country raster to the collected raster, extents do not have to match
 void add_to_raster(gdx::DenseRaster<double>& collectedRaster, const gdx::DenseRaster<double>& countryRaster);
+void add_to_raster(gdx::DenseRaster<double>& collectedRaster, const SparseRaster& countryRaster);
 
 inf::gdal::VectorDataSet transform_vector(const fs::path& vectorPath, const inf::GeoMetadata& destMeta);
 
 gdx::DenseRaster<double> transform_grid(const gdx::DenseRaster<double>& ras, GridDefinition grid, inf::gdal::ResampleAlgorithm algo = inf::gdal::ResampleAlgorithm::Average);
 gdx::DenseRaster<double> read_raster_north_up(const fs::path& rasterInput, const inf::GeoMetadata& extent);
 
-gdx::DenseRaster<double> spread_values_uniformly_over_cells(double valueToSpread, const CountryCellCoverage& countryCoverage);
+SparseRaster spread_values_uniformly_over_cells(double valueToSpread, const CountryCellCoverage& countryCoverage);
 
 inf::GeoMetadata create_geometry_extent(const geos::geom::Geometry& geom, const inf::GeoMetadata& gridExtent);
 inf::GeoMetadata create_geometry_extent(const geos::geom::Geometry& geom, const inf::GeoMetadata& gridExtent, const inf::gdal::SpatialReference& sourceProjection);
@@ -108,11 +111,16 @@ std::vector<CountryCellCoverage> create_country_coverages(const inf::GeoMetadata
 // cuts out the country from the raster based on the cellcoverages, the output extent will be the same as that from the input
 gdx::DenseRaster<double> extract_country_from_raster(const gdx::DenseRaster<double>& rasterInput, const CountryCellCoverage& countryCoverage);
 gdx::DenseRaster<double> extract_country_from_raster(const fs::path& rasterInput, const CountryCellCoverage& countryCoverage);
+// same as extract_country_from_raster, but only the cells of the country are stored
+// the values of a float raster are stored in single precision
+SparseRaster extract_country_cells_from_raster(const gdx::DenseRaster<double>& rasterInput, const CountryCellCoverage& countryCoverage);
+SparseRaster extract_country_cells_from_raster(const gdx::DenseRaster<float>& rasterInput, const CountryCellCoverage& countryCoverage);
 
 // generator<std::pair<gdx::DenseRaster<double>, Country>> extract_countries_from_raster(const fs::path& rasterInput, GnfrSector gnfrSector, std::span<const CountryCellCoverage> countries);
 
 void erase_area_in_raster(gdx::DenseRaster<double>& rasterInput, const inf::GeoMetadata& extent);
 double erase_area_in_raster_and_sum_erased_values(gdx::DenseRaster<double>& rasterInput, const inf::GeoMetadata& extent);
+double erase_area_in_raster_and_sum_erased_values(SparseRaster& rasterInput, const inf::GeoMetadata& extent);
 
 }
 
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "emap/caseinsensitivemap.h"
 #include "emap/country.h"
 #include "infra/string.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 namespace emap {
 
@@ -18,9 +24,25 @@ public:
     {
     }
 
+    std::string_view name() const noexcept
+    {
+        return _name;
+    }
+
     bool is_ignored_for_country(std::string_view name, CountryId country) const noexcept
     {
-        return is_ignored(name) && _countryExceptions.count(country) == 0;
+        return is_ignored(name) && is_ignored_for_country(country);
+    }
+
+    // Check the country exceptions only, the caller already matched the name
+    bool is_ignored_for_country(CountryId country) const noexcept
+    {
+        return _countryExceptions.count(country) == 0;
+    }
+
+    const std::unordered_set<CountryId>& country_exceptions() const noexcept
+    {
+        return _countryExceptions;
     }
 
 private:
@@ -33,4 +55,78 @@ private:
     std::unordered_set<CountryId> _countryExceptions;
 };
 
+/* The ignored names compiled into a dense mask with one row per (case insensitive) name and one column per country number
+ * Checking a name is a single hash probe and a bit test, callers that resolved the row up front only need the bit test */
+class IgnoredNames
+{
+public:
+    IgnoredNames() noexcept = default;
+    IgnoredNames(const std::vector<IgnoredName>& names)
+    {
+        // The same name can be configured multiple times with different country exceptions
+        std::vector<std::vector<const IgnoredName*>> rules;
+        int32_t maxCountry = -1;
+        for (auto& name : names) {
+            auto [iter, inserted] = _rows.try_emplace(std::string(name.name()), rules.size());
+            if (inserted) {
+                rules.emplace_back();
+            }
+
+            rules[iter->second].push_back(&name);
+            for (auto& country : name.country_exceptions()) {
+                maxCountry = std::max(maxCountry, static_cast<int32_t>(country));
+            }
+        }
+
+        // the last column is used for the countries without any exception configured
+        _columns = static_cast<size_t>(maxCountry + 2);
+        _mask.resize((rules.size() * _columns + 63) / 64);
+
+        for (size_t row = 0; row < rules.size(); ++row) {
+            for (size_t column = 0; column < _columns; ++column) {
+                const bool ignored = column + 1 == _columns || std::any_of(rules[row].begin(), rules[row].end(), [country = CountryId(static_cast<int32_t>(column))](const IgnoredName* rule) {
+                                         return rule->is_ignored_for_country(country);
+                                     });
+
+                if (ignored) {
+                    const auto bit = row * _columns + column;
+                    _mask[bit / 64] |= uint64_t(1) << (bit % 64);
+                }
+            }
+        }
+    }
+
+    // The row of the name in the ignore mask, empty when the name is not in the ignore list
+    std::optional<size_t> row(std::string_view name) const noexcept
+    {
+        if (auto iter = _rows.find(name); iter != _rows.end()) {
+            return iter->second;
+        }
+
+        return {};
+    }
+
+    bool is_ignored_for_country(size_t row, CountryId country) const noexcept
+    {
+        const auto countryNumber = static_cast<int32_t>(country);
+        const auto column        = (countryNumber >= 0 && static_cast<size_t>(countryNumber) + 1 < _columns) ? static_cast<size_t>(countryNumber) : _columns - 1;
+        const auto bit           = row * _columns + column;
+        return (_mask[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    bool is_ignored_for_country(std::string_view name, CountryId country) const noexcept
+    {
+        if (auto nameRow = row(name); nameRow.has_value()) {
+            return is_ignored_for_country(*nameRow, country);
+        }
+
+        return false;
+    }
+
+private:
+    CaseInsensitiveMap<size_t> _rows;
+    size_t _columns = 0;
+    std::vector<uint64_t> _mask;
+};
+
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "emap/caseinsensitivemap.h"
 #include "infra/exception.h"
 #include "infra/string.h"
 
 #include <algorithm>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -20,38 +22,31 @@ public:
             return conv.first == key;
         });
 
+        size_t keyIndex = 0;
         if (iter == _conversions.end()) {
+            keyIndex = _conversions.size();
             _conversions.emplace_back(key, std::vector<LookupEntry>({LookupEntry(priority.value_or(1), std::string(value))}));
         } else {
+            keyIndex = std::distance(_conversions.begin(), iter);
             iter->second.emplace_back(priority.value_or(1), value);
         }
+
+        // When a value is configured for multiple keys, the key that was added first wins
+        auto [lookupIter, inserted] = _lookup.try_emplace(std::string(value), LookupResult{keyIndex, priority.value_or(1)});
+        if (!inserted && keyIndex < lookupIter->second.keyIndex) {
+            lookupIter->second = LookupResult{keyIndex, priority.value_or(1)};
+        }
     }
 
     std::string_view lookup(std::string_view str) const noexcept
     {
-        for (const auto& [key, conversions] : _conversions) {
-            auto iter = std::find_if(conversions.begin(), conversions.end(), [str](const LookupEntry& entry) {
-                return inf::str::iequals(str, entry.value);
-            });
-
-            if (iter != conversions.end()) {
-                return key;
-            }
-        }
-
-        return {};
+        return lookup_with_priority(str).first;
     }
 
     std::pair<std::string_view, int32_t> lookup_with_priority(std::string_view str) const noexcept
     {
-        for (const auto& [key, conversions] : _conversions) {
-            auto iter = std::find_if(conversions.begin(), conversions.end(), [str](const LookupEntry& entry) {
-                return inf::str::iequals(str, entry.value);
-            });
-
-            if (iter != conversions.end()) {
-                return {key, iter->priority};
-            }
+        if (auto iter = _lookup.find(str); iter != _lookup.end()) {
+            return {_conversions[iter->second.keyIndex].first, iter->second.priority};
         }
 
         return {};
@@ -71,6 +66,14 @@ private:
         std::string value;
     };
 
+    struct LookupResult
+    {
+        size_t keyIndex  = 0;
+        int32_t priority = 1;
+    };
+
     std::vector<std::pair<std::string, std::vector<LookupEntry>>> _conversions;
+    // Case insensitive index of all the configured values, refers to the key in the conversions
+    CaseInsensitiveMap<LookupResult> _lookup;
 };
 }
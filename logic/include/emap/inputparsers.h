@@ -7,7 +7,9 @@
 #include "infra/filesystem.h"
 #include "infra/range.h"
 
+#include <cstddef>
 #include <date/date.h>
+#include <span>
 #include <vector>
 
 namespace emap {
@@ -25,10 +27,14 @@ enum class RespectIgnoreList
 
 static inf::Range<date::year> AllYears = inf::Range<date::year>(date::year(0), date::year(9999));
 
+// The emission files are parsed concurrently in line aligned chunks of approximately this size
+static constexpr size_t DefaultParseChunkSize = 1024 * 1024;
+
 inf::Range<date::year> parse_year_range(std::string_view yearRange);
 
-SingleEmissions parse_emissions(EmissionSector::Type sectorType, const fs::path& emissionsCsv, date::year requestYear, const RunConfiguration& cfg, RespectIgnoreList respectIgnores);
+SingleEmissions parse_emissions(EmissionSector::Type sectorType, const fs::path& emissionsCsv, date::year requestYear, const RunConfiguration& cfg, RespectIgnoreList respectIgnores, size_t chunkSize = DefaultParseChunkSize);
 SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::year year, const RunConfiguration& cfg);
+std::vector<SingleEmissions> parse_emissions_belgium(const fs::path& emissionsData, std::span<const date::year> years, const RunConfiguration& cfg);
 SingleEmissions parse_point_sources(const fs::path& emissionsCsv, const RunConfiguration& cfg);
 ScalingFactors parse_scaling_factors(const fs::path& scalingFactors, const RunConfiguration& cfg);
 
@@ -38,6 +38,7 @@ public:
     fs::path eez_boundaries_vector_path() const noexcept;
 
     fs::path output_dir_for_rasters() const;
+    fs::path cache_dir_path() const;
     fs::path output_path_for_country_raster(const EmissionIdentifier& id, const GridData& grid) const;
     fs::path output_path_for_grid_raster(const Pollutant& pol, const EmissionSector& sector, const GridData& grid) const;
     fs::path output_path_for_spatial_pattern_raster(const EmissionIdentifier& id, const GridData& grid) const;
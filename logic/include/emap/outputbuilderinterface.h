@@ -8,7 +8,8 @@
 
 namespace emap {
 
-class EmissionEntry;
+class PointSourceRow;
+class SparseRaster;
 struct EmissionIdentifier;
 
 class IOutputBuilder
@@ -22,8 +23,10 @@ public:
 
     virtual ~IOutputBuilder() = default;
 
-    virtual void add_point_output_entry(const EmissionEntry& emission)                                                                = 0;
+    virtual void add_point_output_entry(const PointSourceRow& emission)                                                               = 0;
     virtual void add_diffuse_output_entry(const EmissionIdentifier& id, inf::Point<double> loc, double emission, int32_t cellSizeInM) = 0;
+    // Adds all the non zero cells of the raster as diffuse emissions, the cell locations are obtained from the raster metadata
+    virtual void add_diffuse_output_entries(const EmissionIdentifier& id, const SparseRaster& emissions) = 0;
 
     // Pollutant calculation finished, results can be flushed to save on memory
     virtual void flush_pollutant(const Pollutant& pol, WriteMode mode) = 0;
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "emap/emissions.h"
+
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace emap {
+
+class PointSourceTable;
+
+// Lightweight read only view on a row of a point source table, offers the same accessors as the EmissionEntry
+class PointSourceRow
+{
+public:
+    PointSourceRow(const PointSourceTable& table, size_t index) noexcept
+    : _table(&table)
+    , _index(index)
+    {
+    }
+
+    size_t index() const noexcept
+    {
+        return _index;
+    }
+
+    const EmissionIdentifier& id() const noexcept;
+    EmissionValue value() const noexcept;
+    std::optional<Coordinate> coordinate() const noexcept;
+    double height() const noexcept;
+    double diameter() const noexcept;
+    double temperature() const noexcept;
+    double warmth_contents() const noexcept;
+    double flow_rate() const noexcept;
+    std::optional<int32_t> dv() const noexcept;
+    std::string_view source_id() const noexcept;
+
+    EmissionSector sector() const noexcept
+    {
+        return id().sector;
+    }
+
+    Country country() const noexcept
+    {
+        return id().country;
+    }
+
+    Pollutant pollutant() const noexcept
+    {
+        return id().pollutant;
+    }
+
+    // Copy of the row as a standalone emission entry
+    EmissionEntry to_entry() const;
+
+private:
+    friend class PointSourceTable;
+
+    const PointSourceTable* _table;
+    size_t _index;
+};
+
+/* Columnar storage of point sources
+ * Every property is stored in a separate array so sums and scaling only touch the values they need
+ * The source ids are interned per table, the rows only store an index in the source id list */
+class PointSourceTable
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = PointSourceRow;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = PointSourceRow;
+
+        const_iterator() noexcept = default;
+        const_iterator(const PointSourceTable& table, size_t index) noexcept
+        : _table(&table)
+        , _index(index)
+        {
+        }
+
+        PointSourceRow operator*() const noexcept
+        {
+            return PointSourceRow(*_table, _index);
+        }
+
+        const_iterator& operator++() noexcept
+        {
+            ++_index;
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++_index;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const noexcept
+        {
+            return _index == other._index;
+        }
+
+    private:
+        const PointSourceTable* _table = nullptr;
+        size_t _index                  = 0;
+    };
+
+    PointSourceTable() = default;
+    explicit PointSourceTable(std::span<const EmissionEntry> entries);
+
+    size_t size() const noexcept
+    {
+        return _ids.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return _ids.empty();
+    }
+
+    PointSourceRow operator[](size_t index) const noexcept
+    {
+        return PointSourceRow(*this, index);
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return const_iterator(*this, 0);
+    }
+
+    const_iterator end() const noexcept
+    {
+        return const_iterator(*this, size());
+    }
+
+    void reserve(size_t size);
+    void push_back(const EmissionEntry& entry);
+    void push_back(const PointSourceRow& row);
+
+    // Sum of the available amounts
+    double amount_sum() const noexcept;
+    // Copy of the table with all the amounts multiplied by the factor, missing amounts become 0
+    PointSourceTable scaled(double factor) const;
+
+private:
+    friend class PointSourceRow;
+
+    enum Flags : uint8_t
+    {
+        HasAmount     = 1 << 0,
+        HasCoordinate = 1 << 1,
+        HasDv         = 1 << 2,
+    };
+
+    struct StackParameters
+    {
+        double height         = 0.0;
+        double diameter       = 0.0;
+        double temperature    = 0.0;
+        double warmthContents = 0.0;
+        double flowRate       = 0.0;
+    };
+
+    void push_back(const EmissionIdentifier& id, std::optional<double> amount, std::optional<Coordinate> coordinate, const StackParameters& stack, std::optional<int32_t> dv, std::string_view sourceId);
+    uint32_t intern_source_id(std::string_view sourceId);
+
+    std::vector<EmissionIdentifier> _ids;
+    std::vector<double> _amounts;
+    std::vector<double> _x;
+    std::vector<double> _y;
+    std::vector<StackParameters> _stacks;
+    std::vector<int32_t> _dv;
+    std::vector<uint8_t> _flags;
+    std::vector<uint32_t> _sourceIds; // index in _sourceIdNames
+    std::vector<std::string> _sourceIdNames;
+    std::unordered_map<std::string, uint32_t> _sourceIdIndexes;
+};
+
+inline const EmissionIdentifier& PointSourceRow::id() const noexcept
+{
+    return _table->_ids[_index];
+}
+
+inline EmissionValue PointSourceRow::value() const noexcept
+{
+    if (_table->_flags[_index] & PointSourceTable::HasAmount) {
+        return EmissionValue(_table->_amounts[_index]);
+    }
+
+    return EmissionValue();
+}
+
+inline std::optional<Coordinate> PointSourceRow::coordinate() const noexcept
+{
+    if (_table->_flags[_index] & PointSourceTable::HasCoordinate) {
+        return Coordinate(_table->_x[_index], _table->_y[_index]);
+    }
+
+    return {};
+}
+
+inline double PointSourceRow::height() const noexcept
+{
+    return _table->_stacks[_index].height;
+}
+
+inline double PointSourceRow::diameter() const noexcept
+{
+    return _table->_stacks[_index].diameter;
+}
+
+inline double PointSourceRow::temperature() const noexcept
+{
+    return _table->_stacks[_index].temperature;
+}
+
+inline double PointSourceRow::warmth_contents() const noexcept
+{
+    return _table->_stacks[_index].warmthContents;
+}
+
+inline double PointSourceRow::flow_rate() const noexcept
+{
+    return _table->_stacks[_index].flowRate;
+}
+
+inline std::optional<int32_t> PointSourceRow::dv() const noexcept
+{
+    if (_table->_flags[_index] & PointSourceTable::HasDv) {
+        return _table->_dv[_index];
+    }
+
+    return {};
+}
+
+inline std::string_view PointSourceRow::source_id() const noexcept
+{
+    return _table->_sourceIdNames[_table->_sourceIds[_index]];
+}
+
+}
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "emap/caseinsensitivemap.h"
 #include "emap/country.h"
 #include "emap/ignoredname.h"
 #include "emap/inputconversion.h"
 #include "infra/span.h"
 
+#include <cstdint>
 #include <fmt/core.h>
 #include <optional>
 #include <string_view>
@@ -14,29 +16,31 @@
 
 namespace emap {
 
+/* Returns the ordinal of the pollutant code, identical codes always get the same ordinal
+ * Ordinals are assigned in the order the codes are encountered, 0 is the ordinal of the empty code */
+uint16_t pollutant_code_ordinal(std::string_view code);
+
+/* Trivially copyable pollutant handle, the code and name are interned in a process wide store
+ * Copies of the pollutant do not allocate */
 class Pollutant
 {
 public:
-    Pollutant() = default;
-    Pollutant(std::string_view code, std::string_view name)
-    : _code(code)
-    , _name(name)
-    {
-    }
+    Pollutant() noexcept = default;
+    Pollutant(std::string_view code, std::string_view name);
 
-    std::string_view code() const noexcept
-    {
-        return _code;
-    }
+    std::string_view code() const noexcept;
 
-    std::string_view full_name() const noexcept
+    // Small integer that identifies the pollutant code, used for packing emission keys
+    uint16_t ordinal() const noexcept
     {
-        return _name;
+        return _ordinal;
     }
 
+    std::string_view full_name() const noexcept;
+
     bool operator==(const Pollutant& other) const noexcept
     {
-        return _code == other._code;
+        return _ordinal == other._ordinal;
     }
 
     bool operator!=(const Pollutant& other) const noexcept
@@ -45,8 +49,8 @@ public:
     }
 
 private:
-    std::string _code;
-    std::string _name;
+    uint32_t _info    = 0; // index of the code and name in the interned pollutant info
+    uint16_t _ordinal = 0;
 };
 
 }
@@ -57,7 +61,7 @@ struct hash<emap::Pollutant>
 {
     size_t operator()(const emap::Pollutant& pollutant) const
     {
-        return hash<std::string_view>()(pollutant.code());
+        return hash<uint16_t>()(pollutant.ordinal());
     }
 };
 }
@@ -85,8 +89,10 @@ public:
 private:
     std::vector<Pollutant> _pollutants;
     std::unordered_map<Pollutant, Pollutant> _pollutantFallbacks;
-    std::vector<IgnoredName> _ignoredPollutants;
+    IgnoredNames _ignoredPollutants;
     InputConversions _conversions;
+    // Case insensitive index of the pollutant codes in the pollutant list
+    CaseInsensitiveMap<size_t> _codeIndex;
 };
 
 }
@@ -31,6 +31,29 @@ enum class ValidationType
     SumValidation,
 };
 
+enum class RasterCompression
+{
+    None,
+    Deflate,
+    Zstd,
+};
+
+// GeoTIFF creation options of the output rasters
+struct RasterOutputOptions
+{
+    RasterCompression compression = RasterCompression::None;
+    bool tiled                    = false;
+    int32_t tileSize              = 256;
+    bool predictor                = false; // floating point predictor, improves the compression ratio
+    bool overviews                = false;
+    bool cloudOptimized           = false; // tiled with overviews in the cloud optimized GeoTIFF layout
+
+    bool is_default() const noexcept
+    {
+        return compression == RasterCompression::None && !tiled && !predictor && !overviews && !cloudOptimized;
+    }
+};
+
 class RunConfiguration
 {
 public:
@@ -43,6 +66,7 @@ public:
         bool createGridRasters           = false;
         bool createSpatialPatternRasters = false;
         bool separatePointSources        = false;
+        RasterOutputOptions rasterOptions;
     };
 
     RunConfiguration(
@@ -80,6 +104,7 @@ public:
     void set_data_root(const fs::path& root);
 
     const fs::path& output_path() const noexcept;
+    fs::path cache_dir_path() const;
     const fs::path& spatial_pattern_exceptions() const noexcept;
     const fs::path& emission_scalings_path() const noexcept;
     fs::path boundaries_vector_path() const noexcept;
@@ -106,6 +131,14 @@ public:
     void set_max_concurrency(std::optional<int32_t> concurrency) noexcept;
     std::optional<int32_t> max_concurrency() const noexcept;
 
+    // Store the spatial patterns in single precision, the emission totals are always calculated in double precision
+    void set_single_precision_spatial_patterns(bool enabled) noexcept;
+    bool single_precision_spatial_patterns() const noexcept;
+
+    // Store the built emission inventory in the cache directory and reuse it when none of its inputs changed
+    void set_emission_inventory_snapshot(bool enabled) noexcept;
+    bool emission_inventory_snapshot() const noexcept;
+
     std::vector<Pollutant> included_pollutants() const;
     bool pollutant_is_included(std::string_view pollutant) const noexcept;
 
@@ -120,6 +153,7 @@ public:
     bool output_grid_rasters() const noexcept;
     bool output_spatial_pattern_rasters() const noexcept;
     bool output_point_sources_separately() const noexcept;
+    const RasterOutputOptions& output_raster_options() const noexcept;
     fs::path output_dir_for_rasters() const;
     fs::path output_path_for_country_raster(const EmissionIdentifier& id, const GridData& grid) const;
     fs::path output_path_for_grid_raster(const Pollutant& pol, const EmissionSector& sector, const GridData& grid) const;
@@ -144,6 +178,8 @@ private:
     CountryInventory _countryInventory;
 
     std::optional<int32_t> _concurrency;
+    bool _singlePrecisionSpatialPatterns = false;
+    bool _emissionInventorySnapshot      = false;
 
     Output _outputConfig;
 };
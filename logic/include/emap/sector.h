@@ -4,6 +4,7 @@
 #include "emap/inputconversion.h"
 #include "infra/span.h"
 
+#include <cstdint>
 #include <fmt/core.h>
 #include <optional>
 #include <span>
@@ -31,6 +32,8 @@ struct NfrId : type_safe::strong_typedef<NfrId, int32_t>,
     using strong_typedef::strong_typedef;
 };
 
+/* The sectors are trivially copyable handles, the names and descriptions are interned in a process wide store
+ * Copies of the sectors do not allocate */
 class GnfrSector
 {
 public:
@@ -40,20 +43,9 @@ public:
 
     GnfrSector(std::string_view name, GnfrId id, std::string_view code, std::string_view description, EmissionDestination destination);
 
-    std::string_view code() const noexcept
-    {
-        return _code;
-    }
-
-    std::string_view name() const noexcept
-    {
-        return _name;
-    }
-
-    std::string_view description() const noexcept
-    {
-        return _description;
-    }
+    std::string_view code() const noexcept;
+    std::string_view name() const noexcept;
+    std::string_view description() const noexcept;
 
     GnfrId id() const noexcept
     {
@@ -88,9 +80,7 @@ public:
 private:
     GnfrId _id;
     EmissionDestination _destination = EmissionDestination::Invalid;
-    std::string _code;
-    std::string _name;
-    std::string _description;
+    uint32_t _info                   = 0; // index of the code, name and description in the interned sector info
 };
 
 class NfrSector
@@ -102,20 +92,9 @@ public:
 
     NfrSector(std::string_view name, NfrId id, GnfrSector gnfr, std::string_view description, EmissionDestination destination);
 
-    std::string_view name() const noexcept
-    {
-        return _name;
-    }
-
-    std::string_view code() const noexcept
-    {
-        return _name;
-    }
-
-    std::string_view description() const noexcept
-    {
-        return _description;
-    }
+    std::string_view name() const noexcept;
+    std::string_view code() const noexcept;
+    std::string_view description() const noexcept;
 
     NfrId id() const noexcept
     {
@@ -156,8 +135,7 @@ private:
     NfrId _id;
     EmissionDestination _destination = EmissionDestination::Invalid;
     GnfrSector _gnfr;
-    std::string _name;
-    std::string _description;
+    uint32_t _info = 0; // index of the name and description in the interned sector info
 };
 
 class EmissionSector
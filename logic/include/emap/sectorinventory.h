@@ -1,9 +1,11 @@
 #pragma once
 
+#include "emap/caseinsensitivemap.h"
 #include "emap/ignoredname.h"
 #include "emap/sector.h"
 #include "infra/span.h"
 
+#include <optional>
 #include <string_view>
 #include <type_safe/strong_typedef.hpp>
 #include <unordered_map>
@@ -47,6 +49,8 @@ public:
     size_t nfr_sector_count() const noexcept;
 
     bool is_ignored_nfr_sector(std::string_view str, const Country& country) const noexcept;
+    // Same result as checking the code of the sector, but only costs a bit test for the configured sectors
+    bool is_ignored_nfr_sector(const NfrSector& sector, const Country& country) const noexcept;
     bool is_ignored_gnfr_sector(std::string_view str, const Country& country) const noexcept;
     bool is_ignored_sector(EmissionSector::Type type, std::string_view str, const Country& country) const noexcept;
 
@@ -59,6 +63,10 @@ private:
     std::optional<std::pair<GnfrSector, int32_t>> try_gnfr_sector_with_priority_from_string(std::string_view str) const noexcept;
     std::optional<std::pair<NfrSector, int32_t>> try_nfr_sector_with_priority_from_string(std::string_view str) const noexcept;
 
+    const GnfrSector* find_gnfr_sector_with_code(std::string_view code) const noexcept;
+    const NfrSector* find_nfr_sector_with_code(std::string_view code) const noexcept;
+    const NfrSector* find_nfr_sector_with_name(std::string_view name) const noexcept;
+
     // List of sectors used by the emap model
     std::vector<GnfrSector> _gnfrSectors;
     std::vector<NfrSector> _nfrSectors;
@@ -68,8 +76,17 @@ private:
     InputConversions _nfrConversions;
 
     // List of sectors sector names that need to be ignored and never warned about
-    std::vector<IgnoredName> _ignoredGnfrSectors;
-    std::vector<IgnoredName> _ignoredNfrSectors;
+    IgnoredNames _ignoredGnfrSectors;
+    IgnoredNames _ignoredNfrSectors;
+
+    // Index in the sector lists, built on construction so name lookups do not scan the lists
+    StringMap<size_t> _gnfrCodeIndex;
+    StringMap<size_t> _nfrCodeIndex;
+    StringMap<size_t> _nfrNameIndex;
+    std::unordered_map<NfrId, size_t> _nfrIdIndex;
+
+    // Row of the code of every nfr sector in the ignore mask (same order as the nfr sector list)
+    std::vector<std::optional<size_t>> _nfrIgnoreRows;
 
     std::unordered_map<NfrId, std::string> _outputMapping;
 };
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "infra/cell.h"
+#include "infra/geometadata.h"
+
+#include <cstdint>
+#include <gdx/rasterfwd.h>
+#include <utility>
+#include <vector>
+
+namespace emap {
+
+/* Raster that only stores the cells containing data, all other cells are nodata
+ * The country spatial patterns and emissions only cover a fraction of their extent, so storing them dense is wasteful.
+ * The cells are stored in row major order, convert to a dense raster when it needs to be written to disk.
+ * The values can be stored in single precision to reduce the memory usage, sums are always accumulated in double precision. */
+class SparseRaster
+{
+public:
+    enum class Precision
+    {
+        Double,
+        Single,
+    };
+
+    SparseRaster() noexcept = default;
+    // Raster with the given extent that contains no data
+    explicit SparseRaster(const inf::GeoMetadata& meta, Precision precision = Precision::Double);
+    // Keeps the cells of the dense raster that are not nodata
+    explicit SparseRaster(const gdx::DenseRaster<double>& raster);
+    explicit SparseRaster(const gdx::DenseRaster<float>& raster);
+
+    const inf::GeoMetadata& metadata() const noexcept;
+
+    Precision precision() const noexcept;
+    // Converts the stored values to the requested precision
+    void set_precision(Precision precision);
+
+    // True when the raster has no extent, same meaning as an empty dense raster
+    bool empty() const noexcept;
+    bool contains_only_nodata() const noexcept;
+
+    // The number of cells that contain data
+    size_t size() const noexcept;
+    inf::Cell cell(size_t index) const noexcept;
+    double value(size_t index) const noexcept;
+
+    // Adds the values to the cells, cells that were nodata become data
+    void add_to_cells(std::vector<std::pair<inf::Cell, double>> cellValues);
+
+    double sum() const noexcept;
+    SparseRaster& operator*=(double factor) noexcept;
+    SparseRaster& operator/=(double divisor) noexcept;
+
+    // Returns the cells within the extent, the extent has to be aligned with the raster
+    SparseRaster sub_raster(const inf::GeoMetadata& extent) const;
+    // Marks the cells within the extent as nodata and returns the sum of the erased values
+    double erase_area_and_sum(const inf::GeoMetadata& extent);
+
+    gdx::DenseRaster<double> to_dense() const;
+
+private:
+    template <typename T>
+    void add_dense_cells(const gdx::DenseRaster<T>& raster);
+    void push_back(int32_t index, double value);
+    void resize(size_t size);
+    void move_cell(size_t from, size_t to) noexcept;
+
+    int32_t cell_index(inf::Cell cell) const noexcept;
+    // Offset of the top left cell of the extent in this raster
+    inf::Cell offset_of(const inf::GeoMetadata& extent) const noexcept;
+
+    inf::GeoMetadata _meta;
+    Precision _precision = Precision::Double;
+    std::vector<int32_t> _indexes;     // row major index of the cell in the extent, sorted
+    std::vector<double> _values;       // the cell values when stored in double precision
+    std::vector<float> _singleValues;  // the cell values when stored in single precision
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "emap/emissions.h"
+#include "emap/sparseraster.h"
 #include "gdx/denseraster.h"
 
 #include <date/date.h>
@@ -119,7 +120,7 @@ struct SpatialPattern
     }
 
     SpatialPatternSource source;
-    gdx::DenseRaster<double> raster;
+    SparseRaster raster;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace emap {
+
+/* FNV-1a hash of a string, unlike std::hash the result is identical between runs and platforms
+ * The transform is applied to every character before it is hashed (e.g. to ignore the case) */
+template <typename CharTransform>
+constexpr uint64_t stable_hash(std::string_view str, CharTransform&& transform) noexcept
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (auto c : str) {
+        hash ^= static_cast<unsigned char>(transform(c));
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+constexpr uint64_t stable_hash(std::string_view str) noexcept
+{
+    return stable_hash(str, [](char c) { return c; });
+}
+
+}
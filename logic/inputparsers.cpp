@@ -15,17 +15,28 @@
 #include "infra/log.h"
 #include "infra/string.h"
 #include "unitconversion.h"
+#include "xlsxreader.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cpl_port.h>
 #include <csv.h>
 #include <exception>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <map>
+#include <optional>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include <oneapi/tbb/parallel_for.h>
+
 namespace emap {
 
 using namespace inf;
@@ -99,17 +110,76 @@ Range<date::year> parse_year_range(std::string_view yearRange)
     throw RuntimeError("Invalid year range specification: {}", yearRange);
 }
 
-struct PointSourceIdentifier
+// Splits the contents in line aligned chunks of approximately the chunk size so they can be parsed concurrently
+static std::vector<std::string_view> split_in_line_chunks(std::string_view contents, size_t chunkSize)
+{
+    std::vector<std::string_view> chunks;
+    while (!contents.empty()) {
+        auto chunkEnd = contents.size();
+        if (chunkSize < contents.size()) {
+            if (const auto pos = contents.find('\n', chunkSize); pos != std::string_view::npos) {
+                chunkEnd = pos + 1;
+            }
+        }
+
+        chunks.push_back(contents.substr(0, chunkEnd));
+        contents.remove_prefix(chunkEnd);
+    }
+
+    return chunks;
+}
+
+// The file line number of the first line of every chunk
+static std::vector<size_t> chunk_line_numbers(std::span<const std::string_view> chunks)
+{
+    std::vector<size_t> result(chunks.size(), 1);
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        result[i] = result[i - 1] + std::count(chunks[i - 1].begin(), chunks[i - 1].end(), '\n');
+    }
+
+    return result;
+}
+
+// Calls the callback for every line in the chunk with the index of the line in the chunk, the line endings are stripped
+template <typename Callback>
+static void for_each_line(std::string_view chunk, Callback&& callback)
+{
+    size_t lineIndex = 0;
+    while (!chunk.empty()) {
+        const auto pos = chunk.find('\n');
+        auto line      = chunk.substr(0, pos);
+        chunk          = pos == std::string_view::npos ? std::string_view() : chunk.substr(pos + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        callback(line, lineIndex++);
+    }
+}
+
+// Splits the line in trimmed fields, returns false if the line does not contain the expected number of fields
+static bool split_fields(std::string_view line, char separator, std::span<std::string_view> fields) noexcept
+{
+    size_t fieldCount = 0;
+    while (fieldCount < fields.size()) {
+        const auto pos       = line.find(separator);
+        fields[fieldCount++] = str::trimmed_view(line.substr(0, pos));
+        if (pos == std::string_view::npos) {
+            return fieldCount == fields.size();
+        }
+
+        line.remove_prefix(pos + 1);
+    }
+
+    return false;
+}
+
+// Parsed line of a point source file, the string fields refer to the file contents
+struct PointSourceRecord
 {
-    std::string type;
-    std::string scenario;
-    chrono::year year;
-    Country country;
-    EmissionSector sector;
-    Pollutant pollutant;
-    std::string eilNumber;
-    std::string eilPoint;
-    std::string subType;
+    EmissionIdentifier id;
+    double emission = 0.0;
     std::optional<Coordinate> coordinate;
     std::optional<int32_t> dv;
     double height         = 0.0;
@@ -117,23 +187,41 @@ struct PointSourceIdentifier
     double temperature    = 0.0;
     double warmthContents = 0.0;
     double flowRate       = 0.0;
+    std::string_view eilNumber;
+    std::string_view eilPoint;
+    std::string_view subType;
+    size_t hash = 0; // fingerprint of all the fields except the emission, computed once when the line is parsed
 
-#ifdef HAVE_CPP20_CHRONO
-    auto operator<=>(const emap::PointSourceIdentifier& other) const = default;
-#else
-    bool operator==(const emap::PointSourceIdentifier& other) const = default;
-#endif
+    void update_hash() noexcept
+    {
+        hash = 0;
+        inf::hash_combine(hash, id, eilNumber, eilPoint, subType, dv.has_value(), dv.value_or(0), height, diameter, temperature, warmthContents, flowRate);
+        if (coordinate.has_value()) {
+            inf::hash_combine(hash, coordinate->x, coordinate->y);
+        }
+    }
 
-    std::string source_id() const
+    // Identical point sources only differ in their emission
+    bool is_same_source(const PointSourceRecord& other) const noexcept
     {
-        return fmt::format("{}_{}_{}_{}_{}_{}_{}_{}", height, diameter, temperature, warmthContents, flowRate, eilPoint, eilNumber, subType);
+        return hash == other.hash &&
+               id == other.id &&
+               eilNumber == other.eilNumber &&
+               eilPoint == other.eilPoint &&
+               subType == other.subType &&
+               coordinate == other.coordinate &&
+               dv == other.dv &&
+               height == other.height &&
+               diameter == other.diameter &&
+               temperature == other.temperature &&
+               warmthContents == other.warmthContents &&
+               flowRate == other.flowRate;
     }
 
-    EmissionEntry to_emission_entry(double emissionValue) const
+    // The source id buffer is reused between calls to avoid an allocation per entry
+    EmissionEntry to_emission_entry(double emissionValue, std::string& sourceIdBuffer) const
     {
-        EmissionEntry entry(
-            EmissionIdentifier(country, sector, pollutant),
-            EmissionValue(emissionValue));
+        EmissionEntry entry(id, EmissionValue(emissionValue));
 
         entry.set_height(height);
         entry.set_diameter(diameter);
@@ -141,7 +229,9 @@ struct PointSourceIdentifier
         entry.set_warmth_contents(warmthContents);
         entry.set_flow_rate(flowRate);
 
-        entry.set_source_id(source_id());
+        sourceIdBuffer.clear();
+        fmt::format_to(std::back_inserter(sourceIdBuffer), "{}_{}_{}_{}_{}_{}_{}_{}", height, diameter, temperature, warmthContents, flowRate, eilPoint, eilNumber, subType);
+        entry.set_source_id(sourceIdBuffer);
         entry.set_dv(dv);
         if (coordinate.has_value()) {
             entry.set_coordinate(*coordinate);
@@ -149,249 +239,421 @@ struct PointSourceIdentifier
         return entry;
     }
 };
-}
 
-namespace std {
-template <>
-struct hash<emap::PointSourceIdentifier>
+struct PointSourceRecordHash
+{
+    size_t operator()(const PointSourceRecord* record) const noexcept
+    {
+        return record->hash;
+    }
+};
+
+struct PointSourceRecordEqual
 {
-    std::size_t operator()(const emap::PointSourceIdentifier& ps) const
+    bool operator()(const PointSourceRecord* lhs, const PointSourceRecord* rhs) const noexcept
     {
-        std::size_t seed = 0;
-        inf::hash_combine(seed,
-                          ps.type,
-                          ps.scenario,
-                          ps.year,
-                          ps.country,
-                          ps.sector,
-                          ps.pollutant,
-                          ps.eilNumber,
-                          ps.eilPoint,
-                          ps.subType,
-                          ps.coordinate,
-                          ps.dv,
-                          ps.height,
-                          ps.diameter,
-                          ps.temperature,
-                          ps.warmthContents,
-                          ps.flowRate);
-        return seed;
+        return lhs->is_same_source(*rhs);
     }
 };
+
+struct PointSourceChunk
+{
+    std::vector<PointSourceRecord> records;
+    std::vector<std::string> warnings;
+};
+
+// Field indexes of the point source columns, only the country, pollutant, emission, unit and sector columns are required
+struct PointSourceColumns
+{
+    size_t count = 0;
+    EmissionSector::Type sectorType = EmissionSector::Type::Nfr;
+    size_t country                  = 0;
+    size_t sector                   = 0;
+    size_t pollutant                = 0;
+    size_t emission                 = 0;
+    size_t unit                     = 0;
+    std::optional<size_t> x;
+    std::optional<size_t> y;
+    std::optional<size_t> height;
+    std::optional<size_t> diameter;
+    std::optional<size_t> temperature;
+    std::optional<size_t> warmthContents;
+    std::optional<size_t> flowRate;
+    std::optional<size_t> dv;
+    std::optional<size_t> eilNumber;
+    std::optional<size_t> eilPoint;
+    std::optional<size_t> subType;
+    std::optional<size_t> pointSourceIndex;
+};
+
+static PointSourceColumns parse_point_source_header(std::string_view header)
+{
+    PointSourceColumns cols;
+    cols.count = std::count(header.begin(), header.end(), ';') + 1;
+
+    std::vector<std::string_view> names(cols.count);
+    split_fields(header, ';', names);
+
+    auto column = [&names](std::string_view name) -> std::optional<size_t> {
+        if (auto iter = std::find(names.begin(), names.end(), name); iter != names.end()) {
+            return std::distance(names.begin(), iter);
+        }
+
+        return {};
+    };
+
+    auto required_column = [&column](std::string_view name) {
+        if (auto index = column(name); index.has_value()) {
+            return *index;
+        }
+
+        throw RuntimeError("Missing {} column", name);
+    };
+
+    if (auto index = column("nfr_sector"); index.has_value()) {
+        cols.sector     = *index;
+        cols.sectorType = EmissionSector::Type::Nfr;
+    } else if (auto gnfrIndex = column("gnfr_sector"); gnfrIndex.has_value()) {
+        cols.sector     = *gnfrIndex;
+        cols.sectorType = EmissionSector::Type::Gnfr;
+    } else {
+        throw RuntimeError("Missing nfr_sector or gnfr_sector column");
+    }
+
+    cols.country          = required_column("reporting_country");
+    cols.pollutant        = required_column("pollutant");
+    cols.emission         = required_column("emission");
+    cols.unit             = required_column("unit");
+    cols.x                = column("x");
+    cols.y                = column("y");
+    cols.height           = column("hoogte_m");
+    cols.diameter         = column("diameter_m");
+    cols.temperature      = column("temperatuur_C");
+    cols.warmthContents   = column("warmteinhoud_MW");
+    cols.flowRate         = column("Debiet_Nm3/u");
+    cols.dv               = column("dv");
+    cols.eilNumber        = column("EIL_nummer");
+    cols.eilPoint         = column("EIL_Emissiepunt_Jaar_Naam");
+    cols.subType          = column("subtype");
+    cols.pointSourceIndex = column("pointsource_index");
+
+    if (!cols.flowRate.has_value()) {
+        cols.flowRate = column("debiet_Nm3/u");
+    }
+
+    if (!(cols.x.has_value() && cols.y.has_value())) {
+        cols.x.reset();
+        cols.y.reset();
+    }
+
+    return cols;
 }
 
-namespace emap {
+static std::string_view optional_field(std::span<const std::string_view> fields, std::optional<size_t> index) noexcept
+{
+    return index.has_value() ? fields[*index] : std::string_view();
+}
+
+// Empty numeric fields are interpreted as 0
+static double point_source_number(std::string_view field)
+{
+    if (field.empty()) {
+        return 0.0;
+    }
+
+    if (auto value = str::to_double(field); value.has_value()) {
+        return *value;
+    }
+
+    throw RuntimeError("Invalid number: {}", field);
+}
+
+static int32_t point_source_integer(std::string_view field)
+{
+    if (field.empty()) {
+        return 0;
+    }
+
+    if (auto value = str::to_int32(field); value.has_value()) {
+        return *value;
+    }
+
+    throw RuntimeError("Invalid number: {}", field);
+}
 
 SingleEmissions parse_point_sources(const fs::path& emissionsCsv, const RunConfiguration& cfg)
 {
     // pointsource csv columns: type;scenario;year;reporting_country;nfr-sector;pollutant;emission;unit;x;y;hoogte_m;diameter_m;temperatuur_C;warmteinhoud_MW;Debiet_Nm3/u;Type emissie omschrijving;EIL-nummer;Exploitatie naam;NACE-code;EIL Emissiepunt Jaar Naam;Activiteit type;subtype
+    // The lines are parsed concurrently in line aligned chunks, the parsed records refer to the file contents
+    // so no strings are allocated until the emission entries are created
+    constexpr size_t chunkSize = 1024 * 1024;
 
     const auto& countryInv      = cfg.countries();
     const auto& sectorInv       = cfg.sectors();
     const auto& pollutantInv    = cfg.pollutants();
     const bool combineIdentical = cfg.combine_identical_point_sources();
 
-    size_t lineNr = 2;
-
     try {
         Log::debug("Parse emissions: {}", emissionsCsv);
 
-        std::vector<EmissionEntry> pointSources;
-        std::unordered_map<PointSourceIdentifier, double> pointSourceEmissions;
-
-        using namespace io;
-        CSVReader<25, trim_chars<' ', '\t'>, no_quote_escape<';'>, throw_on_overflow> in(file::u8string(emissionsCsv));
-
-        in.read_header(ignore_missing_column | ignore_extra_column,
-                       "type",
-                       "scenario",
-                       "year",
-                       "reporting_country",
-                       "nfr_sector",
-                       "gnfr_sector",
-                       "pollutant",
-                       "emission",
-                       "unit",
-                       "x",
-                       "y",
-                       "hoogte_m",
-                       "diameter_m",
-                       "temperatuur_C",
-                       "warmteinhoud_MW",
-                       "debiet_Nm3/u",
-                       "Debiet_Nm3/u",
-                       "dv",
-                       "type_emissie",
-                       "EIL_nummer",
-                       "exploitatie_naam",
-                       "EIL_Emissiepunt_Jaar_Naam",
-                       "Activiteit_type",
-                       "subtype",
-                       "pointsource_index");
-
-        if (!in.has_column("nfr_sector") && !in.has_column("gnfr_sector")) {
-            throw RuntimeError("Missing nfr_sector or gnfr_sector column");
+        const auto contents = file::read_as_text(emissionsCsv);
+
+        std::string_view data = contents;
+        if (data.starts_with("\xEF\xBB\xBF")) {
+            data.remove_prefix(3);
         }
 
-        auto sectorType             = in.has_column("nfr_sector") ? EmissionSector::Type::Nfr : EmissionSector::Type::Gnfr;
-        bool hasSubTypeCol          = in.has_column("subtype");
-        bool hasDvCol               = in.has_column("dv");
-        bool hasPointSourceIndexCol = in.has_column("pointsource_index");
-        bool hasCoordinates         = in.has_column("x") && in.has_column("y");
-
-        int32_t year = 0, dv = 0;
-        double value, height, diameter, temp, warmthContents, flowRate;
-        char *type, *scenario, *countryStr, *nfrSectorName, *gnfrSectorName, *pollutantName, *unit, *emissionType, *eilNr, *explName, *eilYearName, *activityType;
-        char *subtype = nullptr, *psIndex = nullptr;
-        char *x = nullptr, *y = nullptr;
-        while (in.read_row(type, scenario, year, countryStr, nfrSectorName, gnfrSectorName, pollutantName, value, unit, x, y, height, diameter, temp, warmthContents, flowRate, flowRate, dv, emissionType, eilNr, explName, eilYearName, activityType, subtype, psIndex)) {
-            auto sectorName    = std::string_view(sectorType == EmissionSector::Type::Nfr ? nfrSectorName : gnfrSectorName);
-            const auto country = countryInv.try_country_from_string(countryStr);
-
-            if (sectorName.empty() ||
-                sectorInv.is_ignored_sector(sectorType, sectorName, *country) ||
-                pollutantInv.is_ignored_pollutant(pollutantName, *country)) {
-                continue;
-            }
+        const auto headerEnd = data.find('\n');
+        auto header          = data.substr(0, headerEnd);
+        data                 = headerEnd == std::string_view::npos ? std::string_view() : data.substr(headerEnd + 1);
+        if (!header.empty() && header.back() == '\r') {
+            header.remove_suffix(1);
+        }
 
-            double emissionValue = to_giga_gram(value, unit);
-            if (emissionValue == 0.0) {
-                continue;
-            }
+        const auto cols   = parse_point_source_header(header);
+        const auto chunks = split_in_line_chunks(data, chunkSize);
+        auto lineNumbers  = chunk_line_numbers(chunks);
+        for (auto& lineNr : lineNumbers) {
+            // account for the header line
+            ++lineNr;
+        }
 
-            auto sector    = sectorInv.try_sector_from_string(sectorType, sectorName);
-            auto pollutant = pollutantInv.try_pollutant_from_string(pollutantName);
-
-            if (sector.has_value() && pollutant.has_value()) {
-                PointSourceIdentifier ps;
-                ps.sector         = *sector;
-                ps.country        = *country;
-                ps.pollutant      = *pollutant;
-                ps.height         = height;
-                ps.diameter       = diameter;
-                ps.temperature    = temp;
-                ps.warmthContents = warmthContents;
-                ps.flowRate       = flowRate;
-
-                if (hasSubTypeCol) {
-                    ps.subType = subtype ? subtype : "none";
-                } else if (hasPointSourceIndexCol) {
-                    ps.subType = psIndex ? psIndex : "none";
-                } else {
-                    ps.subType = "none";
+        std::vector<PointSourceChunk> parsedChunks(chunks.size());
+        tbb::parallel_for(size_t(0), chunks.size(), [&](size_t chunkIndex) {
+            auto& result = parsedChunks[chunkIndex];
+
+            std::vector<std::string_view> fields(cols.count);
+            for_each_line(chunks[chunkIndex], [&](std::string_view line, size_t lineIndex) {
+                if (line.empty()) {
+                    return;
                 }
 
-                ps.eilNumber = eilNr;
-                ps.eilPoint  = eilYearName;
+                try {
+                    if (!split_fields(line, ';', fields)) {
+                        throw RuntimeError("Invalid number of columns");
+                    }
+
+                    const auto sectorName    = fields[cols.sector];
+                    const auto pollutantName = fields[cols.pollutant];
+                    const auto country       = countryInv.try_country_from_string(fields[cols.country]);
+
+                    if (!country.has_value() ||
+                        sectorName.empty() ||
+                        sectorInv.is_ignored_sector(cols.sectorType, sectorName, *country) ||
+                        pollutantInv.is_ignored_pollutant(pollutantName, *country)) {
+                        return;
+                    }
+
+                    const double emissionValue = to_giga_gram(point_source_number(fields[cols.emission]), fields[cols.unit]);
+                    if (emissionValue == 0.0) {
+                        return;
+                    }
+
+                    const auto sector    = sectorInv.try_sector_from_string(cols.sectorType, sectorName);
+                    const auto pollutant = pollutantInv.try_pollutant_from_string(pollutantName);
+
+                    if (!sector.has_value() || !pollutant.has_value()) {
+                        if (!pollutant.has_value()) {
+                            result.warnings.push_back(fmt::format("Unknown pollutant name: {}", pollutantName));
+                        }
+
+                        if (!sector.has_value()) {
+                            result.warnings.push_back(fmt::format("Unknown sector name: {}", sectorName));
+                        }
+
+                        return;
+                    }
 
-                if (hasCoordinates) {
-                    auto xVal = str::to_double(x);
-                    auto yVal = str::to_double(y);
-                    if (xVal.has_value() && yVal.has_value()) {
-                        ps.coordinate = Coordinate(*xVal, *yVal);
+                    PointSourceRecord record;
+                    record.id             = EmissionIdentifier(*country, *sector, *pollutant);
+                    record.emission       = emissionValue;
+                    record.height         = point_source_number(optional_field(fields, cols.height));
+                    record.diameter       = point_source_number(optional_field(fields, cols.diameter));
+                    record.temperature    = point_source_number(optional_field(fields, cols.temperature));
+                    record.warmthContents = point_source_number(optional_field(fields, cols.warmthContents));
+                    record.flowRate       = point_source_number(optional_field(fields, cols.flowRate));
+                    record.eilNumber      = optional_field(fields, cols.eilNumber);
+                    record.eilPoint       = optional_field(fields, cols.eilPoint);
+
+                    if (cols.subType.has_value()) {
+                        record.subType = fields[*cols.subType];
+                    } else if (cols.pointSourceIndex.has_value()) {
+                        record.subType = fields[*cols.pointSourceIndex];
                     } else {
-                        throw RuntimeError("Invalid coordinate in point sources: x='{}' y='{}'", x, y);
+                        record.subType = "none";
                     }
-                }
 
-                if (hasDvCol) {
-                    ps.dv = dv;
+                    if (cols.x.has_value()) {
+                        const auto x    = fields[*cols.x];
+                        const auto y    = fields[*cols.y];
+                        const auto xVal = str::to_double(x);
+                        const auto yVal = str::to_double(y);
+                        if (xVal.has_value() && yVal.has_value()) {
+                            record.coordinate = Coordinate(*xVal, *yVal);
+                        } else {
+                            throw RuntimeError("Invalid coordinate in point sources: x='{}' y='{}'", x, y);
+                        }
+                    }
+
+                    if (cols.dv.has_value()) {
+                        record.dv = point_source_integer(fields[*cols.dv]);
+                    }
+
+                    record.update_hash();
+                    result.records.push_back(record);
+                } catch (const std::exception& e) {
+                    throw RuntimeError("line {} ({})", lineNumbers[chunkIndex] + lineIndex, e.what());
                 }
+            });
+        });
+
+        // Merge the chunks in file order, identical point sources are combined in the first occurrence
+        std::vector<const PointSourceRecord*> records;
+        std::vector<double> emissions;
+        std::unordered_map<const PointSourceRecord*, size_t, PointSourceRecordHash, PointSourceRecordEqual> recordIndexes;
+
+        for (const auto& chunk : parsedChunks) {
+            for (const auto& warning : chunk.warnings) {
+                Log::warn("{}", warning);
+            }
 
+            for (const auto& record : chunk.records) {
                 if (combineIdentical) {
-                    pointSourceEmissions[ps] += emissionValue;
-                } else {
-                    pointSources.push_back(ps.to_emission_entry(emissionValue));
-                }
-            } else {
-                if (!pollutant.has_value()) {
-                    Log::warn("Unknown pollutant name: {}", pollutantName);
+                    if (auto [iter, inserted] = recordIndexes.try_emplace(&record, records.size()); !inserted) {
+                        emissions[iter->second] += record.emission;
+                        continue;
+                    }
                 }
 
-                if (!sector.has_value()) {
-                    Log::warn("Unknown sector name: {}", sectorName);
-                }
+                records.push_back(&record);
+                emissions.push_back(record.emission);
             }
-
-            ++lineNr;
         }
 
-        if (combineIdentical) {
-            for (const auto& [ps, emission] : pointSourceEmissions) {
-                pointSources.push_back(ps.to_emission_entry(emission));
-            }
+        std::string sourceIdBuffer;
+        std::vector<EmissionEntry> pointSources;
+        pointSources.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            pointSources.push_back(records[i]->to_emission_entry(emissions[i], sourceIdBuffer));
         }
 
         SingleEmissions result(cfg.year());
         result.set_emissions(std::move(pointSources));
         return result;
     } catch (const std::exception& e) {
-        throw RuntimeError("Error parsing {} line {} ({})", emissionsCsv, lineNr, e.what());
+        throw RuntimeError("Error parsing {} ({})", emissionsCsv, e.what());
     }
 }
 
-SingleEmissions parse_emissions(EmissionSector::Type sectorType, const fs::path& emissionsCsv, date::year requestYear, const RunConfiguration& cfg, RespectIgnoreList respectIgnores)
+// Parsed line of a totals file with the priority of the sector name that was used
+struct TotalsRow
+{
+    EmissionEntry entry;
+    int32_t priority = 0;
+};
+
+struct TotalsChunk
+{
+    std::vector<TotalsRow> rows;
+    std::vector<std::pair<size_t, std::string>> ignoredLines; // line index in the chunk and the reason
+};
+
+SingleEmissions parse_emissions(EmissionSector::Type sectorType, const fs::path& emissionsCsv, date::year requestYear, const RunConfiguration& cfg, RespectIgnoreList respectIgnores, size_t chunkSize)
 {
     // First lines are comments
     // Format: ISO2;YEAR;SECTOR;POLLUTANT;UNIT;NUMBER/FLAG
-
+    // The files contain all the years, they are parsed concurrently in line aligned chunks
+    // The lines of the other years are skipped before any of the names are looked up
     const auto& countryInv   = cfg.countries();
     const auto& sectorInv    = cfg.sectors();
     const auto& pollutantInv = cfg.pollutants();
 
     try {
         Log::debug("Parse emissions: {}", emissionsCsv);
-        std::vector<EmissionEntry> entries;
-        std::unordered_map<EmissionIdentifier, int32_t> usedSectorPriories;
 
-        using namespace io;
-        CSVReader<6, trim_chars<' ', '\t'>, no_quote_escape<';'>, throw_on_overflow, single_line_comment<'#'>> in(str::from_u8(emissionsCsv.u8string()));
+        const auto contents = file::read_as_text(emissionsCsv);
 
-        int32_t year;
-        char *countryStr, *sectorName, *pollutant, *unit, *value;
-        while (in.read_row(countryStr, year, sectorName, pollutant, unit, value)) {
-            if (year != static_cast<int32_t>(requestYear)) {
-                // not the year we want
-                continue;
-            }
+        std::string_view data = contents;
+        if (data.starts_with("\xEF\xBB\xBF")) {
+            data.remove_prefix(3);
+        }
 
-            auto emissionValue = parse_emission_value(value).value_or(0.0);
-            emissionValue      = to_giga_gram(emissionValue, unit);
+        const auto chunks      = split_in_line_chunks(data, chunkSize);
+        const auto lineNumbers = chunk_line_numbers(chunks);
 
-            const auto country = countryInv.try_country_from_string(countryStr);
-            if (!country.has_value()) {
-                // not interested in this country, no need to report this
-                continue;
-            }
+        std::vector<TotalsChunk> parsedChunks(chunks.size());
+        tbb::parallel_for(size_t(0), chunks.size(), [&](size_t chunkIndex) {
+            auto& result = parsedChunks[chunkIndex];
 
-            try {
-                if (respectIgnores == RespectIgnoreList::Yes) {
-                    if (sectorInv.is_ignored_sector(sectorType, sectorName, *country) || pollutantInv.is_ignored_pollutant(pollutant, *country)) {
-                        continue;
+            std::array<std::string_view, 6> fields;
+            for_each_line(chunks[chunkIndex], [&](std::string_view line, size_t lineIndex) {
+                if (line.empty() || line.front() == '#') {
+                    return;
+                }
+
+                if (!split_fields(line, ';', fields)) {
+                    throw RuntimeError("Invalid number of columns on line {}", lineNumbers[chunkIndex] + lineIndex);
+                }
+
+                const auto [countryStr, yearStr, sectorName, pollutant, unit, value] = fields;
+
+                const auto year = str::to_int32(yearStr);
+                if (!year.has_value()) {
+                    throw RuntimeError("Invalid year on line {}: {}", lineNumbers[chunkIndex] + lineIndex, yearStr);
+                }
+
+                if (*year != static_cast<int32_t>(requestYear)) {
+                    // not the year we want
+                    return;
+                }
+
+                auto emissionValue = parse_emission_value(value).value_or(0.0);
+                emissionValue      = to_giga_gram(emissionValue, unit);
+
+                const auto country = countryInv.try_country_from_string(countryStr);
+                if (!country.has_value()) {
+                    // not interested in this country, no need to report this
+                    return;
+                }
+
+                try {
+                    if (respectIgnores == RespectIgnoreList::Yes) {
+                        if (sectorInv.is_ignored_sector(sectorType, sectorName, *country) || pollutantInv.is_ignored_pollutant(pollutant, *country)) {
+                            return;
+                        }
                     }
+
+                    auto [sector, priority] = sectorInv.sector_with_priority_from_string(sectorType, sectorName);
+                    EmissionIdentifier id(*country, sectorInv.sector_from_string(sectorType, sectorName), pollutantInv.pollutant_from_string(pollutant));
+
+                    result.rows.push_back({EmissionEntry(id, EmissionValue(emissionValue)), priority});
+                } catch (const std::exception& e) {
+                    result.ignoredLines.emplace_back(lineIndex, e.what());
                 }
+            });
+        });
 
-                auto [sector, priority] = sectorInv.sector_with_priority_from_string(sectorType, sectorName);
-                EmissionIdentifier id(*country, sectorInv.sector_from_string(sectorType, sectorName), pollutantInv.pollutant_from_string(pollutant));
+        // Merge the chunks in file order, the first occurrence of a sector determines the priority to beat
+        std::vector<EmissionEntry> entries;
+        std::unordered_map<EmissionKey, std::pair<size_t, int32_t>> usedSectorPriorities; // index in the entries, priority
 
-                EmissionEntry info(id, EmissionValue(emissionValue));
+        for (size_t chunkIndex = 0; chunkIndex < parsedChunks.size(); ++chunkIndex) {
+            for (const auto& [lineIndex, reason] : parsedChunks[chunkIndex].ignoredLines) {
+                Log::debug("Ignoring line {} in {} ({})", lineNumbers[chunkIndex] + lineIndex, emissionsCsv, reason);
+            }
 
-                if (auto iter = usedSectorPriories.find(id); iter != usedSectorPriories.end()) {
+            for (auto& [entry, priority] : parsedChunks[chunkIndex].rows) {
+                if (auto iter = usedSectorPriorities.find(entry.id().key()); iter != usedSectorPriorities.end()) {
                     // Sector was already processed, check if the current priority is higher
-                    if (priority > iter->second && emissionValue > 0.0) {
-                        // the current entry has a higher priority, update the map
-                        update_entry(entries, info);
-                    } else {
-                        // the current entry has a lower priority priority, skip it
-                        continue;
+                    if (priority > iter->second.second && entry.value().amount().value_or(0.0) > 0.0) {
+                        // the current entry has a higher priority, replace the existing entry
+                        entries[iter->second.first] = std::move(entry);
                     }
                 } else {
                     // first time we encounter this sector, add the current priority
-                    usedSectorPriories.emplace(id, priority);
-                    entries.push_back(info);
+                    usedSectorPriorities.emplace(entry.id().key(), std::make_pair(entries.size(), priority));
+                    entries.push_back(std::move(entry));
                 }
-            } catch (const std::exception& e) {
-                Log::debug("Ignoring line {} in {} ({})", in.get_file_line(), emissionsCsv, e.what());
             }
         }
 
@@ -427,88 +689,91 @@ ScalingFactors parse_scaling_factors(const fs::path& scalingFactors, const RunCo
     const auto& countryInv   = cfg.countries();
     const auto& sectorInv    = cfg.sectors();
     const auto& pollutantInv = cfg.pollutants();
-    size_t lineNr            = 2;
+    int32_t lineNr           = 1;
 
     try {
         Log::debug("Parse scaling factors: {}", scalingFactors);
 
         ScalingFactors result;
 
-        auto ds    = gdal::VectorDataSet::open(scalingFactors);
-        auto layer = ds.layer("Scaling");
-
-        auto colYear         = layer.required_field_index("year");
-        auto colEmissionType = layer.required_field_index("emission_type");
-        auto colPollutant    = layer.required_field_index("pollutant_code");
-        auto colCountry      = layer.required_field_index("country_iso_code");
-        auto colGnfr         = layer.required_field_index("GNFR_code");
-        auto colNfr          = layer.required_field_index("NFR_code");
-        auto colScaleFactor  = layer.required_field_index("scale_factor");
-
-        for (auto& feature : layer) {
-            const auto year = feature.field_as<std::string>(colYear);
-            if (year.empty()) {
-                // skip empty lines
-                continue;
-            }
-
-            // Empty optional values mean match any (*)
-            std::optional<Country> country;
-            std::optional<Pollutant> pollutant;
-            std::optional<NfrSector> nfrSector;
-            std::optional<GnfrSector> gnfrSector;
-            if (auto sec = sectorInv.try_sector_from_string(EmissionSector::Type::Nfr, feature.field_as<std::string_view>(colNfr)); sec.has_value()) {
-                nfrSector = sec->nfr_sector();
-            }
-
-            if (auto sec = sectorInv.try_sector_from_string(EmissionSector::Type::Gnfr, feature.field_as<std::string_view>(colGnfr)); sec.has_value()) {
-                gnfrSector = sec->gnfr_sector();
-            }
+        xl::WorkBookReader workbook(scalingFactors);
+
+        int32_t colYear = -1, colEmissionType = -1, colPollutant = -1, colCountry = -1, colGnfr = -1, colNfr = -1, colScaleFactor = -1;
+        workbook.read_sheet(
+            "Scaling",
+            [&](const xl::Row& header) {
+                colYear         = xl::required_column_index(header, "year");
+                colEmissionType = xl::required_column_index(header, "emission_type");
+                colPollutant    = xl::required_column_index(header, "pollutant_code");
+                colCountry      = xl::required_column_index(header, "country_iso_code");
+                colGnfr         = xl::required_column_index(header, "GNFR_code");
+                colNfr          = xl::required_column_index(header, "NFR_code");
+                colScaleFactor  = xl::required_column_index(header, "scale_factor");
+            },
+            [&](const xl::Row& row) {
+                lineNr = row.row_number();
+
+                const auto year = row.as_string_view(colYear);
+                if (year.empty()) {
+                    // skip empty lines
+                    return;
+                }
 
-            if (!nfrSector.has_value()) {
-                if (auto name = feature.field_as<std::string_view>(colNfr); name != "*") {
-                    throw RuntimeError("Invalid NFR sector: {}", name);
+                // Empty optional values mean match any (*)
+                std::optional<Country> country;
+                std::optional<Pollutant> pollutant;
+                std::optional<NfrSector> nfrSector;
+                std::optional<GnfrSector> gnfrSector;
+                if (auto sec = sectorInv.try_sector_from_string(EmissionSector::Type::Nfr, row.as_string_view(colNfr)); sec.has_value()) {
+                    nfrSector = sec->nfr_sector();
                 }
-            }
 
-            if (!gnfrSector.has_value()) {
-                if (auto name = feature.field_as<std::string_view>(colGnfr); name != "*") {
-                    throw RuntimeError("Invalid GNFR sector: {}", name);
+                if (auto sec = sectorInv.try_sector_from_string(EmissionSector::Type::Gnfr, row.as_string_view(colGnfr)); sec.has_value()) {
+                    gnfrSector = sec->gnfr_sector();
                 }
-            }
 
-            if (nfrSector.has_value() && gnfrSector.has_value() && (EmissionSector(*nfrSector).gnfr_sector() != *gnfrSector)) {
-                throw RuntimeError("GNFR sector column does not match with the NFR sector column: {} <-> {}", feature.field_as<std::string_view>(colNfr), feature.field_as<std::string_view>(colGnfr));
-            }
+                if (!nfrSector.has_value()) {
+                    if (auto name = row.as_string_view(colNfr); name != "*") {
+                        throw RuntimeError("Invalid NFR sector: {}", name);
+                    }
+                }
 
-            if (auto cnt = countryInv.try_country_from_string(feature.field_as<std::string_view>(colCountry)); cnt.has_value()) {
-                country = *cnt;
-            } else {
-                if (str::trimmed_view(feature.field_as<std::string_view>(colCountry)) != "*") {
-                    throw RuntimeError("Invalid country code: {}", feature.field_as<std::string_view>(colCountry));
+                if (!gnfrSector.has_value()) {
+                    if (auto name = row.as_string_view(colGnfr); name != "*") {
+                        throw RuntimeError("Invalid GNFR sector: {}", name);
+                    }
                 }
-            }
 
-            if (auto pol = pollutantInv.try_pollutant_from_string(feature.field_as<std::string_view>(colPollutant)); pol.has_value()) {
-                if (pol->code() == constants::pollutant::PMCoarse) {
-                    throw RuntimeError("PMCoarse is not allowed to be scaled");
+                if (nfrSector.has_value() && gnfrSector.has_value() && (EmissionSector(*nfrSector).gnfr_sector() != *gnfrSector)) {
+                    throw RuntimeError("GNFR sector column does not match with the NFR sector column: {} <-> {}", row.as_string_view(colNfr), row.as_string_view(colGnfr));
                 }
-                pollutant = *pol;
-            } else {
-                if (str::trimmed_view(feature.field_as<std::string_view>(colPollutant)) != "*") {
-                    throw RuntimeError("Invalid pollutant code: {}", feature.field_as<std::string_view>(colCountry));
+
+                if (auto cnt = countryInv.try_country_from_string(row.as_string_view(colCountry)); cnt.has_value()) {
+                    country = *cnt;
+                } else {
+                    if (str::trimmed_view(row.as_string_view(colCountry)) != "*") {
+                        throw RuntimeError("Invalid country code: {}", row.as_string_view(colCountry));
+                    }
                 }
-            }
 
-            const auto emissionType = parse_emission_type(feature.field_as<std::string_view>(colEmissionType));
-            const auto factor       = feature.field_as<double>(colScaleFactor);
+                if (auto pol = pollutantInv.try_pollutant_from_string(row.as_string_view(colPollutant)); pol.has_value()) {
+                    if (pol->code() == constants::pollutant::PMCoarse) {
+                        throw RuntimeError("PMCoarse is not allowed to be scaled");
+                    }
+                    pollutant = *pol;
+                } else {
+                    if (str::trimmed_view(row.as_string_view(colPollutant)) != "*") {
+                        throw RuntimeError("Invalid pollutant code: {}", row.as_string_view(colCountry));
+                    }
+                }
 
-            if (factor != 1.0) {
-                result.add_scaling_factor(ScalingFactor(country, nfrSector, gnfrSector, pollutant, emissionType, parse_year_range(year), factor));
-            }
+                const auto emissionType = parse_emission_type(row.as_string_view(colEmissionType));
+                const auto factor       = xl::required_double(row, colScaleFactor);
 
-            ++lineNr;
-        }
+                if (factor != 1.0) {
+                    result.add_scaling_factor(ScalingFactor(country, nfrSector, gnfrSector, pollutant, emissionType, parse_year_range(year), factor));
+                }
+            });
 
         return result;
     } catch (const std::exception& e) {
@@ -554,19 +819,12 @@ static std::string_view strip_newline(std::string_view str)
     return str;
 }
 
-SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::year year, const RunConfiguration& cfg)
+// Parses the sheet of the requested year in a regional workbook
+static SingleEmissions parse_emissions_belgium_year(const xl::WorkBookReader& workbook, const Country& country, date::year year, const RunConfiguration& cfg)
 {
-    Log::debug("Parse emissions belgium: {}", emissionsData);
-
     const auto& sectorInv    = cfg.sectors();
     const auto& pollutantInv = cfg.pollutants();
 
-    const auto country = detect_belgian_region_from_filename(emissionsData);
-
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "DISABLE");
-    auto ds    = gdal::VectorDataSet::open(emissionsData);
-    auto layer = ds.layer(std::to_string(static_cast<int>(year)));
-
     constexpr const int pollutantLineNr = 12;
     constexpr const int unitLineNr      = pollutantLineNr + 1;
 
@@ -586,25 +844,25 @@ SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::yea
 
     std::vector<EmissionEntry> entries;
 
-    int lineNr = 0;
-    for (const auto& feature : layer) {
-        ++lineNr;
+    workbook.read_sheet(std::to_string(static_cast<int>(year)), [&](const xl::Row& row) {
+        // the row numbers of the sheet are used, empty rows are not present in the sheet
+        const auto lineNr = row.row_number();
 
         if (lineNr == pollutantLineNr) {
-            for (int i = 0; i < feature.field_count(); ++i) {
-                if (auto pol = detect_pollutant_name_from_header(strip_newline(feature.field_as<std::string_view>(i)), pollutantInv, country); pol.has_value()) {
+            for (int i = 0; i < row.column_count(); ++i) {
+                if (auto pol = detect_pollutant_name_from_header(strip_newline(row.as_string_view(i)), pollutantInv, country); pol.has_value()) {
                     pollutantColumns.emplace(i, *pol);
                 }
             }
         } else if (lineNr == unitLineNr) {
             for (auto& [index, pol] : pollutantColumns) {
-                pol.unitConversion = to_giga_gram_factor(feature.field_as<std::string_view>(index)).value_or(1.0);
+                pol.unitConversion = to_giga_gram_factor(row.as_string_view(index)).value_or(1.0);
             }
         }
 
-        if (auto nfrSectorName = feature.field_as<std::string_view>(1); !nfrSectorName.empty()) {
+        if (auto nfrSectorName = row.as_string_view(1); !nfrSectorName.empty()) {
             if (sectorInv.is_ignored_nfr_sector(nfrSectorName, country)) {
-                continue;
+                return;
             }
 
             EmissionSector nfrSector;
@@ -622,7 +880,7 @@ SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::yea
                         sectorOverride = true;
                     } else {
                         // the current entry has a lower priority priority, skip it
-                        continue;
+                        return;
                     }
                 } else {
                     // first time we encounter this sector, add the current priority
@@ -630,7 +888,7 @@ SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::yea
                 }
             } catch (const std::exception&) {
                 // not an nfr value line, skipping
-                continue;
+                return;
             }
 
             if (pollutantColumns.empty()) {
@@ -638,19 +896,19 @@ SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::yea
             }
 
             for (const auto& [index, polData] : pollutantColumns) {
-                const auto field = feature.field(index);
-                std::optional<double> emissionValue;
-                if (const auto* emission = std::get_if<double>(&field)) {
-                    emissionValue = (*emission) * polData.unitConversion;
-                } else if (const auto* emission = std::get_if<std::string_view>(&field)) {
-                    emissionValue = parse_emission_value(*emission);
-                    if (!emissionValue.has_value()) {
-                        if (!sectorOverride) {
-                            emissionValue = 0.0;
-                        }
-                    } else {
-                        emissionValue = (*emissionValue) * polData.unitConversion;
+                // numeric cells and text cells are both stored as text, empty cells have no value
+                const auto field = row.as_string_view(index);
+                if (field.empty()) {
+                    continue;
+                }
+
+                std::optional<double> emissionValue = parse_emission_value(field);
+                if (!emissionValue.has_value()) {
+                    if (!sectorOverride) {
+                        emissionValue = 0.0;
                     }
+                } else {
+                    emissionValue = (*emissionValue) * polData.unitConversion;
                 }
 
                 if (emissionValue.has_value()) {
@@ -660,38 +918,55 @@ SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::yea
                     } else {
                         entries.emplace_back(EmissionIdentifier(country, nfrSector, polData.pollutant), EmissionValue(*emissionValue));
                     }
-                } else if (!sectorOverride) {
-                    const auto value = feature.field_as<std::string>(index);
-                    if (!value.empty()) {
-                        Log::error("Failed to obtain emission value from {}", value);
-                    }
+                } else {
+                    // only reached for the higher priority rows, the existing emission is kept
+                    Log::error("Failed to obtain emission value from {}", field);
                 }
             }
         }
-    }
+    });
 
     return SingleEmissions(year, entries);
 }
 
-static std::optional<EmissionSector> emission_sector_from_feature(const gdal::Feature& feature, int colNfr, int colGnfr, const Country& country, const SectorInventory& sectorInv)
+SingleEmissions parse_emissions_belgium(const fs::path& emissionsData, date::year year, const RunConfiguration& cfg)
+{
+    return std::move(parse_emissions_belgium(emissionsData, std::span<const date::year>(&year, 1), cfg).front());
+}
+
+std::vector<SingleEmissions> parse_emissions_belgium(const fs::path& emissionsData, std::span<const date::year> years, const RunConfiguration& cfg)
+{
+    Log::debug("Parse emissions belgium: {}", emissionsData);
+
+    const auto country = detect_belgian_region_from_filename(emissionsData);
+
+    // The workbook is only opened once for all the requested years
+    xl::WorkBookReader workbook(emissionsData);
+
+    std::vector<SingleEmissions> result;
+    result.reserve(years.size());
+    for (auto year : years) {
+        result.push_back(parse_emissions_belgium_year(workbook, country, year, cfg));
+    }
+
+    return result;
+}
+
+static std::optional<EmissionSector> emission_sector_from_name(std::string_view name, EmissionSector::Type type, const Country& country, const SectorInventory& sectorInv)
 {
     try {
-        std::string nfrSectorName(str::trimmed_view(feature.field_as<std::string_view>(colNfr)));
-        if (!nfrSectorName.empty()) {
-            // Nfr sector
-            if (sectorInv.is_ignored_nfr_sector(nfrSectorName, country)) {
+        if (type == EmissionSector::Type::Nfr) {
+            if (sectorInv.is_ignored_nfr_sector(name, country)) {
                 return {};
             }
 
-            return EmissionSector(sectorInv.nfr_sector_from_string(nfrSectorName));
-        } else if (colGnfr >= 0) {
-            // Gnfr sector
-            std::string gnfrSectorName(str::trimmed_view(feature.field_as<std::string_view>(colGnfr)));
-            if (sectorInv.is_ignored_gnfr_sector(gnfrSectorName, country)) {
+            return EmissionSector(sectorInv.nfr_sector_from_string(name));
+        } else {
+            if (sectorInv.is_ignored_gnfr_sector(name, country)) {
                 return {};
             }
 
-            return EmissionSector(sectorInv.gnfr_sector_from_string(gnfrSectorName));
+            return EmissionSector(sectorInv.gnfr_sector_from_string(name));
         }
     } catch (const std::exception& e) {
         Log::warn(e.what());
@@ -700,26 +975,124 @@ static std::optional<EmissionSector> emission_sector_from_feature(const gdal::Fe
     return {};
 }
 
-static Cell cell_for_emission_feature(const gdal::Feature& feature, int colX, int colY, const GeoMetadata& meta)
+// The flanders spatial pattern tables contain a row per cell, so the same names are resolved over and over again
+// Cache the name lookups to avoid the (case insensitive) inventory searches for every row
+class FlandersNameCache
+{
+public:
+    FlandersNameCache(const SectorInventory& sectorInv, const PollutantInventory& pollutantInv) noexcept
+    : _sectorInv(sectorInv)
+    , _pollutantInv(pollutantInv)
+    {
+    }
+
+    std::optional<EmissionSector> sector_for_row(const xl::Row& row, int32_t colNfr, int32_t colGnfr)
+    {
+        if (auto nfrSectorName = str::trimmed_view(row.as_string_view(colNfr)); !nfrSectorName.empty()) {
+            // Nfr sector
+            return lookup_sector(_nfrSectors, nfrSectorName, EmissionSector::Type::Nfr);
+        } else if (colGnfr >= 0) {
+            // Gnfr sector
+            return lookup_sector(_gnfrSectors, str::trimmed_view(row.as_string_view(colGnfr)), EmissionSector::Type::Gnfr);
+        }
+
+        return {};
+    }
+
+    Pollutant pollutant_for_row(const xl::Row& row, int32_t colPollutant)
+    {
+        const auto name = row.as_string_view(colPollutant);
+        if (auto iter = _pollutants.find(name); iter != _pollutants.end()) {
+            return iter->second;
+        }
+
+        auto pollutant = _pollutantInv.pollutant_from_string(name);
+        _pollutants.emplace(name, pollutant);
+        return pollutant;
+    }
+
+private:
+    using SectorLookup = std::map<std::string, std::optional<EmissionSector>, std::less<>>;
+
+    std::optional<EmissionSector> lookup_sector(SectorLookup& lookup, std::string_view name, EmissionSector::Type type)
+    {
+        if (auto iter = lookup.find(name); iter != lookup.end()) {
+            return iter->second;
+        }
+
+        auto sector = emission_sector_from_name(name, type, country::BEF, _sectorInv);
+        lookup.emplace(name, sector);
+        return sector;
+    }
+
+    const SectorInventory& _sectorInv;
+    const PollutantInventory& _pollutantInv;
+    SectorLookup _nfrSectors;
+    SectorLookup _gnfrSectors;
+    std::map<std::string, Pollutant, std::less<>> _pollutants;
+};
+
+struct FlandersPatternColumns
+{
+    FlandersPatternColumns(const xl::Row& header)
+    : year(xl::required_column_index(header, "year"))
+    , nfrSector(xl::required_column_index(header, "nfr_sector"))
+    , gnfrSector(xl::column_index(header, "gnfr_sector"))
+    , pollutant(xl::required_column_index(header, "pollutant"))
+    , x(xl::required_column_index(header, "x_lambert"))
+    , y(xl::required_column_index(header, "y_lambert"))
+    , emission(xl::required_column_index(header, "emission"))
+    {
+    }
+
+    int32_t year;
+    int32_t nfrSector;
+    int32_t gnfrSector;
+    int32_t pollutant;
+    int32_t x;
+    int32_t y;
+    int32_t emission;
+};
+
+static Point<double> point_for_emission_row(const xl::Row& row, const FlandersPatternColumns& cols)
+{
+    return Point<double>(xl::required_double(row, cols.x), xl::required_double(row, cols.y));
+}
+
+static Cell cell_for_emission_point(const Point<double>& point, const GeoMetadata& meta)
 {
     const double centerOffsetX = meta.cell_size_x() / 2.0;
     const double centerOffsetY = (-meta.cell_size_y()) / 2.0;
 
     // Coordinates are lower left cell corners: put the point in the cell center for determining the cell
-    const Point<double> point(feature.field_as<double>(colX) + centerOffsetX, feature.field_as<double>(colY) + centerOffsetY);
-    return meta.convert_point_to_cell(point);
+    return meta.convert_point_to_cell(Point<double>(point.x + centerOffsetX, point.y + centerOffsetY));
+}
+
+/* Streams the rows of the flanders spatial pattern table, the first row contains the column headers */
+static void read_spatial_pattern_flanders_rows(const fs::path& spatialPatternPath, const std::function<void(const xl::Row&, const FlandersPatternColumns&)>& rowCb)
+{
+    try {
+        xl::WorkBookReader workbook(spatialPatternPath);
+
+        std::optional<FlandersPatternColumns> columns;
+        workbook.read_sheet(0, [&](const xl::Row& row) {
+            if (!columns.has_value()) {
+                columns.emplace(row);
+                return;
+            }
+
+            rowCb(row, *columns);
+        });
+    } catch (const std::exception& e) {
+        throw RuntimeError("Error parsing {} ({})", spatialPatternPath, e.what());
+    }
 }
 
 std::vector<SpatialPatternData> parse_spatial_pattern_flanders(const fs::path& spatialPatternPath, const RunConfiguration& cfg)
 {
     std::vector<SpatialPatternData> result;
 
-    const auto& sectorInv    = cfg.sectors();
-    const auto& pollutantInv = cfg.pollutants();
-
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds    = gdal::VectorDataSet::open(spatialPatternPath);
-    auto layer = ds.layer(0);
+    FlandersNameCache names(cfg.sectors(), cfg.pollutants());
     std::optional<date::year> year;
 
     const auto gridData = grid_data(GridDefinition::Flanders1km);
@@ -727,26 +1100,18 @@ std::vector<SpatialPatternData> parse_spatial_pattern_flanders(const fs::path& s
     EmissionIdentifier id;
     id.country = country::BEF;
 
-    auto colYear       = layer.layer_definition().required_field_index("year");
-    auto colNfrSector  = layer.layer_definition().required_field_index("nfr_sector");
-    auto colGnfrSector = layer.layer_definition().field_index("gnfr_sector");
-    auto colPollutant  = layer.layer_definition().required_field_index("pollutant");
-    auto colX          = layer.layer_definition().required_field_index("x_lambert");
-    auto colY          = layer.layer_definition().required_field_index("y_lambert");
-    auto colEmission   = layer.layer_definition().required_field_index("emission");
-
     std::optional<EmissionSector> currentSector;
     gdx::DenseRaster<double> currentRaster(gridData.meta, gridData.meta.nodata.value());
-    std::unordered_set<std::string> invalidSectors;
-    for (const auto& feature : layer) {
-        if (!feature.field_is_valid(colYear)) {
-            continue; // skip empy lines
+
+    read_spatial_pattern_flanders_rows(spatialPatternPath, [&](const xl::Row& row, const FlandersPatternColumns& cols) {
+        if (row.is_empty(cols.year)) {
+            return; // skip empy lines
         }
 
-        if (auto sector = emission_sector_from_feature(feature, colNfrSector, colGnfrSector, id.country, sectorInv); sector.has_value()) {
+        if (auto sector = names.sector_for_row(row, cols.nfrSector, cols.gnfrSector); sector.has_value()) {
             id.sector    = *sector;
-            id.pollutant = pollutantInv.pollutant_from_string(feature.field_as<std::string_view>(colPollutant));
-            year         = date::year(feature.field_as<int>(colYear));
+            id.pollutant = names.pollutant_for_row(row, cols.pollutant);
+            year         = date::year(xl::required_int(row, cols.year));
 
             if (currentSector != id.sector) {
                 if (currentSector.has_value()) {
@@ -765,14 +1130,15 @@ std::vector<SpatialPatternData> parse_spatial_pattern_flanders(const fs::path& s
                 currentSector = id.sector;
             }
 
-            const auto cell = cell_for_emission_feature(feature, colX, colY, gridData.meta);
+            const auto point = point_for_emission_row(row, cols);
+            const auto cell  = cell_for_emission_point(point, gridData.meta);
             if (gridData.meta.is_on_map(cell)) {
-                currentRaster[cell] = feature.field_as<double>(colEmission);
+                currentRaster[cell] = xl::required_double(row, cols.emission);
             } else {
-                Log::warn("Point outside of flanders extent: {}", Point(feature.field_as<double>(colX), feature.field_as<double>(colY)));
+                Log::warn("Point outside of flanders extent: {}", point);
             }
         }
-    }
+    });
 
     if (year.has_value()) {
         SpatialPatternData spData;
@@ -787,26 +1153,16 @@ std::vector<SpatialPatternData> parse_spatial_pattern_flanders(const fs::path& s
 
 gdx::DenseRaster<double> parse_spatial_pattern_flanders(const fs::path& spatialPatternPath, const EmissionSector& sector, const RunConfiguration& cfg)
 {
-    const auto& sectorInv = cfg.sectors();
-
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds    = gdal::VectorDataSet::open(spatialPatternPath);
-    auto layer = ds.layer(0);
+    FlandersNameCache names(cfg.sectors(), cfg.pollutants());
 
     const auto gridData = grid_data(GridDefinition::Flanders1km);
 
-    auto colNfrSector  = layer.layer_definition().required_field_index("nfr_sector");
-    auto colGnfrSector = layer.layer_definition().field_index("gnfr_sector");
-    auto colX          = layer.layer_definition().required_field_index("x_lambert");
-    auto colY          = layer.layer_definition().required_field_index("y_lambert");
-    auto colEmission   = layer.layer_definition().required_field_index("emission");
-
     gdx::DenseRaster<double> nfrRaster(gridData.meta, gridData.meta.nodata.value());
     gdx::DenseRaster<double> gnfrRaster(gridData.meta, gridData.meta.nodata.value());
 
     bool nfrAvailable = false;
-    for (const auto& feature : layer) {
-        if (auto currentSector = emission_sector_from_feature(feature, colNfrSector, colGnfrSector, country::BEF, sectorInv); currentSector.has_value()) {
+    read_spatial_pattern_flanders_rows(spatialPatternPath, [&](const xl::Row& row, const FlandersPatternColumns& cols) {
+        if (auto currentSector = names.sector_for_row(row, cols.nfrSector, cols.gnfrSector); currentSector.has_value()) {
             gdx::DenseRaster<double>* rasterPtr = nullptr;
             if (*currentSector == sector) {
                 rasterPtr = &nfrRaster;
@@ -815,18 +1171,19 @@ gdx::DenseRaster<double> parse_spatial_pattern_flanders(const fs::path& spatialP
             }
 
             if (rasterPtr) {
-                const auto cell = cell_for_emission_feature(feature, colX, colY, gridData.meta);
+                const auto point = point_for_emission_row(row, cols);
+                const auto cell  = cell_for_emission_point(point, gridData.meta);
                 if (gridData.meta.is_on_map(cell)) {
-                    (*rasterPtr)[cell] = feature.field_as<double>(colEmission);
+                    (*rasterPtr)[cell] = xl::required_double(row, cols.emission);
                     if (rasterPtr == &nfrRaster) {
                         nfrAvailable = true;
                     }
                 } else {
-                    Log::warn("Point outside of flanders extent: {}", Point(feature.field_as<double>(colX), feature.field_as<double>(colY)));
+                    Log::warn("Point outside of flanders extent: {}", point);
                 }
             }
         }
-    }
+    });
 
     return nfrAvailable ? std::move(nfrRaster) : std::move(gnfrRaster);
 }
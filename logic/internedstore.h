@@ -0,0 +1,66 @@
+#pragma once
+
+#include "infra/cast.h"
+#include "infra/exception.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace emap {
+
+/* Append only store of identical values that are shared by index
+ * Used for the metadata of the countries, pollutants and sectors so the value types only need to carry an index
+ * Index 0 always contains the default constructed value
+ * Interning is thread safe, lookups do not lock: the values never move once they are stored */
+template <typename T, typename Hash>
+class InternedStore
+{
+public:
+    InternedStore()
+    {
+        intern(T());
+    }
+
+    uint32_t intern(const T& value)
+    {
+        std::scoped_lock lock(_mutex);
+        if (auto iter = _indexes.find(value); iter != _indexes.end()) {
+            return iter->second;
+        }
+
+        if (_size == s_chunkSize * s_chunkCount) {
+            throw inf::RuntimeError("Too many interned values (max {})", s_chunkSize * s_chunkCount);
+        }
+
+        auto& chunk = _chunks[_size / s_chunkSize];
+        if (!chunk) {
+            chunk = std::make_unique<Chunk>();
+        }
+
+        const auto index              = inf::truncate<uint32_t>(_size++);
+        (*chunk)[index % s_chunkSize] = value;
+        _indexes.emplace(value, index);
+        return index;
+    }
+
+    const T& operator[](uint32_t index) const noexcept
+    {
+        return (*_chunks[index / s_chunkSize])[index % s_chunkSize];
+    }
+
+private:
+    static constexpr size_t s_chunkSize  = 256;
+    static constexpr size_t s_chunkCount = 1024;
+
+    using Chunk = std::array<T, s_chunkSize>;
+
+    std::mutex _mutex;
+    size_t _size = 0;
+    std::array<std::unique_ptr<Chunk>, s_chunkCount> _chunks;
+    std::unordered_map<T, uint32_t, Hash> _indexes;
+};
+
+}
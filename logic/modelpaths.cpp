@@ -106,6 +106,11 @@ fs::path ModelPaths::output_dir_for_rasters() const
     return output_path() / "rasters";
 }
 
+fs::path ModelPaths::cache_dir_path() const
+{
+    return output_path() / "cache";
+}
+
 fs::path ModelPaths::output_path_for_country_raster(const EmissionIdentifier& id, const GridData& grid) const
 {
     return output_dir_for_rasters() / file::u8path(fmt::format("{}_{}_{}_{}.tif", id.country.iso_code(), id.pollutant.code(), id.sector.name(), grid.name));
@@ -13,6 +13,7 @@
 #include "emissionvalidation.h"
 #include "gridrasterbuilder.h"
 #include "outputwriters.h"
+#include "rasterwriter.h"
 #include "runsummary.h"
 #include "spatialpatterninventory.h"
 
@@ -25,6 +26,7 @@
 
 #include <numeric>
 #include <oneapi/tbb/global_control.h>
+#include <oneapi/tbb/parallel_for.h>
 #include <oneapi/tbb/parallel_for_each.h>
 #include <oneapi/tbb/parallel_pipeline.h>
 #include <unordered_set>
@@ -48,8 +50,15 @@ struct SpatialPatternProcessInfo
         return diffuseEmissions - emissionsWithinOutput;
     }
 
+    // The emissions lost or gained by spreading them over the pattern, caused by the precision of the stored pattern
+    double mass_balance_error() const noexcept
+    {
+        return spreadEmissions - diffuseEmissions;
+    }
+
     Status status                = Status::Ok;
     double diffuseEmissions      = 0.0;
+    double spreadEmissions       = 0.0;
     double emissionsWithinOutput = 0.0;
 };
 
@@ -82,14 +91,18 @@ static SpatialPatternProcessInfo apply_emission_to_spatial_pattern(SpatialPatter
         }
 
         // Spatial pattern data is available and will contain data
+        // the pattern can be stored in single precision, the spread emissions are always kept in double precision
+        spatialPattern.raster.set_precision(SparseRaster::Precision::Double);
         spatialPattern.raster *= emissionValue;
     }
 
+    info.spreadEmissions = spatialPattern.raster.sum();
+
     const auto& countryExtent = spatialPattern.raster.metadata();
     const auto intersection   = metadata_intersection(countryExtent, outputExtent);
     if (intersection.bounding_box() != countryExtent.bounding_box()) {
         // country extent is outside of the output grid
-        spatialPattern.raster = gdx::sub_raster(spatialPattern.raster, intersection);
+        spatialPattern.raster = spatialPattern.raster.sub_raster(intersection);
     }
 
     info.emissionsWithinOutput = spatialPattern.raster.sum();
@@ -97,6 +110,35 @@ static SpatialPatternProcessInfo apply_emission_to_spatial_pattern(SpatialPatter
     return info;
 }
 
+// The number of sectors that are processed simultaneously in the spreading pipeline
+static constexpr size_t s_sectorsInFlight = 4;
+
+// The threads that write the output rasters and the number of rasters that can be queued for writing
+static constexpr size_t s_rasterWriterThreads   = 2;
+static constexpr size_t s_rasterWriterQueueSize = 8;
+
+// A country for which the spatial pattern is loaded and that is ready to be spread
+struct CountrySpreadTask
+{
+    CountrySpreadTask(const CountryCellCoverage& cov, const EmissionIdentifier& id)
+    : coverage(&cov)
+    , emissionId(id)
+    {
+    }
+
+    const CountryCellCoverage* coverage = nullptr;
+    EmissionIdentifier emissionId;
+    const EmissionInventoryEntry* emission = nullptr; // owned by the emission inventory
+    double emissionToSpread                = 0.0;
+    SpatialPattern spatialPattern;
+};
+
+struct SectorSpreadTasks
+{
+    const NfrSector* sector = nullptr;
+    std::vector<CountrySpreadTask> tasks;
+};
+
 static GeoMetadata metadata_with_modified_cellsize(const GeoMetadata meta, GeoMetadata::CellSize cellsize)
 {
     GeoMetadata result = meta;
@@ -124,11 +166,13 @@ static void spread_emissions(const EmissionInventory& emissionInv, const Spatial
     }
 
     // A map that contains per country the remaining emission value that needs to be spread on a higher resolution
-    std::unordered_map<EmissionIdentifier, double> remainingEmissions;
+    std::unordered_map<EmissionKey, double> remainingEmissions;
 
-    std::unordered_set<EmissionIdentifier> spatialPatternsCoursestGridUniformFallback;
+    std::unordered_set<EmissionKey> spatialPatternsCoursestGridUniformFallback;
 
-    EmissionsCollector collector(cfg);
+    // Writes the output rasters in the background, the queue limits the number of rasters kept in memory
+    RasterWriter rasterWriter(summary, cfg.output_raster_options(), s_rasterWriterThreads, s_rasterWriterQueueSize);
+    EmissionsCollector collector(cfg, rasterWriter);
 
     for (auto gridIter = gridDefinitions.begin(); gridIter != gridDefinitions.end(); ++gridIter) {
         bool isCoursestGrid = gridIter == gridDefinitions.begin();
@@ -175,135 +219,172 @@ static void spread_emissions(const EmissionInventory& emissionInv, const Spatial
         for (const auto& pollutant : cfg.included_pollutants()) {
             collector.start_pollutant(pollutant, gridData);
 
-            for (const auto& sector : cfg.sectors().nfr_sectors()) {
-                ModelProgressInfo info;
-                info.info = fmt::format("[{}] Spread {} for '{}'", gridData.name, pollutant, sector.code());
-                progress.set_payload(info);
-                progress.tick();
+            // Loads the spatial pattern of a country, this is the I/O heavy part of the spreading
+            auto prepareCountry = [&](const NfrSector& sector, const CountryCellCoverage& cellCoverageInfo) -> std::optional<CountrySpreadTask> {
+                if (cellCoverageInfo.country == country::BEF) {
+                    return {};
+                }
 
-                const auto& sectorCoverages = sector.destination() == EmissionDestination::Eez ? eezCountryCoverages : countryCoverages;
+                if (cfg.sectors().is_ignored_nfr_sector(sector, cellCoverageInfo.country)) {
+                    return {};
+                }
 
-                // std::for_each(sectorCoverages.begin(), sectorCoverages.end(), [&](const CountryCellCoverage& cellCoverageInfo) {
-                tbb::parallel_for_each(sectorCoverages, [&](const CountryCellCoverage& cellCoverageInfo) {
-                    if (cellCoverageInfo.country == country::BEF) {
-                        return;
+                try {
+                    CountrySpreadTask task(cellCoverageInfo, EmissionIdentifier(cellCoverageInfo.country, EmissionSector(sector), pollutant));
+                    const auto& emissionId = task.emissionId;
+
+                    task.emission = emissionInv.find_emission_with_id(emissionId);
+                    if (task.emission == nullptr) {
+                        return {};
                     }
 
-                    if (cfg.sectors().is_ignored_sector(EmissionSector::Type::Nfr, sector.code(), cellCoverageInfo.country)) {
-                        return;
+                    if (isCoursestGrid) {
+                        // coursest grid, all emissions need to be spread
+                        task.emissionToSpread = task.emission->scaled_diffuse_emissions_sum();
+                    } else {
+                        // subgrid, only the emissions that ended up in this grid on the previous level need to be spread
+                        std::scoped_lock lock(mut);
+                        if (auto* remainingEmission = find_in_map(remainingEmissions, emissionId.key()); remainingEmission != nullptr) {
+                            task.emissionToSpread = *remainingEmission;
+                        } else {
+                            task.emissionToSpread = 0.0;
+                        }
                     }
 
-                    try {
-                        EmissionIdentifier emissionId(cellCoverageInfo.country, EmissionSector(sector), pollutant);
+                    if (task.emissionToSpread == 0.0 && task.emission->point_emissions().empty()) {
+                        return {};
+                    }
 
-                        const auto emission = emissionInv.try_emission_with_id(emissionId);
-                        if (!emission.has_value()) {
-                            return;
+                    if (isCoursestGrid) {
+                        // only check the spatial pattern grid contents for the coursest grid
+                        task.spatialPattern = spatialPatternInv.get_spatial_pattern_checked(emissionId, cellCoverageInfo);
+                        if (task.spatialPattern.source.patternAvailableButWithoutData) {
+                            std::scoped_lock lock(mut);
+                            // Store the fact that we fallback to uniform spread because of missing data
+                            // This needs to be checked on finer resolutions because on finer resolutions the contents are
+                            // no longer checked and there we allso need to fallback to uniform spread if we did on the coursest grid
+                            spatialPatternsCoursestGridUniformFallback.insert(emissionId.key());
                         }
-
-                        double emissionToSpread = 0.0;
-                        if (isCoursestGrid) {
-                            // coursest grid, all emissions need to be spread
-                            emissionToSpread = emission->scaled_diffuse_emissions_sum();
+                    } else {
+                        if (spatialPatternsCoursestGridUniformFallback.count(emissionId.key()) > 0) {
+                            // The coursest grid already fallbacked to uniform spread, so we do the same here
+                            task.spatialPattern = SpatialPattern(SpatialPatternSource::create_with_uniform_spread(emissionId.country, emissionId.sector, pollutant, true));
                         } else {
-                            // subgrid, only the emissions that ended up in this grid on the previous level need to be spread
-                            std::scoped_lock lock(mut);
-                            if (auto* remainingEmission = find_in_map(remainingEmissions, emissionId); remainingEmission != nullptr) {
-                                emissionToSpread = *remainingEmission;
-                            } else {
-                                emissionToSpread = 0.0;
-                            }
+                            task.spatialPattern = spatialPatternInv.get_spatial_pattern(emissionId, cellCoverageInfo);
                         }
+                    }
 
-                        if (emissionToSpread == 0.0 && emission->point_emissions().empty()) {
-                            return;
-                        }
+                    // Write the output raster to disk if configured
+                    if (cfg.output_spatial_pattern_rasters() && !task.spatialPattern.raster.empty()) {
+                        rasterWriter.write(task.spatialPattern.raster.to_dense(), cfg.output_path_for_spatial_pattern_raster(emissionId, gridData));
+                    }
 
-                        SpatialPattern spatialPattern;
-                        if (isCoursestGrid) {
-                            // only check the spatial pattern grid contents for the coursest grid
-                            spatialPattern = spatialPatternInv.get_spatial_pattern_checked(emissionId, cellCoverageInfo);
-                            if (spatialPattern.source.patternAvailableButWithoutData) {
-                                std::scoped_lock lock(mut);
-                                // Store the fact that we fallback to uniform spread because of missing data
-                                // This needs to be checked on finer resolutions because on finer resolutions the contents are
-                                // no longer checked and there we allso need to fallback to uniform spread if we did on the coursest grid
-                                spatialPatternsCoursestGridUniformFallback.insert(emissionId);
-                            }
-                        } else {
-                            if (spatialPatternsCoursestGridUniformFallback.count(emissionId) > 0) {
-                                // The coursest grid already fallbacked to uniform spread, so we do the same here
-                                spatialPattern = SpatialPattern(SpatialPatternSource::create_with_uniform_spread(emissionId.country, emissionId.sector, pollutant, true));
-                            } else {
-                                spatialPattern = spatialPatternInv.get_spatial_pattern(emissionId, cellCoverageInfo);
-                            }
-                        }
+                    return task;
+                } catch (const std::exception& e) {
+                    Log::error("Error spreading emission: {}", e.what());
+                }
 
-                        // Write the output raster to disk if configured
-                        if (cfg.output_spatial_pattern_rasters() && !spatialPattern.raster.empty()) {
-                            gdx::write_raster(spatialPattern.raster, cfg.output_path_for_spatial_pattern_raster(emissionId, gridData));
+                return {};
+            };
+
+            // Spreads the emission of a country over its loaded spatial pattern
+            auto spreadCountry = [&](const NfrSector& sector, CountrySpreadTask& task) {
+                try {
+                    const auto& cellCoverageInfo = *task.coverage;
+                    const auto& emissionId       = task.emissionId;
+                    const auto* emission         = task.emission;
+                    auto& spatialPattern         = task.spatialPattern;
+
+                    const auto spatPatInfo = apply_emission_to_spatial_pattern(spatialPattern, task.emissionToSpread, gridData.meta, cellCoverageInfo);
+                    if (isCoursestGrid) {
+                        if (spatPatInfo.status == SpatialPatternProcessInfo::Status::FallbackToUniformSpread) {
+                            summary.add_spatial_pattern_source_without_data(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, spatPatInfo.mass_balance_error(), *emission);
+                        } else {
+                            summary.add_spatial_pattern_source(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, spatPatInfo.mass_balance_error(), *emission);
                         }
+                    }
 
-                        const auto spatPatInfo = apply_emission_to_spatial_pattern(spatialPattern, emissionToSpread, gridData.meta, cellCoverageInfo);
-                        if (isCoursestGrid) {
-                            if (spatPatInfo.status == SpatialPatternProcessInfo::Status::FallbackToUniformSpread) {
-                                summary.add_spatial_pattern_source_without_data(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, *emission);
-                            } else {
-                                summary.add_spatial_pattern_source(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, *emission);
-                            }
-                        }
+                    if (spatialPattern.raster.empty()) {
+                        return;
+                    }
 
-                        if (spatialPattern.raster.empty()) {
-                            return;
+                    double erasedEmission = 0.0;
+                    if (subGridMeta.has_value()) {
+                        // Erase the region in the subgrid for which we will perform a higher resolution calculation
+                        erasedEmission = erase_area_in_raster_and_sum_erased_values(spatialPattern.raster, *subGridMeta);
+                        std::scoped_lock lock(mut);
+                        if (erasedEmission > 0) {
+                            remainingEmissions[emissionId.key()] = erasedEmission;
+                        } else {
+                            remainingEmissions.erase(emissionId.key());
                         }
+                    }
 
-                        double erasedEmission = 0.0;
-                        if (subGridMeta.has_value()) {
-                            // Erase the region in the subgrid for which we will perform a higher resolution calculation
-                            erasedEmission = erase_area_in_raster_and_sum_erased_values(spatialPattern.raster, *subGridMeta);
-                            std::scoped_lock lock(mut);
-                            if (erasedEmission > 0) {
-                                remainingEmissions[emissionId] = erasedEmission;
-                            } else {
-                                remainingEmissions.erase(emissionId);
-                            }
-                        }
+                    if (validator) {
+                        validator->add_diffuse_emissions(emissionId, spatialPattern.raster, spatPatInfo.emissions_outside_of_the_grid());
+                    }
 
+                    // Add the point sources to the grid
+                    if (isCoursestGrid) {
+                        // Only add the point emissions once for the coursest grid as they are resolution independent
+                        collector.add_emissions(cellCoverageInfo, sector, std::move(spatialPattern.raster), emission->scaled_point_emissions());
                         if (validator) {
-                            validator->add_diffuse_emissions(emissionId, spatialPattern.raster, spatPatInfo.emissions_outside_of_the_grid());
+                            validator->add_point_emissions(emissionId, emission->scaled_point_emissions_sum());
                         }
+                    } else {
+                        collector.add_emissions(cellCoverageInfo, sector, std::move(spatialPattern.raster), {});
+                    }
+                } catch (const std::exception& e) {
+                    Log::error("Error spreading emission: {}", e.what());
+                }
+            };
 
-                        // Add the point sources to the grid
-                        auto pointEmissions = container_as_vector(emission->scaled_point_emissions());
-                        if (subGridMeta.has_value()) {
-                            // remove the points from the subGrid
-                            remove_from_container(pointEmissions, [meta = *subGridMeta](const EmissionEntry& entry) {
-                                if (!entry.coordinate().has_value()) {
-                                    return true;
-                                }
-
-                                if (meta.is_on_map(*entry.coordinate())) {
-                                    return true;
-                                }
-
-                                return false;
-                            });
-                        }
+            // Pipeline over the sectors: the spatial patterns of the upcoming sectors are loaded
+            // while the emissions of the current sector are being spread, so the cores don't block on disk
+            const auto nfrSectors = cfg.sectors().nfr_sectors();
+            auto sectorIter       = nfrSectors.begin();
 
-                        if (isCoursestGrid) {
-                            // Only add the point emissions once for the coursest grid as they are resolution independent
-                            collector.add_emissions(cellCoverageInfo, sector, std::move(spatialPattern.raster), emission->scaled_point_emissions());
-                            if (validator) {
-                                validator->add_point_emissions(emissionId, emission->scaled_point_emissions_sum());
-                            }
-                        } else {
-                            collector.add_emissions(cellCoverageInfo, sector, std::move(spatialPattern.raster), {});
-                        }
-                    } catch (const std::exception& e) {
-                        Log::error("Error spreading emission: {}", e.what());
+            auto nextSector = tbb::make_filter<void, const NfrSector*>(tbb::filter_mode::serial_in_order, [&](tbb::flow_control& fc) -> const NfrSector* {
+                if (sectorIter == nfrSectors.end()) {
+                    fc.stop();
+                    return nullptr;
+                }
+
+                const auto& sector = *sectorIter++;
+
+                ModelProgressInfo info;
+                info.info = fmt::format("[{}] Spread {} for '{}'", gridData.name, pollutant, sector.code());
+                progress.set_payload(info);
+                progress.tick();
+                return &sector;
+            });
+
+            auto loadPatterns = tbb::make_filter<const NfrSector*, SectorSpreadTasks>(tbb::filter_mode::parallel, [&](const NfrSector* sector) {
+                const auto& sectorCoverages = sector->destination() == EmissionDestination::Eez ? eezCountryCoverages : countryCoverages;
+
+                std::vector<std::optional<CountrySpreadTask>> countryTasks(sectorCoverages.size());
+                tbb::parallel_for(size_t(0), sectorCoverages.size(), [&](size_t i) {
+                    countryTasks[i] = prepareCountry(*sector, sectorCoverages[i]);
+                });
+
+                SectorSpreadTasks result;
+                result.sector = sector;
+                for (auto& task : countryTasks) {
+                    if (task.has_value()) {
+                        result.tasks.push_back(std::move(*task));
                     }
+                }
+
+                return result;
+            });
+
+            auto spreadEmissions = tbb::make_filter<SectorSpreadTasks, void>(tbb::filter_mode::parallel, [&](SectorSpreadTasks sectorTasks) {
+                tbb::parallel_for_each(sectorTasks.tasks, [&](CountrySpreadTask& task) {
+                    spreadCountry(*sectorTasks.sector, task);
                 });
-            }
+            });
+
+            tbb::parallel_pipeline(s_sectorsInFlight, nextSector & loadPatterns & spreadEmissions);
 
             if (gridIter + 1 == gridDefinitions.end()) {
                 // Now do flanders (for finest grid)
@@ -312,7 +393,7 @@ static void spread_emissions(const EmissionInventory& emissionInv, const Spatial
                 tbb::parallel_for_each(sectors, [&](const NfrSector& sector) {
                     EmissionIdentifier emissionId(country::BEF, EmissionSector(sector), pollutant);
 
-                    if (cfg.sectors().is_ignored_sector(EmissionSector::Type::Nfr, sector.code(), country::BEF)) {
+                    if (cfg.sectors().is_ignored_nfr_sector(sector, country::BEF)) {
                         return;
                     }
 
@@ -321,24 +402,24 @@ static void spread_emissions(const EmissionInventory& emissionInv, const Spatial
                         return cov.country == country::BEF;
                     });
 
-                    auto emission = emissionInv.try_emission_with_id(emissionId);
-                    if (!emission.has_value()) {
+                    const auto* emission = emissionInv.find_emission_with_id(emissionId);
+                    if (emission == nullptr) {
                         return;
                     }
 
                     auto spatialPattern         = spatialPatternInv.get_spatial_pattern_checked(emissionId, flandersCoverage);
                     const auto diffuseEmissions = emission->scaled_diffuse_emissions_sum();
                     if (cfg.output_spatial_pattern_rasters() && !spatialPattern.raster.empty()) {
-                        gdx::write_raster(spatialPattern.raster, cfg.output_path_for_spatial_pattern_raster(emissionId, gridData));
+                        rasterWriter.write(spatialPattern.raster.to_dense(), cfg.output_path_for_spatial_pattern_raster(emissionId, gridData));
                     }
 
                     const auto spatPatInfo = apply_emission_to_spatial_pattern(spatialPattern, diffuseEmissions, gridData.meta, flandersCoverage);
 
                     if (spatialPattern.source.patternAvailableButWithoutData) {
                         Log::debug("No spatial pattern information available for {}: falling back to uniform spread", emissionId);
-                        summary.add_spatial_pattern_source_without_data(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, *emission);
+                        summary.add_spatial_pattern_source_without_data(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, spatPatInfo.mass_balance_error(), *emission);
                     } else {
-                        summary.add_spatial_pattern_source(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, *emission);
+                        summary.add_spatial_pattern_source(spatialPattern.source, spatPatInfo.diffuseEmissions, spatPatInfo.emissionsWithinOutput, spatPatInfo.mass_balance_error(), *emission);
                     }
 
                     if (validator) {
@@ -359,6 +440,8 @@ static void spread_emissions(const EmissionInventory& emissionInv, const Spatial
 
         collector.final_flush_to_disk(isCoursestGrid ? EmissionsCollector::WriteMode::Create : EmissionsCollector::WriteMode::Append);
     }
+
+    rasterWriter.wait_until_done();
 }
 
 static void clean_output_directory(const fs::path& p)
@@ -376,7 +459,8 @@ static void clean_output_directory(const fs::path& p)
                     fs::remove(entry);
                 }
             } else if (entry.is_directory()) {
-                if (entry.path().stem() != "grids") {
+                // Keep the cached grids and the spatial pattern manifest between runs
+                if (entry.path().stem() != "grids" && entry.path().stem() != "cache") {
                     fs::remove_all(entry.path());
                 }
             }
@@ -427,7 +511,7 @@ int run_model(const RunConfiguration& cfg, const ModelProgress::Callback& progre
 
         // scan the available spatial patterns for the configured year
         SpatialPatternInventory spatPatInv(cfg);
-        spatPatInv.scan_dir(cfg.reporting_year(), cfg.year(), cfg.spatial_pattern_path());
+        spatPatInv.scan_dir(cfg.reporting_year(), cfg.year(), cfg.spatial_pattern_path(), cfg.cache_dir_path() / "spatial_patterns.manifest");
 
         // remove existing results in the output directory
         clean_output_directory(cfg.output_path());
@@ -447,6 +531,11 @@ int run_model(const RunConfiguration& cfg, const ModelProgress::Callback& progre
         }
         summary.write_summary(cfg.output_path());
 
+        // the summary is still written so the failed rasters are listed, but the output is incomplete
+        if (const auto writeErrors = summary.raster_write_errors(); !writeErrors.empty()) {
+            throw RuntimeError("{} output raster(s) could not be written, see the run summary", writeErrors.size());
+        }
+
         return EXIT_SUCCESS;
     } catch (const std::exception& e) {
         Log::error(e.what());
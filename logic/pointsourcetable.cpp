@@ -0,0 +1,129 @@
+#include "emap/pointsourcetable.h"
+
+#include "infra/cast.h"
+
+#include <numeric>
+
+namespace emap {
+
+using namespace inf;
+
+EmissionEntry PointSourceRow::to_entry() const
+{
+    EmissionEntry entry(id(), value());
+    if (auto coord = coordinate(); coord.has_value()) {
+        entry.set_coordinate(*coord);
+    }
+
+    entry.set_height(height());
+    entry.set_diameter(diameter());
+    entry.set_temperature(temperature());
+    entry.set_warmth_contents(warmth_contents());
+    entry.set_flow_rate(flow_rate());
+    entry.set_dv(dv());
+    entry.set_source_id(source_id());
+    return entry;
+}
+
+PointSourceTable::PointSourceTable(std::span<const EmissionEntry> entries)
+{
+    reserve(entries.size());
+    for (const auto& entry : entries) {
+        push_back(entry);
+    }
+}
+
+void PointSourceTable::reserve(size_t size)
+{
+    _ids.reserve(size);
+    _amounts.reserve(size);
+    _x.reserve(size);
+    _y.reserve(size);
+    _stacks.reserve(size);
+    _dv.reserve(size);
+    _flags.reserve(size);
+    _sourceIds.reserve(size);
+}
+
+void PointSourceTable::push_back(const EmissionEntry& entry)
+{
+    StackParameters stack;
+    stack.height         = entry.height();
+    stack.diameter       = entry.diameter();
+    stack.temperature    = entry.temperature();
+    stack.warmthContents = entry.warmth_contents();
+    stack.flowRate       = entry.flow_rate();
+
+    push_back(entry.id(), entry.value().amount(), entry.coordinate(), stack, entry.dv(), entry.source_id());
+}
+
+void PointSourceTable::push_back(const PointSourceRow& row)
+{
+    push_back(row.id(), row.value().amount(), row.coordinate(), row._table->_stacks[row.index()], row.dv(), row.source_id());
+}
+
+void PointSourceTable::push_back(const EmissionIdentifier& id, std::optional<double> amount, std::optional<Coordinate> coordinate, const StackParameters& stack, std::optional<int32_t> dv, std::string_view sourceId)
+{
+    uint8_t flags = 0;
+    if (amount.has_value()) {
+        flags |= HasAmount;
+    }
+
+    if (coordinate.has_value()) {
+        flags |= HasCoordinate;
+    }
+
+    if (dv.has_value()) {
+        flags |= HasDv;
+    }
+
+    // intern first, it is the only operation that can throw after the row is partially added
+    const auto sourceIdIndex = intern_source_id(sourceId);
+
+    _ids.push_back(id);
+    _amounts.push_back(amount.value_or(0.0));
+    _x.push_back(coordinate.has_value() ? coordinate->x : 0.0);
+    _y.push_back(coordinate.has_value() ? coordinate->y : 0.0);
+    _stacks.push_back(stack);
+    _dv.push_back(dv.value_or(0));
+    _flags.push_back(flags);
+    _sourceIds.push_back(sourceIdIndex);
+}
+
+uint32_t PointSourceTable::intern_source_id(std::string_view sourceId)
+{
+    if (_sourceIdNames.empty()) {
+        // index 0 is the empty source id
+        _sourceIdNames.emplace_back();
+        _sourceIdIndexes.emplace(std::string(), 0);
+    }
+
+    auto [iter, inserted] = _sourceIdIndexes.try_emplace(std::string(sourceId), truncate<uint32_t>(_sourceIdNames.size()));
+    if (inserted) {
+        _sourceIdNames.emplace_back(sourceId);
+    }
+
+    return iter->second;
+}
+
+double PointSourceTable::amount_sum() const noexcept
+{
+    // missing amounts are stored as 0
+    return std::accumulate(_amounts.begin(), _amounts.end(), 0.0);
+}
+
+PointSourceTable PointSourceTable::scaled(double factor) const
+{
+    auto result = *this;
+    for (auto& amount : result._amounts) {
+        amount *= factor;
+    }
+
+    for (auto& flags : result._flags) {
+        flags |= HasAmount;
+    }
+
+    return result;
+}
+
+}
@@ -5,22 +5,97 @@
 #include "infra/cast.h"
 #include "infra/enumutils.h"
 #include "infra/exception.h"
+#include "infra/hash.h"
 #include "infra/string.h"
+#include "internedstore.h"
 
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <limits>
+#include <mutex>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
 
 namespace emap {
 
 using namespace inf;
 
+uint16_t pollutant_code_ordinal(std::string_view code)
+{
+    if (code.empty()) {
+        return 0;
+    }
+
+    // Function local so the registry is available for pollutants constructed during static initialization
+    static std::mutex mutex;
+    static std::unordered_map<std::string, uint16_t> ordinals;
+
+    std::scoped_lock lock(mutex);
+    if (auto iter = ordinals.find(std::string(code)); iter != ordinals.end()) {
+        return iter->second;
+    }
+
+    if (ordinals.size() >= std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeError("Too many pollutant codes: {}", code);
+    }
+
+    const auto ordinal = truncate<uint16_t>(ordinals.size() + 1);
+    ordinals.emplace(code, ordinal);
+    return ordinal;
+}
+
+struct PollutantInfo
+{
+    std::string code;
+    std::string name;
+
+    bool operator==(const PollutantInfo& other) const noexcept = default;
+};
+
+struct PollutantInfoHash
+{
+    size_t operator()(const PollutantInfo& info) const noexcept
+    {
+        size_t seed = 0;
+        inf::hash_combine(seed, info.code, info.name);
+        return seed;
+    }
+};
+
+static InternedStore<PollutantInfo, PollutantInfoHash>& pollutant_info_store()
+{
+    // Function local so the store is available for the pollutants constructed during static initialization
+    static InternedStore<PollutantInfo, PollutantInfoHash> store;
+    return store;
+}
+
+Pollutant::Pollutant(std::string_view code, std::string_view name)
+: _info(pollutant_info_store().intern(PollutantInfo{std::string(code), std::string(name)}))
+, _ordinal(pollutant_code_ordinal(code))
+{
+}
+
+std::string_view Pollutant::code() const noexcept
+{
+    return pollutant_info_store()[_info].code;
+}
+
+std::string_view Pollutant::full_name() const noexcept
+{
+    return pollutant_info_store()[_info].name;
+}
+
 PollutantInventory::PollutantInventory(std::vector<Pollutant> pollutants, InputConversions conversions, std::vector<IgnoredName> ignoredPollutants)
 : _pollutants(std::move(pollutants))
 , _ignoredPollutants(std::move(ignoredPollutants))
 , _conversions(std::move(conversions))
 {
+    _codeIndex.reserve(_pollutants.size());
+    for (size_t i = 0; i < _pollutants.size(); ++i) {
+        _codeIndex.try_emplace(std::string(_pollutants[i].code()), i);
+    }
 }
 
 Pollutant PollutantInventory::pollutant_from_string(std::string_view str) const
@@ -39,11 +114,11 @@ std::optional<Pollutant> PollutantInventory::try_pollutant_from_string(std::stri
         pollutantCode = str; // not all valid names have to be present in the conversion table
     }
 
-    const auto* pollutant = find_in_container(_pollutants, [pollutantCode](const Pollutant& pol) {
-        return str::iequals(pol.code(), pollutantCode);
-    });
+    if (auto iter = _codeIndex.find(pollutantCode); iter != _codeIndex.end()) {
+        return _pollutants[iter->second];
+    }
 
-    return pollutant ? *pollutant : std::optional<Pollutant>();
+    return {};
 }
 
 size_t PollutantInventory::pollutant_count() const noexcept
@@ -68,9 +143,7 @@ void PollutantInventory::add_fallback_for_pollutant(const Pollutant& pollutant,
 
 bool PollutantInventory::is_ignored_pollutant(std::string_view str, const Country& country) const noexcept
 {
-    return std::any_of(_ignoredPollutants.begin(), _ignoredPollutants.end(), [=, countryId = country.id()](const IgnoredName& ign) {
-        return ign.is_ignored_for_country(str, countryId);
-    });
+    return _ignoredPollutants.is_ignored_for_country(str, country.id());
 }
 
 }
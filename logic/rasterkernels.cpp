@@ -0,0 +1,123 @@
+#include "rasterkernels.h"
+
+#include "infra/exception.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Compile multiple versions of the kernels, the loader selects the best version for the cpu
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && defined(__linux__)
+#define EMAP_KERNEL_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define EMAP_KERNEL_TARGETS
+#endif
+
+namespace emap {
+
+using namespace inf;
+
+EMAP_KERNEL_TARGETS void add_values_nan_aware(std::span<double> result, std::span<const double> values) noexcept
+{
+    assert(result.size() == values.size());
+
+    double* res       = result.data();
+    const double* val = values.data();
+    const auto size   = result.size();
+
+    // branch free so the loop vectorizes, the selects produce the same values as the branches
+    for (size_t i = 0; i < size; ++i) {
+        const auto toAdd = val[i];
+        const auto value = res[i];
+        res[i]           = std::isnan(toAdd) ? value : (std::isnan(value) ? toAdd : value + toAdd);
+    }
+}
+
+EMAP_KERNEL_TARGETS void multiply_values(std::span<double> values, double factor) noexcept
+{
+    double* val     = values.data();
+    const auto size = values.size();
+
+    for (size_t i = 0; i < size; ++i) {
+        val[i] = val[i] * factor;
+    }
+}
+
+EMAP_KERNEL_TARGETS void divide_values(std::span<double> values, double divisor) noexcept
+{
+    double* val     = values.data();
+    const auto size = values.size();
+
+    for (size_t i = 0; i < size; ++i) {
+        val[i] = val[i] / divisor;
+    }
+}
+
+double sum_and_erase_values(std::span<double> values, double sum) noexcept
+{
+    // the sum is not vectorized, that would change the summation order
+    sum = std::accumulate(values.begin(), values.end(), sum);
+    std::fill(values.begin(), values.end(), std::numeric_limits<double>::quiet_NaN());
+    return sum;
+}
+
+static Cell top_left_cell_in(const GeoMetadata& meta, const GeoMetadata& area)
+{
+    const auto topLeft = area.convert_cell_centre_to_xy(Cell(0, 0));
+    return meta.convert_xy_to_cell(topLeft.x, topLeft.y);
+}
+
+static bool area_on_map(const GeoMetadata& meta, Cell topLeft, const GeoMetadata& area) noexcept
+{
+    return meta.is_on_map(topLeft) && meta.is_on_map(Cell(topLeft.r + area.rows - 1, topLeft.c + area.cols - 1));
+}
+
+void add_raster_nan_aware(gdx::DenseRaster<double>& result, const gdx::DenseRaster<double>& values)
+{
+    const auto& resultMeta = result.metadata();
+    const auto& valuesMeta = values.metadata();
+
+    auto intersection = metadata_intersection(resultMeta, valuesMeta);
+    if (intersection.rows == 0 || intersection.cols == 0) {
+        return;
+    }
+
+    const auto resultTopLeft = top_left_cell_in(resultMeta, intersection);
+    const auto valuesTopLeft = top_left_cell_in(valuesMeta, intersection);
+
+    if (resultMeta.cell_size_x() != valuesMeta.cell_size_x() || resultMeta.cell_size_y() != valuesMeta.cell_size_y() ||
+        !area_on_map(resultMeta, resultTopLeft, intersection) || !area_on_map(valuesMeta, valuesTopLeft, intersection)) {
+        throw RuntimeError("Country raster should be a subgrid of the grid raster");
+    }
+
+    // the sub areas are strided in the rasters, process them row by row
+    for (int32_t r = 0; r < intersection.rows; ++r) {
+        std::span<double> resultRow(&result[Cell(resultTopLeft.r + r, resultTopLeft.c)], intersection.cols);
+        std::span<const double> valuesRow(&values[Cell(valuesTopLeft.r + r, valuesTopLeft.c)], intersection.cols);
+        add_values_nan_aware(resultRow, valuesRow);
+    }
+}
+
+double sum_and_erase_area(gdx::DenseRaster<double>& raster, const GeoMetadata& extent)
+{
+    const auto intersection = metadata_intersection(raster.metadata(), extent);
+    if (intersection.rows == 0 || intersection.cols == 0) {
+        return 0.0;
+    }
+
+    const auto topLeft = top_left_cell_in(raster.metadata(), intersection);
+    if (!area_on_map(raster.metadata(), topLeft, intersection)) {
+        throw RuntimeError("Extent should be a subgrid of the raster");
+    }
+
+    double sum = 0.0;
+    for (int32_t r = 0; r < intersection.rows; ++r) {
+        sum = sum_and_erase_values(std::span<double>(&raster[Cell(topLeft.r + r, topLeft.c)], intersection.cols), sum);
+    }
+
+    return sum;
+}
+
+}
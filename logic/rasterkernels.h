@@ -0,0 +1,33 @@
+#pragma once
+
+#include "gdx/denseraster.h"
+#include "infra/geometadata.h"
+
+#include <span>
+
+namespace emap {
+
+/* Kernels for the innermost raster loops, NaN is treated as nodata
+ * The kernels work on contiguous rows so the compiler can vectorize them, on x86-64 builds with gcc or clang
+ * the best instruction set (avx512, avx2 or the baseline) is selected at runtime
+ * The results are bit identical for every instruction set: the operations are element wise and sums are not reordered */
+
+// result = values where result is nodata, result where values is nodata, result + values otherwise
+void add_values_nan_aware(std::span<double> result, std::span<const double> values) noexcept;
+
+// Multiplies all the values with the factor
+void multiply_values(std::span<double> values, double factor) noexcept;
+
+// Divides all the values by the divisor
+void divide_values(std::span<double> values, double divisor) noexcept;
+
+// Adds the values (in order) to the sum and replaces them by nodata, returns the new sum
+double sum_and_erase_values(std::span<double> values, double sum) noexcept;
+
+// NaN aware addition of the overlapping area of the rasters, throws when the raster cells are not aligned
+void add_raster_nan_aware(gdx::DenseRaster<double>& result, const gdx::DenseRaster<double>& values);
+
+// Returns the sum of the raster values in the extent and replaces them by nodata
+double sum_and_erase_area(gdx::DenseRaster<double>& raster, const inf::GeoMetadata& extent);
+
+}
@@ -0,0 +1,283 @@
+#include "rasterwriter.h"
+#include "runsummary.h"
+
+#include "gdx/denserasterio.h"
+#include "infra/cast.h"
+#include "infra/exception.h"
+#include "infra/log.h"
+#include "infra/string.h"
+
+#include <fmt/core.h>
+#include <gdal.h>
+#include <oneapi/tbb/global_control.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace emap {
+
+using namespace inf;
+
+static std::string_view compression_name(RasterCompression compression)
+{
+    switch (compression) {
+    case RasterCompression::Deflate:
+        return "DEFLATE";
+    case RasterCompression::Zstd:
+        return "ZSTD";
+    case RasterCompression::None:
+        break;
+    }
+
+    return "NONE";
+}
+
+std::vector<std::string> geotiff_creation_options(const RasterOutputOptions& options, int32_t encodingThreads)
+{
+    std::vector<std::string> result;
+    if (options.tiled) {
+        result.push_back("TILED=YES");
+        result.push_back(fmt::format("BLOCKXSIZE={}", options.tileSize));
+        result.push_back(fmt::format("BLOCKYSIZE={}", options.tileSize));
+    }
+
+    if (options.compression != RasterCompression::None) {
+        result.push_back(fmt::format("COMPRESS={}", compression_name(options.compression)));
+        if (options.predictor) {
+            // floating point predictor
+            result.push_back("PREDICTOR=3");
+        }
+
+        // compress the tiles (or strips) in parallel
+        result.push_back(fmt::format("NUM_THREADS={}", encodingThreads));
+        result.push_back("BIGTIFF=IF_SAFER");
+    }
+
+    return result;
+}
+
+std::vector<std::string> cog_creation_options(const RasterOutputOptions& options, int32_t encodingThreads)
+{
+    std::vector<std::string> result;
+    result.push_back(fmt::format("BLOCKSIZE={}", options.tileSize));
+    result.push_back(fmt::format("COMPRESS={}", compression_name(options.compression)));
+    if (options.predictor && options.compression != RasterCompression::None) {
+        result.push_back("PREDICTOR=FLOATING_POINT");
+    }
+
+    result.push_back("OVERVIEWS=AUTO");
+    result.push_back("OVERVIEW_RESAMPLING=AVERAGE");
+    result.push_back(fmt::format("NUM_THREADS={}", encodingThreads));
+    result.push_back("BIGTIFF=IF_SAFER");
+    return result;
+}
+
+static std::vector<char*> to_gdal_options(const std::vector<std::string>& options)
+{
+    std::vector<char*> result;
+    result.reserve(options.size() + 1);
+    for (auto& opt : options) {
+        result.push_back(const_cast<char*>(opt.c_str()));
+    }
+    result.push_back(nullptr);
+    return result;
+}
+
+static GDALDatasetH open_dataset(const fs::path& path, GDALAccess access)
+{
+    auto* ds = GDALOpen(str::from_u8(path.u8string()).c_str(), access);
+    if (ds == nullptr) {
+        throw RuntimeError("Failed to open raster: {}", CPLGetLastErrorMsg());
+    }
+
+    return ds;
+}
+
+// Add internal overviews until the overview fits in a single tile
+static void build_overviews(const fs::path& path, int32_t tileSize)
+{
+    auto* ds        = open_dataset(path, GA_Update);
+    const auto size = std::max(GDALGetRasterXSize(ds), GDALGetRasterYSize(ds));
+    std::vector<int> levels;
+    for (int level = 2; size / (level / 2) > tileSize; level *= 2) {
+        levels.push_back(level);
+    }
+
+    const auto err = levels.empty() ? CE_None : GDALBuildOverviews(ds, "AVERAGE", static_cast<int>(levels.size()), levels.data(), 0, nullptr, nullptr, nullptr);
+    GDALClose(ds);
+
+    if (err != CE_None) {
+        throw RuntimeError("Failed to build raster overviews: {}", CPLGetLastErrorMsg());
+    }
+}
+
+// Removes the file when it goes out of scope, also when an exception is thrown
+class TemporaryFile
+{
+public:
+    explicit TemporaryFile(fs::path path)
+    : _path(std::move(path))
+    {
+    }
+
+    TemporaryFile(const TemporaryFile&)            = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile() noexcept
+    {
+        std::error_code ec;
+        fs::remove(_path, ec);
+    }
+
+    const fs::path& path() const noexcept
+    {
+        return _path;
+    }
+
+private:
+    fs::path _path;
+};
+
+// The COG driver can only create a copy, the raster is first written as an uncompressed tiled GeoTIFF
+static void write_cloud_optimized_raster(gdx::DenseRaster<double>&& raster, const fs::path& path, const RasterOutputOptions& options, int32_t encodingThreads)
+{
+    auto* driver = GDALGetDriverByName("COG");
+    if (driver == nullptr) {
+        throw RuntimeError("The gdal COG driver is not available");
+    }
+
+    auto tempPath = path;
+    tempPath += ".tmp.tif";
+    const TemporaryFile tempFile(tempPath);
+
+    RasterOutputOptions tempOptions;
+    tempOptions.tiled    = true;
+    tempOptions.tileSize = options.tileSize;
+    gdx::write_raster(std::move(raster), tempFile.path(), geotiff_creation_options(tempOptions, encodingThreads));
+
+    auto* srcDs      = open_dataset(tempFile.path(), GA_ReadOnly);
+    auto cogOptions  = cog_creation_options(options, encodingThreads);
+    auto gdalOptions = to_gdal_options(cogOptions);
+    auto* dstDs      = GDALCreateCopy(driver, str::from_u8(path.u8string()).c_str(), srcDs, FALSE, gdalOptions.data(), nullptr, nullptr);
+    GDALClose(srcDs);
+
+    if (dstDs == nullptr) {
+        throw RuntimeError("Failed to create cloud optimized raster: {}", CPLGetLastErrorMsg());
+    }
+
+    GDALClose(dstDs);
+}
+
+RasterWriter::RasterWriter(RunSummary& summary, const RasterOutputOptions& options, size_t threadCount, size_t queueCapacity)
+: _summary(summary)
+, _options(options)
+, _queueCapacity(queueCapacity)
+{
+    assert(threadCount > 0 && queueCapacity > 0);
+
+    // The spreading keeps running on the tbb threads, the writer threads share the configured concurrency for the compression
+    const auto concurrency = tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism);
+    _encodingThreads       = std::max(1, truncate<int32_t>(concurrency / threadCount));
+
+    try {
+        _threads.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; ++i) {
+            _threads.emplace_back([this]() {
+                process_jobs();
+            });
+        }
+    } catch (...) {
+        // the threads that were started have to be joined before they are destroyed
+        stop_and_join();
+        throw;
+    }
+}
+
+RasterWriter::~RasterWriter() noexcept
+{
+    stop_and_join();
+}
+
+void RasterWriter::stop_and_join() noexcept
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _stop = true;
+    }
+
+    _jobQueued.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+void RasterWriter::write(gdx::DenseRaster<double> raster, fs::path path)
+{
+    {
+        std::unique_lock lock(_mutex);
+        _jobTaken.wait(lock, [this]() {
+            return _queue.size() < _queueCapacity;
+        });
+
+        _queue.push_back(Job{std::move(raster), std::move(path)});
+    }
+
+    _jobQueued.notify_one();
+}
+
+void RasterWriter::wait_until_done()
+{
+    std::unique_lock lock(_mutex);
+    _jobTaken.wait(lock, [this]() {
+        return _queue.empty() && _activeJobs == 0;
+    });
+}
+
+void RasterWriter::process_jobs()
+{
+    for (;;) {
+        std::unique_lock lock(_mutex);
+        _jobQueued.wait(lock, [this]() {
+            return _stop || !_queue.empty();
+        });
+
+        if (_queue.empty()) {
+            // stop requested and all the jobs are processed
+            return;
+        }
+
+        auto job = std::move(_queue.front());
+        _queue.pop_front();
+        ++_activeJobs;
+        lock.unlock();
+        _jobTaken.notify_all();
+
+        try {
+            write_job(job);
+        } catch (const std::exception& e) {
+            Log::error("Failed to write raster {}: {}", job.path, e.what());
+            _summary.add_raster_write_error(job.path, e.what());
+        }
+
+        lock.lock();
+        --_activeJobs;
+        lock.unlock();
+        _jobTaken.notify_all();
+    }
+}
+
+void RasterWriter::write_job(Job& job) const
+{
+    if (_options.is_default()) {
+        gdx::write_raster(std::move(job.raster), job.path);
+    } else if (_options.cloudOptimized) {
+        write_cloud_optimized_raster(std::move(job.raster), job.path, _options, _encodingThreads);
+    } else {
+        gdx::write_raster(std::move(job.raster), job.path, geotiff_creation_options(_options, _encodingThreads));
+        if (_options.overviews) {
+            build_overviews(job.path, _options.tileSize);
+        }
+    }
+}
+
+}
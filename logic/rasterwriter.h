@@ -0,0 +1,70 @@
+#pragma once
+
+#include "emap/runconfiguration.h"
+#include "gdx/denseraster.h"
+#include "infra/filesystem.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace emap {
+
+class RunSummary;
+
+// The GeoTIFF driver creation options for the configured output options (tiling, compression and predictor)
+// The encoding threads is the number of threads gdal uses to compress the tiles of a single raster
+std::vector<std::string> geotiff_creation_options(const RasterOutputOptions& options, int32_t encodingThreads);
+// The COG driver creation options for the configured output options
+std::vector<std::string> cog_creation_options(const RasterOutputOptions& options, int32_t encodingThreads);
+
+/* Writes rasters to disk on dedicated threads so the encoding of the files does not block the compute threads
+ * The queue is bounded: queueing a raster blocks while the queue is full to limit the memory use
+ * Write failures are logged and added to the run summary
+ * The compression of the tiles is done in parallel by gdal, the configured concurrency is divided over the writer threads */
+class RasterWriter
+{
+public:
+    RasterWriter(RunSummary& summary, const RasterOutputOptions& options, size_t threadCount, size_t queueCapacity);
+    RasterWriter(const RasterWriter&)            = delete;
+    RasterWriter& operator=(const RasterWriter&) = delete;
+    // Writes the remaining queued rasters
+    ~RasterWriter() noexcept;
+
+    // Can be called concurrently
+    void write(gdx::DenseRaster<double> raster, fs::path path);
+    // Blocks until all the queued rasters are written
+    void wait_until_done();
+
+private:
+    struct Job
+    {
+        gdx::DenseRaster<double> raster;
+        fs::path path;
+    };
+
+    void process_jobs();
+    void stop_and_join() noexcept;
+    void write_job(Job& job) const;
+
+    RunSummary& _summary;
+    RasterOutputOptions _options;
+    int32_t _encodingThreads = 1;
+    size_t _queueCapacity;
+
+    std::mutex _mutex;
+    std::condition_variable _jobQueued;
+    std::condition_variable _jobTaken; // also signaled when a job is finished
+    std::deque<Job> _queue;
+    size_t _activeJobs = 0;
+    bool _stop         = false;
+
+    std::vector<std::thread> _threads;
+};
+
+}
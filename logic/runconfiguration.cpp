@@ -111,6 +111,11 @@ const fs::path& RunConfiguration::output_path() const noexcept
     return _paths.output_path();
 }
 
+fs::path RunConfiguration::cache_dir_path() const
+{
+    return _paths.cache_dir_path();
+}
+
 const fs::path& RunConfiguration::spatial_pattern_exceptions() const noexcept
 {
     return _spatialPatternExceptions;
@@ -219,6 +224,26 @@ std::optional<int32_t> RunConfiguration::max_concurrency() const noexcept
     return _concurrency;
 }
 
+void RunConfiguration::set_single_precision_spatial_patterns(bool enabled) noexcept
+{
+    _singlePrecisionSpatialPatterns = enabled;
+}
+
+bool RunConfiguration::single_precision_spatial_patterns() const noexcept
+{
+    return _singlePrecisionSpatialPatterns;
+}
+
+void RunConfiguration::set_emission_inventory_snapshot(bool enabled) noexcept
+{
+    _emissionInventorySnapshot = enabled;
+}
+
+bool RunConfiguration::emission_inventory_snapshot() const noexcept
+{
+    return _emissionInventorySnapshot;
+}
+
 std::vector<Pollutant> RunConfiguration::included_pollutants() const
 {
     if (_includedPollutants.empty()) {
@@ -293,6 +318,11 @@ bool RunConfiguration::output_spatial_pattern_rasters() const noexcept
     return _outputConfig.createSpatialPatternRasters;
 }
 
+const RasterOutputOptions& RunConfiguration::output_raster_options() const noexcept
+{
+    return _outputConfig.rasterOptions;
+}
+
 bool RunConfiguration::output_point_sources_separately() const noexcept
 {
     return _outputConfig.separatePointSources;
@@ -26,12 +26,13 @@ RunSummary::RunSummary(const RunConfiguration& cfg)
 {
 }
 
-void RunSummary::add_spatial_pattern_source(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, const EmissionInventoryEntry& emission)
+void RunSummary::add_spatial_pattern_source(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, double massBalanceError, const EmissionInventoryEntry& emission)
 {
     SpatialPatternSummaryInfo info;
     info.source                           = source;
     info.scaledDiffuseEmissions           = scaledDiffuseEmissions;
     info.scaledDiffuseEmissionsWithinGrid = scaledDiffuseEmissionsWithinGrid;
+    info.massBalanceError                 = massBalanceError;
     info.scaledPointEmissions             = emission.scaled_point_emissions_sum();
     info.diffuseScalingUser               = emission.diffuse_user_scaling_factor();
     info.diffuseScalingAuto               = emission.diffuse_auto_scaling_factor();
@@ -42,12 +43,13 @@ void RunSummary::add_spatial_pattern_source(const SpatialPatternSource& source,
     _spatialPatterns.push_back(info);
 }
 
-void RunSummary::add_spatial_pattern_source_without_data(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, const EmissionInventoryEntry& emission)
+void RunSummary::add_spatial_pattern_source_without_data(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, double massBalanceError, const EmissionInventoryEntry& emission)
 {
     SpatialPatternSummaryInfo info;
     info.source                           = source;
     info.scaledDiffuseEmissions           = scaledDiffuseEmissions;
     info.scaledDiffuseEmissionsWithinGrid = scaledDiffuseEmissionsWithinGrid;
+    info.massBalanceError                 = massBalanceError;
     info.scaledPointEmissions             = emission.scaled_point_emissions_sum();
     info.diffuseScalingUser               = emission.diffuse_user_scaling_factor();
     info.diffuseScalingAuto               = emission.diffuse_auto_scaling_factor();
@@ -60,16 +62,25 @@ void RunSummary::add_spatial_pattern_source_without_data(const SpatialPatternSou
 
 void RunSummary::add_point_source(const fs::path& pointSource)
 {
+    std::scoped_lock lock(_mutex);
     _pointSources.insert(pointSource);
 }
 
 void RunSummary::add_totals_source(const fs::path& totalsSource)
 {
+    std::scoped_lock lock(_mutex);
     _totalsSources.insert(totalsSource);
 }
 
+void RunSummary::add_raster_write_error(const fs::path& rasterPath, std::string_view error)
+{
+    std::scoped_lock lock(_mutex);
+    _rasterWriteErrors.emplace_back(rasterPath, error);
+}
+
 void RunSummary::add_gnfr_correction(const EmissionIdentifier& id, std::optional<double> validatedGnfrTotal, double summedGnfrTotal, double correction)
 {
+    std::scoped_lock lock(_mutex);
     _gnfrCorrections.push_back({id, validatedGnfrTotal, summedGnfrTotal, correction});
 }
 
@@ -81,6 +92,8 @@ void RunSummary::add_gnfr_correction(const EmissionIdentifier& id, double valida
     correction.correctedGnfrTotal = correctedGnfrTotal;
     correction.nfrTotal           = nfrTotal;
     correction.olderNfrTotal      = olderNfrTotal;
+
+    std::scoped_lock lock(_mutex);
     _validatedGnfrCorrections.push_back(correction);
 }
 
@@ -109,7 +122,7 @@ static std::string spatial_pattern_source_type_to_string(SpatialPatternSource::T
 
 void RunSummary::sources_to_spreadsheet(lxw_workbook* wb, const std::string& tabName, std::span<const SpatialPatternSummaryInfo> sources, std::span<const SpatialPatternSummaryInfo> sourcesWithoutData) const
 {
-    const std::array<ColumnInfo, 18> headers = {
+    const std::array<ColumnInfo, 19> headers = {
         ColumnInfo{"Country", 15.0},
         ColumnInfo{"Sector", 15.0},
         ColumnInfo{"GNFR", 15.0},
@@ -128,6 +141,7 @@ void RunSummary::sources_to_spreadsheet(lxw_workbook* wb, const std::string& tab
         ColumnInfo{"Diffuse emissions", 17.0},
         ColumnInfo{"Emissions within grid", 17.0},
         ColumnInfo{"Point Emissions", 17.0},
+        ColumnInfo{"Mass balance error", 17.0},
     };
 
     auto* ws = workbook_add_worksheet(wb, tabName.c_str());
@@ -183,6 +197,7 @@ void RunSummary::sources_to_spreadsheet(lxw_workbook* wb, const std::string& tab
         worksheet_write_number(ws, row, index++, info.scaledDiffuseEmissions, formatNumber);
         worksheet_write_number(ws, row, index++, info.scaledDiffuseEmissionsWithinGrid, formatNumber);
         worksheet_write_number(ws, row, index++, info.scaledPointEmissions, formatNumber);
+        worksheet_write_number(ws, row, index++, info.massBalanceError, formatNumber);
     };
 
     for (const auto& info : sources) {
@@ -357,6 +372,41 @@ void RunSummary::emission_sources_to_spreadsheet(lxw_workbook* wb, const std::st
     worksheet_autofilter(ws, 0, 0, row, truncate<lxw_col_t>(headers.size() - 1));
 }
 
+void RunSummary::raster_write_errors_to_spreadsheet(lxw_workbook* wb, const std::string& tabName) const
+{
+    if (_rasterWriteErrors.empty()) {
+        return;
+    }
+
+    const std::array<ColumnInfo, 2> headers = {
+        ColumnInfo{"Path", 100.0},
+        ColumnInfo{"Error", 100.0},
+    };
+
+    auto* ws = workbook_add_worksheet(wb, tabName.c_str());
+    if (!ws) {
+        throw RuntimeError("Failed to add sheet to excel document");
+    }
+
+    auto* headerFormat = workbook_add_format(wb);
+    format_set_bold(headerFormat);
+    format_set_bg_color(headerFormat, 0xD5EBFF);
+
+    for (int i = 0; i < truncate<int>(headers.size()); ++i) {
+        worksheet_set_column(ws, i, i, headers.at(i).width, nullptr);
+        worksheet_write_string(ws, 0, i, headers.at(i).header, headerFormat);
+    }
+
+    int row = 1;
+    for (const auto& [path, error] : _rasterWriteErrors) {
+        worksheet_write_string(ws, row, 0, str::from_u8(path.u8string()).c_str(), nullptr);
+        worksheet_write_string(ws, row, 1, error.c_str(), nullptr);
+        ++row;
+    }
+
+    worksheet_autofilter(ws, 0, 0, row, truncate<lxw_col_t>(headers.size() - 1));
+}
+
 void RunSummary::write_summary(const fs::path& outputDir) const
 {
     write_summary_spreadsheet(outputDir / "summary.xlsx");
@@ -367,6 +417,26 @@ const std::set<fs::path>& RunSummary::used_point_sources() const noexcept
     return _pointSources;
 }
 
+const std::set<fs::path>& RunSummary::used_totals_sources() const noexcept
+{
+    return _totalsSources;
+}
+
+std::span<const std::pair<fs::path, std::string>> RunSummary::raster_write_errors() const noexcept
+{
+    return _rasterWriteErrors;
+}
+
+std::span<const RunSummary::GnfrCorrection> RunSummary::gnfr_corrections() const noexcept
+{
+    return _gnfrCorrections;
+}
+
+std::span<const RunSummary::ValidatedGnfrCorrection> RunSummary::validated_gnfr_corrections() const noexcept
+{
+    return _validatedGnfrCorrections;
+}
+
 void RunSummary::write_summary_spreadsheet(const fs::path& path) const
 {
     std::error_code ec;
@@ -379,6 +449,7 @@ void RunSummary::write_summary_spreadsheet(const fs::path& path) const
     gnfr_corrections_to_spreadsheet(wb, "NFR emission correction", _gnfrCorrections);
     sources_to_spreadsheet(wb, "emission processing", _spatialPatterns, _spatialPatternsWithoutData);
     validation_results_to_spreadsheet(wb, "result validation", _validationResults);
+    raster_write_errors_to_spreadsheet(wb, "raster write errors");
 }
 
 void RunSummary::validation_results_to_spreadsheet(lxw_workbook* wb, const std::string& tabName, std::span<const EmissionValidation::SummaryEntry> validationResults) const
@@ -8,6 +8,9 @@
 
 #include <mutex>
 #include <set>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -20,24 +23,6 @@ class EmissionInventoryEntry;
 class RunSummary
 {
 public:
-    RunSummary() = default;
-    RunSummary(const RunConfiguration& cfg);
-
-    void add_spatial_pattern_source(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, const EmissionInventoryEntry& emission);
-    void add_spatial_pattern_source_without_data(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, const EmissionInventoryEntry& emission);
-    void add_point_source(const fs::path& pointSource);
-    void add_totals_source(const fs::path& totalsSource);
-
-    void add_gnfr_correction(const EmissionIdentifier& id, std::optional<double> validatedGnfrTotal, double summedGnfrTotal, double correction);
-    void add_gnfr_correction(const EmissionIdentifier& id, double validatedGnfrTotal, double correctedGnfrTotal, double nfrTotal, double olderNfrTotal);
-
-    void set_validation_results(std::vector<EmissionValidation::SummaryEntry> results);
-
-    void write_summary(const fs::path& outputDir) const;
-
-    const std::set<fs::path>& used_point_sources() const noexcept;
-
-private:
     struct GnfrCorrection
     {
         EmissionIdentifier id;
@@ -55,11 +40,36 @@ private:
         double olderNfrTotal      = 0.0;
     };
 
+    RunSummary() = default;
+    RunSummary(const RunConfiguration& cfg);
+
+    // The add functions can be called concurrently
+    void add_spatial_pattern_source(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, double massBalanceError, const EmissionInventoryEntry& emission);
+    void add_spatial_pattern_source_without_data(const SpatialPatternSource& source, double scaledDiffuseEmissions, double scaledDiffuseEmissionsWithinGrid, double massBalanceError, const EmissionInventoryEntry& emission);
+    void add_point_source(const fs::path& pointSource);
+    void add_totals_source(const fs::path& totalsSource);
+    void add_raster_write_error(const fs::path& rasterPath, std::string_view error);
+
+    void add_gnfr_correction(const EmissionIdentifier& id, std::optional<double> validatedGnfrTotal, double summedGnfrTotal, double correction);
+    void add_gnfr_correction(const EmissionIdentifier& id, double validatedGnfrTotal, double correctedGnfrTotal, double nfrTotal, double olderNfrTotal);
+
+    void set_validation_results(std::vector<EmissionValidation::SummaryEntry> results);
+
+    void write_summary(const fs::path& outputDir) const;
+
+    const std::set<fs::path>& used_point_sources() const noexcept;
+    const std::set<fs::path>& used_totals_sources() const noexcept;
+    std::span<const GnfrCorrection> gnfr_corrections() const noexcept;
+    std::span<const ValidatedGnfrCorrection> validated_gnfr_corrections() const noexcept;
+    std::span<const std::pair<fs::path, std::string>> raster_write_errors() const noexcept;
+
+private:
     struct SpatialPatternSummaryInfo
     {
         SpatialPatternSource source;
         double scaledDiffuseEmissions           = 0.0;
         double scaledDiffuseEmissionsWithinGrid = 0.0;
+        double massBalanceError                 = 0.0; // difference between the spread emissions and the diffuse emissions
         double scaledPointEmissions             = 0.0;
         double diffuseScalingUser               = 1.0;
         double diffuseScalingAuto               = 1.0;
@@ -71,6 +81,7 @@ private:
     void validated_gnfr_corrections_to_spreadsheet(lxw_workbook* wb, const std::string& tabName, std::span<const ValidatedGnfrCorrection> corrections) const;
     void validation_results_to_spreadsheet(lxw_workbook* wb, const std::string& tabName, std::span<const EmissionValidation::SummaryEntry> validationResults) const;
     void emission_sources_to_spreadsheet(lxw_workbook* wb, const std::string& tabName) const;
+    void raster_write_errors_to_spreadsheet(lxw_workbook* wb, const std::string& tabName) const;
     void sources_to_spreadsheet(lxw_workbook* wb, const std::string& tabName, std::span<const SpatialPatternSummaryInfo> sources, std::span<const SpatialPatternSummaryInfo> sourcesWithoutData) const;
     void write_summary_spreadsheet(const fs::path& path) const;
 
@@ -80,6 +91,7 @@ private:
     std::vector<SpatialPatternSummaryInfo> _spatialPatternsWithoutData;
     std::set<fs::path> _pointSources;
     std::set<fs::path> _totalsSources;
+    std::vector<std::pair<fs::path, std::string>> _rasterWriteErrors;
     std::vector<GnfrCorrection> _gnfrCorrections;
     std::vector<ValidatedGnfrCorrection> _validatedGnfrCorrections;
     std::vector<EmissionValidation::SummaryEntry> _validationResults;
@@ -4,32 +4,89 @@
 #include "infra/algo.h"
 #include "infra/enumutils.h"
 #include "infra/exception.h"
+#include "infra/hash.h"
+#include "internedstore.h"
 
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <string>
 
 namespace emap {
 
 using namespace inf;
 using namespace std::string_view_literals;
 
+// Shared by the gnfr and nfr sectors, the nfr sectors use their name as code
+struct SectorInfo
+{
+    std::string code;
+    std::string name;
+    std::string description;
+
+    bool operator==(const SectorInfo& other) const noexcept = default;
+};
+
+struct SectorInfoHash
+{
+    size_t operator()(const SectorInfo& info) const noexcept
+    {
+        size_t seed = 0;
+        inf::hash_combine(seed, info.code, info.name, info.description);
+        return seed;
+    }
+};
+
+static InternedStore<SectorInfo, SectorInfoHash>& sector_info_store()
+{
+    // Function local so the store is available for the sectors constructed during static initialization
+    static InternedStore<SectorInfo, SectorInfoHash> store;
+    return store;
+}
+
 GnfrSector::GnfrSector(std::string_view name, GnfrId id, std::string_view code, std::string_view description, EmissionDestination destination)
 : _id(id)
 , _destination(destination)
-, _code(code)
-, _name(name)
-, _description(description)
+, _info(sector_info_store().intern(SectorInfo{std::string(code), std::string(name), std::string(description)}))
 {
 }
 
+std::string_view GnfrSector::code() const noexcept
+{
+    return sector_info_store()[_info].code;
+}
+
+std::string_view GnfrSector::name() const noexcept
+{
+    return sector_info_store()[_info].name;
+}
+
+std::string_view GnfrSector::description() const noexcept
+{
+    return sector_info_store()[_info].description;
+}
+
 NfrSector::NfrSector(std::string_view name, NfrId id, GnfrSector gnfr, std::string_view description, EmissionDestination destination)
 : _id(id)
 , _destination(destination)
 , _gnfr(gnfr)
-, _name(name)
-, _description(description)
+, _info(sector_info_store().intern(SectorInfo{std::string(name), std::string(name), std::string(description)}))
+{
+}
+
+std::string_view NfrSector::name() const noexcept
+{
+    return sector_info_store()[_info].name;
+}
+
+std::string_view NfrSector::code() const noexcept
+{
+    return sector_info_store()[_info].code;
+}
+
+std::string_view NfrSector::description() const noexcept
 {
+    return sector_info_store()[_info].description;
 }
 
 EmissionSector::EmissionSector(GnfrSector sector)
@@ -13,19 +13,26 @@ using namespace inf;
 using namespace std::string_view_literals;
 
 template <typename SectorInfo>
-static auto find_sector_with_name(std::string_view name, const SectorInfo& sectors)
+static StringMap<size_t> create_index(const std::vector<SectorInfo>& sectors, std::string_view (SectorInfo::*property)() const noexcept)
 {
-    return std::find_if(sectors.begin(), sectors.end(), [name](const auto& sector) {
-        return sector.name() == name;
-    });
+    StringMap<size_t> index;
+    index.reserve(sectors.size());
+    for (size_t i = 0; i < sectors.size(); ++i) {
+        // the first sector wins when the property is not unique
+        index.try_emplace(std::string((sectors[i].*property)()), i);
+    }
+
+    return index;
 }
 
 template <typename SectorInfo>
-static auto find_sector_with_code(std::string_view code, const SectorInfo& sectors)
+static const SectorInfo* find_sector(std::string_view str, const StringMap<size_t>& index, const std::vector<SectorInfo>& sectors) noexcept
 {
-    return std::find_if(sectors.begin(), sectors.end(), [code](const auto& sector) {
-        return sector.code() == code;
-    });
+    if (auto iter = index.find(str); iter != index.end()) {
+        return &sectors[iter->second];
+    }
+
+    return nullptr;
 }
 
 SectorInventory::SectorInventory(std::vector<GnfrSector> gnfrSectors,
@@ -40,7 +47,16 @@ SectorInventory::SectorInventory(std::vector<GnfrSector> gnfrSectors,
 , _nfrConversions(std::move(nfrSectorConversions))
 , _ignoredGnfrSectors(std::move(ignoredGnfrSectors))
 , _ignoredNfrSectors(std::move(ignoredNfrSectors))
+, _gnfrCodeIndex(create_index(_gnfrSectors, &GnfrSector::code))
+, _nfrCodeIndex(create_index(_nfrSectors, &NfrSector::code))
+, _nfrNameIndex(create_index(_nfrSectors, &NfrSector::name))
 {
+    _nfrIdIndex.reserve(_nfrSectors.size());
+    _nfrIgnoreRows.reserve(_nfrSectors.size());
+    for (size_t i = 0; i < _nfrSectors.size(); ++i) {
+        _nfrIdIndex.try_emplace(_nfrSectors[i].id(), i);
+        _nfrIgnoreRows.push_back(_ignoredNfrSectors.row(_nfrSectors[i].code()));
+    }
 }
 
 void SectorInventory::set_output_mapping(std::unordered_map<NfrId, std::string> mapping)
@@ -132,8 +148,8 @@ std::optional<GnfrSector> SectorInventory::try_gnfr_sector_from_string(std::stri
         gnfrCode = str; // not all valid names have to be present in the conversion table
     }
 
-    if (auto iter = find_sector_with_code(gnfrCode, _gnfrSectors); iter != _gnfrSectors.end()) {
-        return *iter;
+    if (const auto* sector = find_gnfr_sector_with_code(gnfrCode)) {
+        return *sector;
     }
 
     return {};
@@ -146,8 +162,8 @@ std::optional<NfrSector> SectorInventory::try_nfr_sector_from_string(std::string
         nfrCode = str; // not all valid names have to be present in the conversion table
     }
 
-    if (auto iter = find_sector_with_name(nfrCode, _nfrSectors); iter != _nfrSectors.end()) {
-        return *iter;
+    if (const auto* sector = find_nfr_sector_with_name(nfrCode)) {
+        return *sector;
     }
 
     return {};
@@ -157,8 +173,8 @@ std::optional<std::pair<GnfrSector, int32_t>> SectorInventory::try_gnfr_sector_w
 {
     auto [gnfrCode, priority] = _gnfrConversions.lookup_with_priority(str);
     if (!gnfrCode.empty()) {
-        if (auto iter = find_sector_with_code(gnfrCode, _gnfrSectors); iter != _gnfrSectors.end()) {
-            return std::make_pair(*iter, priority);
+        if (const auto* sector = find_gnfr_sector_with_code(gnfrCode)) {
+            return std::make_pair(*sector, priority);
         }
     }
 
@@ -169,8 +185,8 @@ std::optional<std::pair<NfrSector, int32_t>> SectorInventory::try_nfr_sector_wit
 {
     auto [nfrCode, priority] = _nfrConversions.lookup_with_priority(str);
     if (!nfrCode.empty()) {
-        if (auto iter = find_sector_with_code(nfrCode, _nfrSectors); iter != _nfrSectors.end()) {
-            return std::make_pair(*iter, priority);
+        if (const auto* sector = find_nfr_sector_with_code(nfrCode)) {
+            return std::make_pair(*sector, priority);
         }
     }
 
@@ -188,8 +204,8 @@ GnfrSector SectorInventory::gnfr_sector_from_string(std::string_view str) const
 
 GnfrSector SectorInventory::gnfr_sector_from_code_string(std::string_view str) const
 {
-    if (auto iter = find_sector_with_code(str, _gnfrSectors); iter != _gnfrSectors.end()) {
-        return *iter;
+    if (const auto* sector = find_gnfr_sector_with_code(str)) {
+        return *sector;
     }
 
     throw RuntimeError("Invalid gnfr sector code: '{}'", str);
@@ -213,6 +229,21 @@ std::pair<GnfrSector, int32_t> SectorInventory::gnfr_sector_with_priority_from_s
     throw RuntimeError("Invalid gnfr sector name: '{}'", str);
 }
 
+const GnfrSector* SectorInventory::find_gnfr_sector_with_code(std::string_view code) const noexcept
+{
+    return find_sector(code, _gnfrCodeIndex, _gnfrSectors);
+}
+
+const NfrSector* SectorInventory::find_nfr_sector_with_code(std::string_view code) const noexcept
+{
+    return find_sector(code, _nfrCodeIndex, _nfrSectors);
+}
+
+const NfrSector* SectorInventory::find_nfr_sector_with_name(std::string_view name) const noexcept
+{
+    return find_sector(name, _nfrNameIndex, _nfrSectors);
+}
+
 std::pair<NfrSector, int32_t> SectorInventory::nfr_sector_with_priority_from_string(std::string_view str) const
 {
     if (auto sector = try_nfr_sector_with_priority_from_string(str); sector.has_value()) {
@@ -241,16 +272,23 @@ size_t SectorInventory::nfr_sector_count() const noexcept
 
 bool SectorInventory::is_ignored_nfr_sector(std::string_view str, const Country& country) const noexcept
 {
-    return std::any_of(_ignoredNfrSectors.begin(), _ignoredNfrSectors.end(), [=, countryId = country.id()](const IgnoredName& ign) {
-        return ign.is_ignored_for_country(str, countryId);
-    });
+    return _ignoredNfrSectors.is_ignored_for_country(str, country.id());
+}
+
+bool SectorInventory::is_ignored_nfr_sector(const NfrSector& sector, const Country& country) const noexcept
+{
+    if (auto iter = _nfrIdIndex.find(sector.id()); iter != _nfrIdIndex.end() && _nfrSectors[iter->second].code() == sector.code()) {
+        const auto& row = _nfrIgnoreRows[iter->second];
+        return row.has_value() && _ignoredNfrSectors.is_ignored_for_country(*row, country.id());
+    }
+
+    // not a sector of this inventory
+    return is_ignored_nfr_sector(sector.code(), country);
 }
 
 bool SectorInventory::is_ignored_gnfr_sector(std::string_view str, const Country& country) const noexcept
 {
-    return std::any_of(_ignoredGnfrSectors.begin(), _ignoredGnfrSectors.end(), [=, countryId = country.id()](const IgnoredName& ign) {
-        return ign.is_ignored_for_country(str, countryId);
-    });
+    return _ignoredGnfrSectors.is_ignored_for_country(str, country.id());
 }
 
 bool SectorInventory::is_ignored_sector(EmissionSector::Type type, std::string_view str, const Country& country) const noexcept
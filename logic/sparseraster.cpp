@@ -0,0 +1,274 @@
+#include "emap/sparseraster.h"
+
+#include "infra/exception.h"
+#include "infra/math.h"
+#include "rasterkernels.h"
+
+#include <gdx/denseraster.h>
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace emap {
+
+using namespace inf;
+
+SparseRaster::SparseRaster(const GeoMetadata& meta, Precision precision)
+: _meta(copy_metadata_replace_nodata(meta, math::nan<double>()))
+, _precision(precision)
+{
+}
+
+SparseRaster::SparseRaster(const gdx::DenseRaster<double>& raster)
+: SparseRaster(raster.metadata(), Precision::Double)
+{
+    add_dense_cells(raster);
+}
+
+SparseRaster::SparseRaster(const gdx::DenseRaster<float>& raster)
+: SparseRaster(raster.metadata(), Precision::Single)
+{
+    add_dense_cells(raster);
+}
+
+template <typename T>
+void SparseRaster::add_dense_cells(const gdx::DenseRaster<T>& raster)
+{
+    for (int32_t r = 0; r < _meta.rows; ++r) {
+        for (int32_t c = 0; c < _meta.cols; ++c) {
+            const Cell cell(r, c);
+            if (!raster.is_nodata(cell)) {
+                push_back(cell_index(cell), raster[cell]);
+            }
+        }
+    }
+}
+
+const GeoMetadata& SparseRaster::metadata() const noexcept
+{
+    return _meta;
+}
+
+SparseRaster::Precision SparseRaster::precision() const noexcept
+{
+    return _precision;
+}
+
+void SparseRaster::set_precision(Precision precision)
+{
+    if (precision == _precision) {
+        return;
+    }
+
+    if (precision == Precision::Single) {
+        _singleValues.assign(_values.begin(), _values.end());
+        _values = {};
+    } else {
+        _values.assign(_singleValues.begin(), _singleValues.end());
+        _singleValues = {};
+    }
+
+    _precision = precision;
+}
+
+bool SparseRaster::empty() const noexcept
+{
+    return _meta.rows == 0 || _meta.cols == 0;
+}
+
+bool SparseRaster::contains_only_nodata() const noexcept
+{
+    return _indexes.empty();
+}
+
+size_t SparseRaster::size() const noexcept
+{
+    return _indexes.size();
+}
+
+Cell SparseRaster::cell(size_t index) const noexcept
+{
+    return Cell(_indexes[index] / _meta.cols, _indexes[index] % _meta.cols);
+}
+
+double SparseRaster::value(size_t index) const noexcept
+{
+    return _precision == Precision::Single ? _singleValues[index] : _values[index];
+}
+
+void SparseRaster::add_to_cells(std::vector<std::pair<Cell, double>> cellValues)
+{
+    std::vector<std::pair<int32_t, double>> toAdd;
+    toAdd.reserve(cellValues.size());
+    for (auto& [cell, value] : cellValues) {
+        if (!_meta.is_on_map(cell)) {
+            throw RuntimeError("Cell is not on the raster extent: ({}, {})", cell.r, cell.c);
+        }
+
+        toAdd.emplace_back(cell_index(cell), value);
+    }
+
+    std::stable_sort(toAdd.begin(), toAdd.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    // Merge the sorted values into the existing cells, the values are summed in double precision
+    std::vector<std::pair<int32_t, double>> merged;
+    merged.reserve(size() + toAdd.size());
+
+    size_t i = 0;
+    for (auto& [index, value] : toAdd) {
+        while (i < size() && _indexes[i] < index) {
+            merged.emplace_back(_indexes[i], this->value(i));
+            ++i;
+        }
+
+        if (i < size() && _indexes[i] == index) {
+            merged.emplace_back(index, this->value(i) + value);
+            ++i;
+        } else if (!merged.empty() && merged.back().first == index) {
+            merged.back().second += value;
+        } else {
+            merged.emplace_back(index, value);
+        }
+    }
+
+    for (; i < size(); ++i) {
+        merged.emplace_back(_indexes[i], value(i));
+    }
+
+    resize(0);
+    for (auto& [index, value] : merged) {
+        push_back(index, value);
+    }
+}
+
+double SparseRaster::sum() const noexcept
+{
+    if (_precision == Precision::Single) {
+        return std::accumulate(_singleValues.begin(), _singleValues.end(), 0.0);
+    }
+
+    return std::accumulate(_values.begin(), _values.end(), 0.0);
+}
+
+SparseRaster& SparseRaster::operator*=(double factor) noexcept
+{
+    multiply_values(_values, factor);
+
+    for (auto& val : _singleValues) {
+        val = static_cast<float>(val * factor);
+    }
+
+    return *this;
+}
+
+SparseRaster& SparseRaster::operator/=(double divisor) noexcept
+{
+    divide_values(_values, divisor);
+
+    for (auto& val : _singleValues) {
+        val = static_cast<float>(val / divisor);
+    }
+
+    return *this;
+}
+
+SparseRaster SparseRaster::sub_raster(const GeoMetadata& extent) const
+{
+    SparseRaster result(extent, _precision);
+
+    const auto offset = offset_of(extent);
+    for (size_t i = 0; i < size(); ++i) {
+        const auto current = cell(i);
+        const Cell subCell(current.r - offset.r, current.c - offset.c);
+        if (result._meta.is_on_map(subCell)) {
+            result.push_back(result.cell_index(subCell), value(i));
+        }
+    }
+
+    return result;
+}
+
+double SparseRaster::erase_area_and_sum(const GeoMetadata& extent)
+{
+    const auto intersection = metadata_intersection(_meta, extent);
+    if (intersection.rows == 0 || intersection.cols == 0) {
+        return 0.0;
+    }
+
+    const auto offset = offset_of(intersection);
+
+    double sum  = 0.0;
+    size_t keep = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        const auto current = cell(i);
+        if (current.r >= offset.r && current.r < offset.r + intersection.rows &&
+            current.c >= offset.c && current.c < offset.c + intersection.cols) {
+            sum += value(i);
+            continue;
+        }
+
+        move_cell(i, keep++);
+    }
+
+    resize(keep);
+    return sum;
+}
+
+gdx::DenseRaster<double> SparseRaster::to_dense() const
+{
+    constexpr auto nan = math::nan<double>();
+
+    gdx::DenseRaster<double> result(_meta, nan);
+    for (size_t i = 0; i < size(); ++i) {
+        result[cell(i)] = value(i);
+    }
+
+    return result;
+}
+
+void SparseRaster::push_back(int32_t index, double value)
+{
+    _indexes.push_back(index);
+    if (_precision == Precision::Single) {
+        _singleValues.push_back(static_cast<float>(value));
+    } else {
+        _values.push_back(value);
+    }
+}
+
+void SparseRaster::resize(size_t size)
+{
+    _indexes.resize(size);
+    if (_precision == Precision::Single) {
+        _singleValues.resize(size);
+    } else {
+        _values.resize(size);
+    }
+}
+
+void SparseRaster::move_cell(size_t from, size_t to) noexcept
+{
+    _indexes[to] = _indexes[from];
+    if (_precision == Precision::Single) {
+        _singleValues[to] = _singleValues[from];
+    } else {
+        _values[to] = _values[from];
+    }
+}
+
+int32_t SparseRaster::cell_index(Cell cell) const noexcept
+{
+    assert(_meta.is_on_map(cell));
+    return cell.r * _meta.cols + cell.c;
+}
+
+Cell SparseRaster::offset_of(const GeoMetadata& extent) const noexcept
+{
+    const auto topLeft = extent.convert_cell_centre_to_xy(Cell(0, 0));
+    return _meta.convert_xy_to_cell(topLeft.x, topLeft.y);
+}
+
+}
@@ -10,11 +10,13 @@
 #include "infra/gdal.h"
 #include "infra/log.h"
 #include "infra/string.h"
+#include "xlsxreader.h"
 
 #include "gdx/algo/sum.h"
 #include "gdx/denserasterio.h"
 
 #include <deque>
+#include <oneapi/tbb/parallel_for_each.h>
 #include <tuple>
 
 namespace emap {
@@ -83,16 +85,26 @@ SpatialPatternTableCache::SpatialPatternTableCache(const RunConfiguration& cfg)
 
 const SpatialPatternData* SpatialPatternTableCache::get_data(const fs::path& path, const EmissionIdentifier& id, bool allowPollutantMismatch)
 {
-    std::scoped_lock lock(_mutex);
-    if (_patterns.count(path) == 0) {
-        auto patterns = std::make_unique<std::vector<SpatialPatternData>>(parse_spatial_pattern_flanders(path, _cfg));
-        _patterns.emplace(path, std::move(patterns));
+    CachedTable* table = nullptr;
+    {
+        std::scoped_lock lock(_mutex);
+        auto& entry = _patterns[path];
+        if (!entry) {
+            entry = std::make_unique<CachedTable>();
+        }
+        table = entry.get();
     }
 
+    // Concurrent requests for the same workbook wait for the first one to finish parsing
+    // if parsing fails, the next request will try again
+    std::call_once(table->parsed, [&]() {
+        table->patterns = parse_spatial_pattern_flanders(path, _cfg);
+    });
+
     if (allowPollutantMismatch) {
-        return find_data_for_sector(*_patterns.at(path), id.sector);
+        return find_data_for_sector(table->patterns, id.sector);
     } else {
-        return find_data_for_id(*_patterns.at(path), id);
+        return find_data_for_id(table->patterns, id);
     }
 }
 
@@ -112,93 +124,76 @@ const SpatialPatternData* SpatialPatternTableCache::find_data_for_sector(const s
 
 SpatialPatternInventory::SpatialPatternInventory(const RunConfiguration& cfg)
 : _cfg(cfg)
-, _spatialPatternCamsRegex("CAMS_emissions_REG-\\w+v\\d+.\\d+_(\\d{4})_(\\w+)_([A-Z]{1}_[^_]+|[1-6]{1}[^_]+)")
-, _spatialPatternCeipRegex("(\\w+)_([A-Z]{1}_[^_]+|[1-6]{1}[^_]+)_(\\d{4})_GRID_(\\d{4})")
-, _spatialPatternBelgium1Regex("Emissies per km2 (?:excl|incl) puntbrongegevens_(\\d{4})_([\\w,]+)")
-, _spatialPatternBelgium2Regex("Emissie per km2_met NFR_([\\w ,]+) (\\d{4})_(\\w+) (\\d{4})")
 , _flandersCache(cfg)
 {
 }
 
-std::optional<SpatialPatternInventory::SpatialPatternFile> SpatialPatternInventory::identify_spatial_pattern_cams(const fs::path& path) const
+std::optional<SpatialPatternInventory::SpatialPatternFile> SpatialPatternInventory::resolve_spatial_pattern_file(const PatternDirectory& dir, const PatternFilenameInfo& info) const
 {
-    std::smatch baseMatch;
-    const std::string filename = path.stem().string();
-
-    if (std::regex_match(filename, baseMatch, _spatialPatternCamsRegex)) {
-        try {
-            // const auto year      = date::year(str::to_int32_value(baseMatch[1].str()));
-            const auto pollutant = _cfg.pollutants().pollutant_from_string(baseMatch[2].str());
-            const auto sector    = _cfg.sectors().sector_from_string(baseMatch[3].str());
-
-            return SpatialPatternFile{
-                SpatialPatternFile::Source::Cams,
-                path,
-                pollutant,
-                sector};
-        } catch (const std::exception& e) {
-            Log::debug("Unexpected CAMS spatial pattern filename: {} ({})", e.what(), path);
+    const auto path = dir.path / file::u8path(info.filename);
+
+    try {
+        SpatialPatternFile result;
+        result.path      = path;
+        result.pollutant = _cfg.pollutants().pollutant_from_string(info.pollutant);
+
+        switch (dir.type) {
+        case PatternFileType::Cams:
+            result.source = SpatialPatternFile::Source::Cams;
+            result.sector = _cfg.sectors().sector_from_string(info.sector);
+            break;
+        case PatternFileType::Ceip:
+            result.source = SpatialPatternFile::Source::Ceip;
+            result.sector = _cfg.sectors().sector_from_string(info.sector);
+            break;
+        case PatternFileType::FlandersTable:
+            // the flanders tables contain all the sectors
+            result.source = SpatialPatternFile::Source::FlandersTable;
+            break;
         }
-    }
-
-    return {};
-}
-
-std::optional<SpatialPatternInventory::SpatialPatternFile> SpatialPatternInventory::identify_spatial_pattern_ceip(const fs::path& path) const
-{
-    std::smatch baseMatch;
-    const std::string filename = path.stem().string();
 
-    if (std::regex_match(filename, baseMatch, _spatialPatternCeipRegex)) {
-        try {
-            const auto pollutant = _cfg.pollutants().pollutant_from_string(baseMatch[1].str());
-            const auto sector    = _cfg.sectors().sector_from_string(baseMatch[2].str());
-            // const auto reportYear = date::year(str::to_int32_value(baseMatch[3].str()));
-            // const auto year = date::year(str::to_int32_value(baseMatch[4].str()));
-
-            return SpatialPatternFile{
-                SpatialPatternFile::Source::Ceip,
-                path,
-                pollutant,
-                sector};
-        } catch (const std::exception& e) {
-            Log::debug("Unexpected CEIP spatial pattern filename: {} ({})", e.what(), path);
-        }
+        return result;
+    } catch (const std::exception& e) {
+        Log::debug("Unexpected spatial pattern filename: {} ({})", e.what(), path);
     }
 
     return {};
 }
 
-std::optional<SpatialPatternInventory::SpatialPatternFile> SpatialPatternInventory::identify_spatial_pattern_flanders(const fs::path& path) const
+std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::scan_pattern_directories(std::vector<PatternDirectory>& dirs, SpatialPatternManifest& manifest) const
 {
-    std::smatch baseMatch;
-    const std::string filename = path.stem().string();
+    // Listing the directories is slow on network drives, so the year directories are listed in parallel
+    tbb::parallel_for_each(dirs, [&](PatternDirectory& dir) {
+        if (fs::is_directory(dir.path)) {
+            dir.files = manifest.list_directory(dir.path, dir.type);
+        }
+    });
 
-    if (std::regex_match(filename, baseMatch, _spatialPatternBelgium1Regex)) {
-        try {
-            const auto pollutant = _cfg.pollutants().pollutant_from_string(baseMatch[2].str());
+    // The directories are ordered by year of preference
+    std::vector<SpatialPatterns> result;
+    for (auto iter = dirs.begin(); iter != dirs.end();) {
+        SpatialPatterns patternsForYear;
+        patternsForYear.year = iter->year;
 
-            return SpatialPatternFile{SpatialPatternFile::Source::FlandersTable, path, pollutant, {}};
-        } catch (const std::exception& e) {
-            Log::debug("Unexpected spatial pattern filename: {} ({})", e.what(), path);
+        for (; iter != dirs.end() && iter->year == patternsForYear.year; ++iter) {
+            for (const auto& info : iter->files) {
+                if (auto source = resolve_spatial_pattern_file(*iter, info); source.has_value()) {
+                    patternsForYear.spatialPatterns.push_back(std::move(*source));
+                }
+            }
         }
-    } else if (std::regex_match(filename, baseMatch, _spatialPatternBelgium2Regex)) {
-        try {
-            const auto pollutant = _cfg.pollutants().pollutant_from_string(baseMatch[1].str());
 
-            return SpatialPatternFile{SpatialPatternFile::Source::FlandersTable, path, pollutant, {}};
-        } catch (const std::exception& e) {
-            Log::debug("Unexpected spatial pattern filename: {} ({})", e.what(), path);
+        if (!patternsForYear.spatialPatterns.empty()) {
+            build_pattern_index(patternsForYear);
+            result.push_back(std::move(patternsForYear));
         }
     }
 
-    return {};
+    return result;
 }
 
-std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::scan_dir_rest(date::year startYear, const fs::path& spatialPatternPath) const
+std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::scan_dir_rest(date::year startYear, const fs::path& spatialPatternPath, SpatialPatternManifest& manifest) const
 {
-    std::vector<SpatialPatterns> result;
-
     const auto camsPath = spatialPatternPath / "CAMS";
     const auto ceipPath = spatialPatternPath / "CEIP";
 
@@ -207,79 +202,28 @@ std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::s
     auto availableYears = scan_available_years(camsPath);
     availableYears.insert(ceipYears.begin(), ceipYears.end());
 
-    auto yearsSequence = create_years_sequence(startYear, availableYears);
-    while (!yearsSequence.empty()) {
-        SpatialPatterns patternsForYear;
-        patternsForYear.year = yearsSequence.front();
-
-        {
-            // Scan cams files
-            const auto currentPath = camsPath / std::to_string(static_cast<int>(yearsSequence.front()));
-            if (fs::is_directory(currentPath)) {
-                for (const auto& dirEntry : std::filesystem::directory_iterator(currentPath)) {
-                    if (dirEntry.is_regular_file() && dirEntry.path().extension() == ".tif") {
-                        if (const auto source = identify_spatial_pattern_cams(dirEntry.path()); source.has_value()) {
-                            patternsForYear.spatialPatterns.push_back(*source);
-                        }
-                    }
-                }
-            }
-        }
-
-        {
-            // Scan ceip files
-            const auto currentPath = ceipPath / std::to_string(static_cast<int>(yearsSequence.front()));
-            if (fs::is_directory(currentPath)) {
-                for (const auto& dirEntry : std::filesystem::directory_iterator(currentPath)) {
-                    if (dirEntry.is_regular_file() && dirEntry.path().extension() == ".txt") {
-                        if (const auto source = identify_spatial_pattern_ceip(dirEntry.path()); source.has_value()) {
-                            patternsForYear.spatialPatterns.push_back(*source);
-                        }
-                    }
-                }
-            }
-        }
-
-        if (!patternsForYear.spatialPatterns.empty()) {
-            result.push_back(std::move(patternsForYear));
-        }
-
-        yearsSequence.pop_front();
+    std::vector<PatternDirectory> dirs;
+    for (auto year : create_years_sequence(startYear, availableYears)) {
+        const auto yearDir = std::to_string(static_cast<int>(year));
+        dirs.push_back(PatternDirectory{year, camsPath / yearDir, PatternFileType::Cams, {}});
+        dirs.push_back(PatternDirectory{year, ceipPath / yearDir, PatternFileType::Ceip, {}});
     }
 
-    return result;
+    return scan_pattern_directories(dirs, manifest);
 }
 
-std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::scan_dir_flanders(date::year startYear, const fs::path& spatialPatternPath) const
+std::vector<SpatialPatternInventory::SpatialPatterns> SpatialPatternInventory::scan_dir_flanders(date::year startYear, const fs::path& spatialPatternPath, SpatialPatternManifest& manifest) const
 {
-    std::vector<SpatialPatterns> result;
-
-    if (fs::exists(spatialPatternPath)) {
-        auto yearsSequence = create_years_sequence(startYear, scan_available_years(spatialPatternPath));
-        while (!yearsSequence.empty()) {
-            SpatialPatterns patternsForYear;
-            patternsForYear.year = yearsSequence.front();
-
-            const auto currentPath = spatialPatternPath / std::to_string(static_cast<int>(yearsSequence.front()));
-            if (fs::is_directory(currentPath)) {
-                for (const auto& dirEntry : std::filesystem::directory_iterator(currentPath)) {
-                    if (dirEntry.is_regular_file() && dirEntry.path().extension() == ".xlsx") {
-                        if (const auto source = identify_spatial_pattern_flanders(dirEntry.path()); source.has_value()) {
-                            patternsForYear.spatialPatterns.push_back(*source);
-                        }
-                    }
-                }
-            }
-
-            if (!patternsForYear.spatialPatterns.empty()) {
-                result.push_back(std::move(patternsForYear));
-            }
+    if (!fs::exists(spatialPatternPath)) {
+        return {};
+    }
 
-            yearsSequence.pop_front();
-        }
+    std::vector<PatternDirectory> dirs;
+    for (auto year : create_years_sequence(startYear, scan_available_years(spatialPatternPath))) {
+        dirs.push_back(PatternDirectory{year, spatialPatternPath / std::to_string(static_cast<int>(year)), PatternFileType::FlandersTable, {}});
     }
 
-    return result;
+    return scan_pattern_directories(dirs, manifest);
 }
 
 static fs::path reporing_dir(date::year reportYear)
@@ -287,7 +231,7 @@ static fs::path reporing_dir(date::year reportYear)
     return file::u8path(fmt::format("reporting_{}", static_cast<int>(reportYear)));
 }
 
-void SpatialPatternInventory::scan_dir(date::year reportingYear, date::year startYear, const fs::path& spatialPatternPath)
+void SpatialPatternInventory::scan_dir(date::year reportingYear, date::year startYear, const fs::path& spatialPatternPath, const fs::path& manifestPath)
 {
     std::vector<SpatialPatternSource> result;
 
@@ -296,9 +240,62 @@ void SpatialPatternInventory::scan_dir(date::year reportingYear, date::year star
     inf::remove_from_container(_exceptions, [=](const SpatialPatternException& ex) {
         return !ex.yearRange.contains(startYear);
     });
+    build_exception_index();
+
+    SpatialPatternManifest manifest = manifestPath.empty() ? SpatialPatternManifest() : SpatialPatternManifest(manifestPath);
+
+    _spatialPatternsRest = scan_dir_rest(startYear, spatialPatternPath / "rest" / reporing_dir(reportingYear), manifest);
+    _countrySpecificSpatialPatterns.emplace(country::BEF, scan_dir_flanders(startYear, spatialPatternPath / "bef" / reporing_dir(reportingYear), manifest));
+
+    manifest.save();
+
+    std::scoped_lock lock(_candidatesMutex);
+    _patternCandidates.clear();
+}
+
+void SpatialPatternInventory::build_pattern_index(SpatialPatterns& patterns)
+{
+    patterns.sectorIndex.clear();
+    patterns.pollutantIndex.clear();
+
+    for (size_t i = 0; i < patterns.spatialPatterns.size(); ++i) {
+        const auto& spf = patterns.spatialPatterns[i];
 
-    _spatialPatternsRest = scan_dir_rest(startYear, spatialPatternPath / "rest" / reporing_dir(reportingYear));
-    _countrySpecificSpatialPatterns.emplace(country::BEF, scan_dir_flanders(startYear, spatialPatternPath / "bef" / reporing_dir(reportingYear)));
+        // emplace does not overwrite existing entries, so the first file in the directory listing is used
+        if (spf.sector.is_valid()) {
+            patterns.sectorIndex.emplace(PatternKey{spf.pollutant, spf.sector}, i);
+        } else {
+            patterns.pollutantIndex.emplace(spf.pollutant, i);
+        }
+    }
+}
+
+void SpatialPatternInventory::build_exception_index()
+{
+    _pollutantExceptionIndex.clear();
+    _sectorExceptionIndex.clear();
+
+    for (size_t i = 0; i < _exceptions.size(); ++i) {
+        const auto& ex = _exceptions[i];
+        auto& index    = ex.viaSector.has_value() ? _sectorExceptionIndex : _pollutantExceptionIndex;
+        index.emplace(ex.emissionId.key(), i);
+    }
+}
+
+SpatialPatternSource SpatialPatternInventory::source_from_pattern_file(const SpatialPatternFile& spf, const EmissionIdentifier& emissionId, const EmissionIdentifier& usedEmissionId, date::year year, bool isException)
+{
+    switch (spf.source) {
+    case SpatialPatternFile::Source::Cams:
+        return SpatialPatternSource::create_from_cams(spf.path, emissionId, usedEmissionId, year, isException);
+    case SpatialPatternFile::Source::Ceip:
+        return SpatialPatternSource::create_from_ceip(spf.path, emissionId, usedEmissionId, year, isException);
+    case SpatialPatternFile::Source::FlandersTable:
+        return SpatialPatternSource::create_from_flanders(spf.path, emissionId, usedEmissionId, year, isException);
+    default:
+        break;
+    }
+
+    throw std::logic_error("Unhandled spatial pattern source type");
 }
 
 std::optional<SpatialPatternSource> SpatialPatternInventory::search_spatial_pattern_within_year(const Country& country,
@@ -306,96 +303,61 @@ std::optional<SpatialPatternSource> SpatialPatternInventory::search_spatial_patt
                                                                                                 const Pollutant& polToReport,
                                                                                                 const EmissionSector& sector,
                                                                                                 const EmissionSector& sectorToReport,
-                                                                                                date::year year,
-                                                                                                const std::vector<SpatialPatternFile>& patterns) const
+                                                                                                const SpatialPatterns& patterns) const
 {
     bool isException = sector != sectorToReport;
 
-    auto iter = std::find_if(patterns.begin(), patterns.end(), [&](const SpatialPatternFile& spf) {
-        bool pollutantMatch = spf.pollutant == pollutant;
-        bool sectorMatch    = spf.sector.is_valid() ? spf.sector == sector : true;
-        return pollutantMatch && sectorMatch;
-    });
+    // The first file for the pollutant that matches the sector or that contains all sectors
+    std::optional<size_t> matchIndex;
+    if (auto iter = patterns.sectorIndex.find(PatternKey{pollutant, sector}); iter != patterns.sectorIndex.end()) {
+        matchIndex = iter->second;
+    }
 
-    if (iter != patterns.end()) {
-        if (iter->source == SpatialPatternFile::Source::Cams) {
-            return SpatialPatternSource::create_from_cams(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, sector, pollutant), year, isException);
-        } else if (iter->source == SpatialPatternFile::Source::Ceip) {
-            return SpatialPatternSource::create_from_ceip(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, sector, pollutant), year, isException);
-        } else if (iter->source == SpatialPatternFile::Source::FlandersTable) {
-            return SpatialPatternSource::create_from_flanders(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, sector, pollutant), year, isException);
+    if (auto iter = patterns.pollutantIndex.find(pollutant); iter != patterns.pollutantIndex.end()) {
+        if (!matchIndex.has_value() || iter->second < *matchIndex) {
+            matchIndex = iter->second;
         }
+    }
 
-        throw std::logic_error("Unhandled spatial pattern source type");
+    if (matchIndex.has_value()) {
+        const auto& spf = patterns.spatialPatterns[*matchIndex];
+        return source_from_pattern_file(spf, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, sector, pollutant), patterns.year, isException);
     }
 
     if (sector.type() == EmissionSector::Type::Nfr) {
         // No matching spatial pattern for nfr sector
         // Check if there is one for the corresponding gnfr sector
-        EmissionSector gnfrSector(sector.gnfr_sector());
-        iter = std::find_if(patterns.begin(), patterns.end(), [&](const SpatialPatternFile& spf) {
-            return spf.pollutant == pollutant && spf.sector == gnfrSector;
-        });
-    }
-
-    if (iter != patterns.end()) {
-        if (iter->source == SpatialPatternFile::Source::Cams) {
-            return SpatialPatternSource::create_from_cams(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, iter->sector, iter->pollutant), year, isException);
-        } else if (iter->source == SpatialPatternFile::Source::Ceip) {
-            return SpatialPatternSource::create_from_ceip(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, iter->sector, iter->pollutant), year, isException);
-        } else if (iter->source == SpatialPatternFile::Source::FlandersTable) {
-            return SpatialPatternSource::create_from_flanders(iter->path, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, iter->sector, iter->pollutant), year, isException);
+        if (auto iter = patterns.sectorIndex.find(PatternKey{pollutant, EmissionSector(sector.gnfr_sector())}); iter != patterns.sectorIndex.end()) {
+            const auto& spf = patterns.spatialPatterns[iter->second];
+            return source_from_pattern_file(spf, EmissionIdentifier(country, sectorToReport, polToReport), EmissionIdentifier(country, spf.sector, spf.pollutant), patterns.year, isException);
         }
-
-        throw std::logic_error("Unhandled spatial pattern source type");
     }
 
     return {};
 }
 
-std::optional<SpatialPatternInventory::SpatialPatternException> SpatialPatternInventory::find_pollutant_exception(const EmissionIdentifier& emissionId) const noexcept
+const SpatialPatternInventory::SpatialPatternException* SpatialPatternInventory::find_pollutant_exception(const EmissionIdentifier& emissionId) const noexcept
 {
-    auto exception = find_in_container_optional(_exceptions, [&emissionId](const SpatialPatternException& ex) {
-        return ex.emissionId == emissionId && (!ex.viaSector.has_value());
-    });
+    if (auto iter = _pollutantExceptionIndex.find(emissionId.key()); iter != _pollutantExceptionIndex.end()) {
+        return &_exceptions[iter->second];
+    }
 
-    if (!exception.has_value() && emissionId.sector.type() == EmissionSector::Type::Nfr) {
+    if (emissionId.sector.type() == EmissionSector::Type::Nfr) {
         // See if there is an entry on gnfr level
-        exception = find_pollutant_exception(convert_emission_id_to_gnfr_level(emissionId));
+        return find_pollutant_exception(convert_emission_id_to_gnfr_level(emissionId));
     }
 
-    return exception;
+    return nullptr;
 }
 
-std::optional<SpatialPatternInventory::SpatialPatternException> SpatialPatternInventory::find_sector_exception(const EmissionIdentifier& emissionId) const noexcept
+const SpatialPatternInventory::SpatialPatternException* SpatialPatternInventory::find_sector_exception(const EmissionIdentifier& emissionId) const noexcept
 {
     // Find the exception that has a "viaNFR" of "viaGNFR" configured
-    return find_in_container_optional(_exceptions, [&emissionId](const SpatialPatternException& ex) {
-        return ex.emissionId == emissionId && ex.viaSector.has_value();
-    });
-}
-
-std::optional<SpatialPattern> SpatialPatternInventory::find_spatial_pattern_exception(const EmissionIdentifier& emissionId,
-                                                                                      const CountryCellCoverage& countryCoverage,
-                                                                                      const Pollutant& pollutantToReport,
-                                                                                      const EmissionSector& sectorToReport,
-                                                                                      bool checkContents,
-                                                                                      bool& patternAvailableButWithoutData) const
-{
-    std::optional<SpatialPattern> result;
-
-    if (auto exception = find_pollutant_exception(emissionId); exception.has_value()) {
-        assert(!exception->viaSector.has_value());
-        result         = SpatialPattern(source_from_exception(*exception, pollutantToReport, sectorToReport, _cfg.year()));
-        result->raster = get_pattern_raster(result->source, countryCoverage, checkContents);
-
-        if (result->raster.empty()) {
-            patternAvailableButWithoutData = true;
-            result.reset();
-        }
+    if (auto iter = _sectorExceptionIndex.find(emissionId.key()); iter != _sectorExceptionIndex.end()) {
+        return &_exceptions[iter->second];
     }
 
-    return result;
+    return nullptr;
 }
 
 SpatialPatternSource SpatialPatternInventory::source_from_exception(const SpatialPatternException& ex, const Pollutant& pollutantToReport, const EmissionSector& sectorToReport, date::year year)
@@ -416,9 +378,16 @@ SpatialPatternSource SpatialPatternInventory::source_from_exception(const Spatia
     throw RuntimeError("Invalid spatial pattern exception type");
 }
 
-static gdx::DenseRaster<double> extract_country_from_pattern(const gdx::DenseRaster<double>& spatialPattern, const CountryCellCoverage& countryCoverage, bool checkContents)
+static SparseRaster::Precision pattern_precision(const RunConfiguration& cfg) noexcept
+{
+    return cfg.single_precision_spatial_patterns() ? SparseRaster::Precision::Single : SparseRaster::Precision::Double;
+}
+
+template <typename T>
+static SparseRaster extract_country_from_pattern(const gdx::DenseRaster<T>& spatialPattern, const CountryCellCoverage& countryCoverage, bool checkContents, SparseRaster::Precision precision)
 {
-    auto raster = extract_country_from_raster(spatialPattern, countryCoverage);
+    auto raster = extract_country_cells_from_raster(spatialPattern, countryCoverage);
+    raster.set_precision(precision);
 
     /*bool containsOnlyBorderCells = !std::any_of(countryCoverage.cells.begin(), countryCoverage.cells.end(), [](const CountryCellCoverage::CellInfo& cell) {
         return cell.coverage == 1.0;
@@ -440,9 +409,10 @@ static gdx::DenseRaster<double> extract_country_from_pattern(const gdx::DenseRas
             });
         }*/
 
-        containsData = std::any_of(countryCoverage.cells.begin(), countryCoverage.cells.end(), [&](const CountryCellCoverage::CellInfo& cell) {
-            return raster[cell.countryGridCell] > 0.0;
-        });
+        // the raster only contains the cells of the country
+        for (size_t i = 0; i < raster.size() && !containsData; ++i) {
+            containsData = raster.value(i) > 0.0;
+        }
 
         if (containsData) {
             normalize_raster(raster);
@@ -456,14 +426,16 @@ static gdx::DenseRaster<double> extract_country_from_pattern(const gdx::DenseRas
     return raster;
 }
 
-static gdx::DenseRaster<double> read_country_from_pattern(const fs::path& spatialPatternPath, const CountryCellCoverage& countryCoverage, bool checkContents)
+static SparseRaster read_country_from_pattern(const fs::path& spatialPatternPath, const CountryCellCoverage& countryCoverage, bool checkContents, SparseRaster::Precision precision)
 {
-    auto raster = gdx::resample_raster(gdx::read_dense_raster<double>(spatialPatternPath), countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average);
+    SparseRaster raster(gdx::resample_raster(gdx::read_dense_raster<double>(spatialPatternPath), countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average));
+    raster.set_precision(precision);
 
     if (checkContents) {
-        bool containsData = std::any_of(raster.begin(), raster.end(), [](double val) {
-            return val > 0;
-        });
+        bool containsData = false;
+        for (size_t i = 0; i < raster.size() && !containsData; ++i) {
+            containsData = raster.value(i) > 0.0;
+        }
 
         if (containsData) {
             normalize_raster(raster);
@@ -477,16 +449,64 @@ static gdx::DenseRaster<double> read_country_from_pattern(const fs::path& spatia
     return raster;
 }
 
-gdx::DenseRaster<double> SpatialPatternInventory::get_pattern_raster(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const
+PatternContentsKey pattern_contents_key(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool includeGrid)
+{
+    PatternContentsKey key;
+    key.path           = file::u8string(src.path);
+    key.type           = src.type;
+    key.isException    = src.isException;
+    key.usedEmissionId = src.usedEmissionId.key();
+    key.country        = countryCoverage.country;
+
+    if (includeGrid) {
+        const auto& extent = countryCoverage.outputSubgridExtent;
+        key.rows           = extent.rows;
+        key.cols           = extent.cols;
+        key.xll            = extent.xll;
+        key.yll            = extent.yll;
+        key.cellSize       = extent.cell_size_x();
+    }
+
+    return key;
+}
+
+bool SpatialPatternInventory::is_known_without_data(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const
+{
+    // The contents are only checked on the coursest grid, the finer grids reuse that verdict
+    // so they select the same pattern as the coursest grid
+    const auto key = pattern_contents_key(src, countryCoverage, checkContents);
+
+    std::scoped_lock lock(_contentsMutex);
+    if (auto iter = _patternContents.find(key); iter != _patternContents.end()) {
+        return !iter->second;
+    }
+
+    return false;
+}
+
+void SpatialPatternInventory::store_pattern_contents(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool hasData) const
+{
+    std::scoped_lock lock(_contentsMutex);
+    _patternContents.insert_or_assign(pattern_contents_key(src, countryCoverage, true), hasData);
+    if (!hasData) {
+        _patternContents.insert_or_assign(pattern_contents_key(src, countryCoverage, false), false);
+    }
+}
+
+SparseRaster SpatialPatternInventory::get_pattern_raster(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const
 {
+    // The patterns are normalized after the precision conversion, so the normalized pattern sums to one in the stored precision
+    const auto precision = pattern_precision(_cfg);
+
     switch (src.type) {
     case SpatialPatternSource::Type::SpatialPatternCEIP:
-        return extract_country_from_pattern(parse_spatial_pattern_ceip(src.path, src.usedEmissionId, _cfg), countryCoverage, checkContents);
+        return extract_country_from_pattern(parse_spatial_pattern_ceip(src.path, src.usedEmissionId, _cfg), countryCoverage, checkContents, precision);
     case SpatialPatternSource::Type::SpatialPatternFlanders: {
         const auto* spatialPatternData = _flandersCache.get_data(src.path, src.usedEmissionId, src.isException);
         if (spatialPatternData != nullptr) {
-            auto result = gdx::resample_raster(spatialPatternData->raster, countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average);
-            if ((!checkContents) || gdx::sum(result) > 0.0) {
+            SparseRaster result(gdx::resample_raster(spatialPatternData->raster, countryCoverage.outputSubgridExtent, gdal::ResampleAlgorithm::Average));
+            result.set_precision(precision);
+            if ((!checkContents) || result.sum() > 0.0) {
                 normalize_raster(result);
                 return result;
             }
@@ -500,9 +520,12 @@ gdx::DenseRaster<double> SpatialPatternInventory::get_pattern_raster(const Spati
         if (countryCoverage.country == country::BEF) {
             // Flanders should never be extracted, there is no data for other countries
             // no ratio will be applied to the country borders
-            return read_country_from_pattern(src.path, countryCoverage, checkContents);
+            return read_country_from_pattern(src.path, countryCoverage, checkContents, precision);
+        } else if (precision == SparseRaster::Precision::Single) {
+            // Avoid the double precision copy of the full pattern
+            return extract_country_from_pattern(gdx::read_dense_raster<float>(src.path), countryCoverage, checkContents, precision);
         } else {
-            return extract_country_from_pattern(gdx::read_dense_raster<double>(src.path), countryCoverage, checkContents);
+            return extract_country_from_pattern(gdx::read_dense_raster<double>(src.path), countryCoverage, checkContents, precision);
         }
     default:
         break;
@@ -511,37 +534,34 @@ gdx::DenseRaster<double> SpatialPatternInventory::get_pattern_raster(const Spati
     throw std::logic_error("Unhandled spatial pattern type");
 }
 
-std::optional<SpatialPattern> SpatialPatternInventory::find_spatial_pattern(const EmissionIdentifier& emissionId,
-                                                                            const CountryCellCoverage& countryCoverage,
-                                                                            const std::vector<SpatialPatterns>& patterns,
-                                                                            const Pollutant& pollutantToReport,
-                                                                            const EmissionSector& sectorToReport,
-                                                                            bool checkContents,
-                                                                            bool& patternAvailableButWithoutData) const
+void SpatialPatternInventory::add_pattern_candidates(const EmissionIdentifier& emissionId,
+                                                     const std::vector<SpatialPatterns>& patterns,
+                                                     const Pollutant& pollutantToReport,
+                                                     const EmissionSector& sectorToReport,
+                                                     std::vector<SpatialPatternSource>& sources) const
 {
-    for (auto& [year, patterns] : patterns) {
-        if (auto source = search_spatial_pattern_within_year(emissionId.country, emissionId.pollutant, pollutantToReport, emissionId.sector, sectorToReport, year, patterns); source.has_value()) {
-            SpatialPattern result(*source);
-            result.raster = get_pattern_raster(*source, countryCoverage, checkContents);
+    // first check the exceptions
+    if (const auto* exception = find_pollutant_exception(emissionId); exception != nullptr) {
+        assert(!exception->viaSector.has_value());
+        sources.push_back(source_from_exception(*exception, pollutantToReport, sectorToReport, _cfg.year()));
+    }
 
-            if (result.raster.empty()) {
-                patternAvailableButWithoutData = true;
-            } else {
-                return result;
-            }
+    // then the regular patterns, in order of year preference
+    for (const auto& patternsForYear : patterns) {
+        if (auto source = search_spatial_pattern_within_year(emissionId.country, emissionId.pollutant, pollutantToReport, emissionId.sector, sectorToReport, patternsForYear); source.has_value()) {
+            sources.push_back(std::move(*source));
         }
     }
-
-    return {};
 }
 
-SpatialPattern SpatialPatternInventory::get_spatial_pattern_impl(EmissionIdentifier emissionId, const CountryCellCoverage& countryCoverage, bool checkContents) const
+SpatialPatternInventory::PatternCandidates SpatialPatternInventory::resolve_pattern_candidates(EmissionIdentifier emissionId) const
 {
-    const auto sectorToReport           = emissionId.sector;
-    bool patternAvailableButWithoutData = false;
+    PatternCandidates result;
+
+    const auto sectorToReport = emissionId.sector;
 
     // Check if we should find this pattern via another sector
-    if (auto exception = find_sector_exception(emissionId); exception.has_value()) {
+    if (const auto* exception = find_sector_exception(emissionId); exception != nullptr) {
         assert(exception->viaSector.has_value());
         emissionId = emissionId.with_sector(*exception->viaSector);
     }
@@ -549,35 +569,60 @@ SpatialPattern SpatialPatternInventory::get_spatial_pattern_impl(EmissionIdentif
     auto countrySpecificIter = _countrySpecificSpatialPatterns.find(emissionId.country);
     const auto& patterns     = countrySpecificIter != _countrySpecificSpatialPatterns.end() ? countrySpecificIter->second : _spatialPatternsRest;
 
-    // first check the exceptions
-    if (auto exception = find_spatial_pattern_exception(emissionId, countryCoverage, emissionId.pollutant, sectorToReport, checkContents, patternAvailableButWithoutData); exception.has_value()) {
-        return std::move(*exception);
+    add_pattern_candidates(emissionId, patterns, emissionId.pollutant, sectorToReport, result.sources);
+
+    // Try the fallback pollutant
+    if (auto fallbackPollutant = _cfg.pollutants().pollutant_fallback(emissionId.pollutant); fallbackPollutant.has_value()) {
+        add_pattern_candidates(emissionId.with_pollutant(*fallbackPollutant), patterns, emissionId.pollutant, sectorToReport, result.sources);
     }
 
-    // then the regular patterns
-    if (auto exception = find_spatial_pattern(emissionId, countryCoverage, patterns, emissionId.pollutant, sectorToReport, checkContents, patternAvailableButWithoutData); exception.has_value()) {
-        return std::move(*exception);
+    result.uniformSpreadId = emissionId;
+    return result;
+}
+
+const SpatialPatternInventory::PatternCandidates& SpatialPatternInventory::pattern_candidates(const EmissionIdentifier& emissionId) const
+{
+    {
+        std::scoped_lock lock(_candidatesMutex);
+        if (auto iter = _patternCandidates.find(emissionId.key()); iter != _patternCandidates.end()) {
+            return iter->second;
+        }
     }
 
-    // Try the fallback pollutant
-    if (auto fallbackPollutant = _cfg.pollutants().pollutant_fallback(emissionId.pollutant); fallbackPollutant.has_value()) {
-        // A fallback is defined, search for the pattern
+    auto candidates = resolve_pattern_candidates(emissionId);
+
+    // references to unordered_map elements remain valid when other elements are inserted
+    std::scoped_lock lock(_candidatesMutex);
+    return _patternCandidates.emplace(emissionId.key(), std::move(candidates)).first->second;
+}
+
+SpatialPattern SpatialPatternInventory::get_spatial_pattern_impl(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage, bool checkContents) const
+{
+    bool patternAvailableButWithoutData = false;
 
-        const auto fallbackId = emissionId.with_pollutant(*fallbackPollutant);
+    const auto& candidates = pattern_candidates(emissionId);
+    for (const auto& source : candidates.sources) {
+        if (is_known_without_data(source, countryCoverage, checkContents)) {
+            patternAvailableButWithoutData = true;
+            continue;
+        }
 
-        // first check the exceptions
-        if (auto exception = find_spatial_pattern_exception(fallbackId, countryCoverage, emissionId.pollutant, sectorToReport, checkContents, patternAvailableButWithoutData); exception.has_value()) {
-            return std::move(*exception);
+        SpatialPattern result(source);
+        result.raster = get_pattern_raster(source, countryCoverage, checkContents);
+        if (checkContents) {
+            store_pattern_contents(source, countryCoverage, !result.raster.empty());
         }
 
-        // then the regular patterns
-        if (auto exception = find_spatial_pattern(fallbackId, countryCoverage, patterns, emissionId.pollutant, sectorToReport, checkContents, patternAvailableButWithoutData); exception.has_value()) {
-            return std::move(*exception);
+        if (!result.raster.empty()) {
+            return result;
         }
+
+        patternAvailableButWithoutData = true;
     }
 
     // last resort: uniform spread
-    return SpatialPattern(SpatialPatternSource::create_with_uniform_spread(emissionId.country, emissionId.sector, emissionId.pollutant, patternAvailableButWithoutData));
+    const auto& uniformId = candidates.uniformSpreadId;
+    return SpatialPattern(SpatialPatternSource::create_with_uniform_spread(uniformId.country, uniformId.sector, uniformId.pollutant, patternAvailableButWithoutData));
 }
 
 SpatialPattern SpatialPatternInventory::get_spatial_pattern_checked(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage) const
@@ -618,61 +663,60 @@ std::vector<SpatialPatternInventory::SpatialPatternException> SpatialPatternInve
         return result;
     }
 
-    CPLSetThreadLocalConfigOption("OGR_XLSX_HEADERS", "FORCE");
-    auto ds    = gdal::VectorDataSet::open(exceptionsFile);
-    auto layer = ds.layer("Spatial disaggregation");
-
-    auto colYear      = layer.required_field_index("Year");
-    auto colPollutant = layer.required_field_index("pollutant_code");
-    auto colCountry   = layer.required_field_index("country_iso_code");
-    auto colGnfr      = layer.required_field_index("GNFR_code");
-    auto colNfr       = layer.required_field_index("NFR_code");
-    auto colPath      = layer.required_field_index("file_path");
-    auto colType      = layer.required_field_index("type");
-    auto colViaNfr    = layer.required_field_index("via_NFR");
-    auto colViaGnfr   = layer.required_field_index("via_GNFR");
-
-    int row = 0;
-    for (const auto& feature : layer) {
-        ++row;
+    xl::WorkBookReader workbook(exceptionsFile);
+
+    int32_t colYear = -1, colPollutant = -1, colCountry = -1, colGnfr = -1, colNfr = -1, colPath = -1, colType = -1, colViaNfr = -1, colViaGnfr = -1;
+    workbook.read_sheet(
+        "Spatial disaggregation",
+        [&](const xl::Row& header) {
+            colYear      = xl::required_column_index(header, "Year");
+            colPollutant = xl::required_column_index(header, "pollutant_code");
+            colCountry   = xl::required_column_index(header, "country_iso_code");
+            colGnfr      = xl::required_column_index(header, "GNFR_code");
+            colNfr       = xl::required_column_index(header, "NFR_code");
+            colPath      = xl::required_column_index(header, "file_path");
+            colType      = xl::required_column_index(header, "type");
+            colViaNfr    = xl::required_column_index(header, "via_NFR");
+            colViaGnfr   = xl::required_column_index(header, "via_GNFR");
+        },
+        [&](const xl::Row& row) {
+            if (row.is_empty(0)) {
+                return; // skip empty lines
+            }
 
-        if (!feature.field_is_valid(0)) {
-            continue; // skip empty lines
-        }
+            try {
+                auto country   = _cfg.countries().country_from_string(row.as_string_view(colCountry));
+                auto pollutant = _cfg.pollutants().pollutant_from_string(row.as_string_view(colPollutant));
+                std::optional<EmissionSector> sector;
+                if (!row.is_empty(colGnfr)) {
+                    sector = EmissionSector(_cfg.sectors().gnfr_sector_from_code_string(row.as_string_view(colGnfr)));
+                }
 
-        try {
-            auto country   = _cfg.countries().country_from_string(feature.field_as<std::string_view>(colCountry));
-            auto pollutant = _cfg.pollutants().pollutant_from_string(feature.field_as<std::string_view>(colPollutant));
-            std::optional<EmissionSector> sector;
-            if (feature.field_is_valid(colGnfr)) {
-                sector = EmissionSector(_cfg.sectors().gnfr_sector_from_code_string(feature.field_as<std::string_view>(colGnfr)));
-            }
+                if (!row.is_empty(colNfr)) {
+                    sector = EmissionSector(_cfg.sectors().nfr_sector_from_string(row.as_string_view(colNfr)));
+                }
 
-            if (feature.field_is_valid(colNfr)) {
-                sector = EmissionSector(_cfg.sectors().nfr_sector_from_string(feature.field_as<std::string_view>(colNfr)));
-            }
+                if (sector.has_value()) {
+                    SpatialPatternException ex;
+                    ex.yearRange      = parse_year_range(row.as_string_view(colYear));
+                    ex.emissionId     = EmissionIdentifier(country, *sector, pollutant);
+                    ex.spatialPattern = exceptionsFile.parent_path() / file::u8path(row.as_string_view(colPath));
+                    ex.type           = exception_type_from_string(row.as_string_view(colType));
 
-            if (sector.has_value()) {
-                SpatialPatternException ex;
-                ex.yearRange      = parse_year_range(feature.field_as<std::string>(colYear));
-                ex.emissionId     = EmissionIdentifier(country, *sector, pollutant);
-                ex.spatialPattern = exceptionsFile.parent_path() / file::u8path(feature.field_as<std::string_view>(colPath));
-                ex.type           = exception_type_from_string(feature.field_as<std::string_view>(colType));
+                    if (!row.is_empty(colViaNfr)) {
+                        ex.viaSector = EmissionSector(_cfg.sectors().nfr_sector_from_string(row.as_string_view(colViaNfr)));
+                    }
 
-                if (feature.field_is_valid(colViaNfr)) {
-                    ex.viaSector = EmissionSector(_cfg.sectors().nfr_sector_from_string(feature.field_as<std::string_view>(colViaNfr)));
-                }
+                    if (!row.is_empty(colViaGnfr)) {
+                        ex.viaSector = EmissionSector(_cfg.sectors().gnfr_sector_from_string(row.as_string_view(colViaGnfr)));
+                    }
 
-                if (feature.field_is_valid(colViaGnfr)) {
-                    ex.viaSector = EmissionSector(_cfg.sectors().gnfr_sector_from_string(feature.field_as<std::string_view>(colViaGnfr)));
+                    result.push_back(ex);
                 }
-
-                result.push_back(ex);
+            } catch (const std::exception& e) {
+                Log::warn("Invalid line ({}) in spatial pattern exceptions file: {}", row.row_number(), e.what());
             }
-        } catch (const std::exception& e) {
-            Log::warn("Invalid line ({}) in spatial pattern exceptions file: {}", row, e.what());
-        }
-    }
+        });
 
     return result;
 }
@@ -2,12 +2,15 @@
 
 #include "emap/emissions.h"
 #include "emap/spatialpatterndata.h"
+#include "spatialpatternmanifest.h"
 #include "infra/filesystem.h"
+#include "infra/hash.h"
 #include "infra/range.h"
 
 #include <date/date.h>
+#include <map>
+#include <mutex>
 #include <optional>
-#include <regex>
 #include <unordered_map>
 
 namespace emap {
@@ -28,17 +31,56 @@ private:
     const SpatialPatternData* find_data_for_id(const std::vector<SpatialPatternData>& list, const EmissionIdentifier& emissionId) const noexcept;
     const SpatialPatternData* find_data_for_sector(const std::vector<SpatialPatternData>& list, const EmissionSector& sector) const noexcept;
 
+    struct CachedTable
+    {
+        std::once_flag parsed;
+        std::vector<SpatialPatternData> patterns;
+    };
+
+    // Only protects the map, the tables are parsed outside of the lock so different workbooks can be parsed in parallel
     std::mutex _mutex;
     const RunConfiguration& _cfg;
-    std::map<fs::path, std::unique_ptr<std::vector<SpatialPatternData>>> _patterns;
+    std::map<fs::path, std::unique_ptr<CachedTable>> _patterns;
+};
+
+// Identifies a pattern file cut out for a country on a grid
+// The grid fields are zero when the verdict applies regardless of the grid
+// Exception sources of a flanders table match the data on the sector only, so they never share a verdict with a regular source
+struct PatternContentsKey
+{
+    std::string path;
+    SpatialPatternSource::Type type = SpatialPatternSource::Type::Raster;
+    bool isException                = false;
+    EmissionKey usedEmissionId;
+    Country country;
+    int32_t rows    = 0;
+    int32_t cols    = 0;
+    double xll      = 0.0;
+    double yll      = 0.0;
+    double cellSize = 0.0;
+
+    bool operator==(const PatternContentsKey& other) const noexcept = default;
+};
+
+struct PatternContentsKeyHash
+{
+    size_t operator()(const PatternContentsKey& key) const noexcept
+    {
+        size_t seed = 0;
+        inf::hash_combine(seed, key.path, key.type, key.isException, key.usedEmissionId, key.country, key.rows, key.cols, key.xll, key.yll, key.cellSize);
+        return seed;
+    }
 };
 
+PatternContentsKey pattern_contents_key(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool includeGrid);
+
 class SpatialPatternInventory
 {
 public:
     SpatialPatternInventory(const RunConfiguration& cfg);
 
-    void scan_dir(date::year reportingYear, date::year startYear, const fs::path& spatialPatternPath);
+    /* Scan the available spatial patterns, if a manifest path is provided the directory listings are cached in the manifest */
+    void scan_dir(date::year reportingYear, date::year startYear, const fs::path& spatialPatternPath, const fs::path& manifestPath = {});
 
     /* Obtain the spatial pattern for the given identifier, checks if the country cells contain actual data */
     SpatialPattern get_spatial_pattern_checked(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage) const;
@@ -63,10 +105,35 @@ private:
         EmissionSector sector;
     };
 
+    struct PatternKey
+    {
+        Pollutant pollutant;
+        EmissionSector sector;
+
+        bool operator==(const PatternKey& other) const noexcept
+        {
+            return pollutant == other.pollutant && sector == other.sector;
+        }
+    };
+
+    struct PatternKeyHash
+    {
+        size_t operator()(const PatternKey& key) const noexcept
+        {
+            size_t seed = 0;
+            inf::hash_combine(seed, key.pollutant, key.sector);
+            return seed;
+        }
+    };
+
     struct SpatialPatterns
     {
         date::year year;
         std::vector<SpatialPatternFile> spatialPatterns;
+        // Index in spatialPatterns of the first file for the pollutant and sector
+        std::unordered_map<PatternKey, size_t, PatternKeyHash> sectorIndex;
+        // Index in spatialPatterns of the first file for the pollutant without a sector (contains all sectors)
+        std::unordered_map<Pollutant, size_t> pollutantIndex;
     };
 
     struct SpatialPatternException
@@ -86,44 +153,71 @@ private:
         std::optional<EmissionSector> viaSector;
     };
 
+    struct PatternCandidates
+    {
+        // The pattern sources in order of preference, the first one that contains data is used
+        std::vector<SpatialPatternSource> sources;
+        // Identifier for the uniform spread when none of the sources contain data
+        EmissionIdentifier uniformSpreadId;
+    };
+
     std::vector<SpatialPatternException> parse_spatial_pattern_exceptions(const fs::path& exceptionsFile) const;
     std::optional<SpatialPatternSource> search_spatial_pattern_within_year(const Country& country,
                                                                            const Pollutant& pol,
                                                                            const Pollutant& polToReport,
                                                                            const EmissionSector& sector,
                                                                            const EmissionSector& sectorToReport,
-                                                                           date::year year,
-                                                                           const std::vector<SpatialPatternFile>& patterns) const;
+                                                                           const SpatialPatterns& patterns) const;
+
+    struct PatternDirectory
+    {
+        date::year year;
+        fs::path path;
+        PatternFileType type = PatternFileType::Cams;
+        std::vector<PatternFilenameInfo> files;
+    };
 
-    std::optional<SpatialPatternFile> identify_spatial_pattern_cams(const fs::path& path) const;
-    std::optional<SpatialPatternFile> identify_spatial_pattern_ceip(const fs::path& path) const;
-    std::optional<SpatialPatternFile> identify_spatial_pattern_flanders(const fs::path& path) const;
-    std::vector<SpatialPatterns> scan_dir_rest(date::year startYear, const fs::path& spatialPatternPath) const;
-    std::vector<SpatialPatterns> scan_dir_flanders(date::year startYear, const fs::path& spatialPatternPath) const;
+    std::optional<SpatialPatternFile> resolve_spatial_pattern_file(const PatternDirectory& dir, const PatternFilenameInfo& info) const;
+    std::vector<SpatialPatterns> scan_pattern_directories(std::vector<PatternDirectory>& dirs, SpatialPatternManifest& manifest) const;
+    std::vector<SpatialPatterns> scan_dir_rest(date::year startYear, const fs::path& spatialPatternPath, SpatialPatternManifest& manifest) const;
+    std::vector<SpatialPatterns> scan_dir_flanders(date::year startYear, const fs::path& spatialPatternPath, SpatialPatternManifest& manifest) const;
 
-    std::optional<SpatialPattern> find_spatial_pattern_exception(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage, const Pollutant& pollutantToReport, const EmissionSector& sectorToReport, bool checkContents, bool& patternAvailableButWithoutData) const;
-    std::optional<SpatialPattern> find_spatial_pattern(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage, const std::vector<SpatialPatterns>& patterns, const Pollutant& pollutantToReport, const EmissionSector& sectorToReport, bool checkContents, bool& patternAvailableButWithoutData) const;
+    static void build_pattern_index(SpatialPatterns& patterns);
+    void build_exception_index();
 
-    SpatialPattern get_spatial_pattern_impl(EmissionIdentifier emissionId, const CountryCellCoverage& countryCoverage, bool checkContents) const;
+    void add_pattern_candidates(const EmissionIdentifier& emissionId, const std::vector<SpatialPatterns>& patterns, const Pollutant& pollutantToReport, const EmissionSector& sectorToReport, std::vector<SpatialPatternSource>& sources) const;
+    PatternCandidates resolve_pattern_candidates(EmissionIdentifier emissionId) const;
+    const PatternCandidates& pattern_candidates(const EmissionIdentifier& emissionId) const;
 
-    std::optional<SpatialPatternException> find_pollutant_exception(const EmissionIdentifier& emissionId) const noexcept;
-    std::optional<SpatialPatternException> find_sector_exception(const EmissionIdentifier& emissionId) const noexcept;
+    SpatialPattern get_spatial_pattern_impl(const EmissionIdentifier& emissionId, const CountryCellCoverage& countryCoverage, bool checkContents) const;
+
+    const SpatialPatternException* find_pollutant_exception(const EmissionIdentifier& emissionId) const noexcept;
+    const SpatialPatternException* find_sector_exception(const EmissionIdentifier& emissionId) const noexcept;
+    static SpatialPatternSource source_from_pattern_file(const SpatialPatternFile& spf, const EmissionIdentifier& emissionId, const EmissionIdentifier& usedEmissionId, date::year year, bool isException);
     static SpatialPatternSource source_from_exception(const SpatialPatternException& ex, const Pollutant& pollutantToReport, const EmissionSector& emissionSectorToReport, date::year year);
     static SpatialPatternException::Type exception_type_from_string(std::string_view str);
 
-    gdx::DenseRaster<double> get_pattern_raster(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const;
+    SparseRaster get_pattern_raster(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const;
+
+    bool is_known_without_data(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool checkContents) const;
+    void store_pattern_contents(const SpatialPatternSource& src, const CountryCellCoverage& countryCoverage, bool hasData) const;
 
     const RunConfiguration& _cfg;
-    std::regex _spatialPatternCamsRegex;
-    std::regex _spatialPatternCeipRegex;
-    std::regex _spatialPatternBelgium1Regex;
-    std::regex _spatialPatternBelgium2Regex;
     // Contains all the exceptions for the configured year
     std::vector<SpatialPatternException> _exceptions;
+    // Index in _exceptions of the first exception for the identifier, without and with a "via" sector
+    std::unordered_map<EmissionKey, size_t> _pollutantExceptionIndex;
+    std::unordered_map<EmissionKey, size_t> _sectorExceptionIndex;
     // Contains all the available patterns, sorted by year of preference
     std::vector<SpatialPatterns> _spatialPatternsRest;
     std::unordered_map<Country, std::vector<SpatialPatterns>> _countrySpecificSpatialPatterns;
     mutable SpatialPatternTableCache _flandersCache;
+    // The resolved pattern sources are memoized, the resolution only depends on the identifier
+    mutable std::mutex _candidatesMutex;
+    mutable std::unordered_map<EmissionKey, PatternCandidates> _patternCandidates;
+    // Run wide memo of the content checks, avoids reading patterns that are known to contain no data for a country
+    mutable std::mutex _contentsMutex;
+    mutable std::unordered_map<PatternContentsKey, bool, PatternContentsKeyHash> _patternContents;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "spatialpatternmanifest.h"
+
+#include "infra/exception.h"
+#include "infra/log.h"
+#include "infra/string.h"
+
+#include <algorithm>
+#include <cpl_vsi.h>
+#include <fmt/format.h>
+
+namespace emap {
+
+using namespace inf;
+
+static constexpr std::string_view s_manifestHeader = "emap-spatial-pattern-manifest 1";
+
+// Character classes of the former std::regex based filename matching (\w and \d)
+static bool is_word_char(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool is_digit(char c) noexcept
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool is_word(std::string_view str) noexcept
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), is_word_char);
+}
+
+static bool is_number(std::string_view str, size_t length) noexcept
+{
+    return str.size() == length && std::all_of(str.begin(), str.end(), is_digit);
+}
+
+// digits, any character, digits (\d+.\d+)
+static bool is_version_number(std::string_view str) noexcept
+{
+    if (str.size() < 3 || !is_digit(str.front()) || !is_digit(str.back())) {
+        return false;
+    }
+
+    return std::count_if(str.begin(), str.end(), [](char c) { return !is_digit(c); }) <= 1;
+}
+
+/* Splits {pollutant}_{sector} where the sector is either a gnfr sector (A_PublicPower) or an nfr sector (1A1a)
+ * The pollutant can contain underscores (pm2_5), so the shortest valid sector suffix is used */
+static std::optional<std::pair<std::string_view, std::string_view>> split_pollutant_sector(std::string_view str) noexcept
+{
+    const auto lastSep = str.rfind('_');
+    if (lastSep == std::string_view::npos || lastSep == 0) {
+        return {};
+    }
+
+    const auto lastToken = str.substr(lastSep + 1);
+    if (lastToken.size() >= 2 && lastToken.front() >= '1' && lastToken.front() <= '6' && is_word(str.substr(0, lastSep))) {
+        // nfr sector
+        return std::make_pair(str.substr(0, lastSep), lastToken);
+    }
+
+    const auto sectorSep = str.rfind('_', lastSep - 1);
+    if (sectorSep == std::string_view::npos || lastToken.empty()) {
+        return {};
+    }
+
+    const auto sectorLetter = str.substr(sectorSep + 1, lastSep - sectorSep - 1);
+    if (sectorLetter.size() == 1 && sectorLetter.front() >= 'A' && sectorLetter.front() <= 'Z' && is_word(str.substr(0, sectorSep))) {
+        // gnfr sector
+        return std::make_pair(str.substr(0, sectorSep), str.substr(sectorSep + 1));
+    }
+
+    return {};
+}
+
+// CAMS_emissions_REG-{tag}v{major}.{minor}_{year}_{pollutant}_{sector}
+static std::optional<PatternFilenameInfo> identify_cams_filename(std::string_view stem)
+{
+    constexpr std::string_view prefix = "CAMS_emissions_REG-";
+    if (!str::starts_with(stem, prefix)) {
+        return {};
+    }
+
+    const auto name = stem.substr(prefix.size());
+
+    for (auto versionPos = name.rfind('v'); versionPos != std::string_view::npos && versionPos > 0; versionPos = name.rfind('v', versionPos - 1)) {
+        if (!is_word(name.substr(0, versionPos))) {
+            continue;
+        }
+
+        for (auto yearSep = name.find('_', versionPos + 1); yearSep != std::string_view::npos; yearSep = name.find('_', yearSep + 1)) {
+            if (!is_version_number(name.substr(versionPos + 1, yearSep - versionPos - 1))) {
+                continue;
+            }
+
+            const auto remainder = name.substr(yearSep + 1);
+            if (remainder.size() < 5 || !is_number(remainder.substr(0, 4), 4) || remainder[4] != '_') {
+                continue;
+            }
+
+            if (auto polSector = split_pollutant_sector(remainder.substr(5)); polSector.has_value()) {
+                return PatternFilenameInfo{{}, std::string(polSector->first), std::string(polSector->second)};
+            }
+        }
+    }
+
+    return {};
+}
+
+// {pollutant}_{sector}_{reportyear}_GRID_{year}
+static std::optional<PatternFilenameInfo> identify_ceip_filename(std::string_view stem)
+{
+    constexpr size_t suffixLength = 15;
+    if (stem.size() <= suffixLength) {
+        return {};
+    }
+
+    const auto suffix = stem.substr(stem.size() - suffixLength);
+    if (suffix.front() != '_' || !is_number(suffix.substr(1, 4), 4) || suffix.substr(5, 6) != "_GRID_" || !is_number(suffix.substr(11), 4)) {
+        return {};
+    }
+
+    if (auto polSector = split_pollutant_sector(stem.substr(0, stem.size() - suffixLength)); polSector.has_value()) {
+        return PatternFilenameInfo{{}, std::string(polSector->first), std::string(polSector->second)};
+    }
+
+    return {};
+}
+
+// Emissies per km2 (excl|incl) puntbrongegevens_{year}_{pollutant}
+// Emissie per km2_met NFR_{pollutant} {year}_{name} {year}
+static std::optional<PatternFilenameInfo> identify_flanders_filename(std::string_view stem)
+{
+    for (std::string_view prefix : {"Emissies per km2 excl puntbrongegevens_", "Emissies per km2 incl puntbrongegevens_"}) {
+        if (str::starts_with(stem, prefix)) {
+            const auto name = stem.substr(prefix.size());
+            if (name.size() < 6 || !is_number(name.substr(0, 4), 4) || name[4] != '_') {
+                return {};
+            }
+
+            const auto pollutant = name.substr(5);
+            if (!std::all_of(pollutant.begin(), pollutant.end(), [](char c) { return is_word_char(c) || c == ','; })) {
+                return {};
+            }
+
+            return PatternFilenameInfo{{}, std::string(pollutant), {}};
+        }
+    }
+
+    constexpr std::string_view prefix = "Emissie per km2_met NFR_";
+    if (!str::starts_with(stem, prefix)) {
+        return {};
+    }
+
+    auto name = stem.substr(prefix.size());
+    if (name.size() < 5 || name[name.size() - 5] != ' ' || !is_number(name.substr(name.size() - 4), 4)) {
+        return {};
+    }
+    name = name.substr(0, name.size() - 5);
+
+    // ' {year}_' separates the pollutant from the name, the pollutant can contain spaces so search from the back
+    for (auto yearSep = name.rfind(' '); yearSep != std::string_view::npos && yearSep > 0; yearSep = name.rfind(' ', yearSep - 1)) {
+        if (!is_number(name.substr(yearSep + 1, 4), 4) || name.substr(yearSep + 5, 1) != "_" || !is_word(name.substr(yearSep + 6))) {
+            continue;
+        }
+
+        const auto pollutant = name.substr(0, yearSep);
+        if (std::all_of(pollutant.begin(), pollutant.end(), [](char c) { return is_word_char(c) || c == ' ' || c == ','; })) {
+            return PatternFilenameInfo{{}, std::string(pollutant), {}};
+        }
+    }
+
+    return {};
+}
+
+std::optional<PatternFilenameInfo> identify_pattern_filename(PatternFileType type, std::string_view filename)
+{
+    switch (type) {
+    case PatternFileType::Cams:
+        return identify_cams_filename(filename);
+    case PatternFileType::Ceip:
+        return identify_ceip_filename(filename);
+    case PatternFileType::FlandersTable:
+        return identify_flanders_filename(filename);
+    }
+
+    return {};
+}
+
+static std::string_view pattern_file_extension(PatternFileType type) noexcept
+{
+    switch (type) {
+    case PatternFileType::Cams:
+        return ".tif";
+    case PatternFileType::Ceip:
+        return ".txt";
+    case PatternFileType::FlandersTable:
+        return ".xlsx";
+    }
+
+    return {};
+}
+
+static std::vector<std::string_view> split_fields(std::string_view line)
+{
+    // empty fields are significant, they can not be skipped
+    std::vector<std::string_view> result;
+
+    size_t start = 0;
+    for (auto pos = line.find('\t'); pos != std::string_view::npos; pos = line.find('\t', start)) {
+        result.push_back(line.substr(start, pos - start));
+        start = pos + 1;
+    }
+    result.push_back(line.substr(start));
+
+    return result;
+}
+
+SpatialPatternManifest::SpatialPatternManifest(const fs::path& manifestPath)
+: _path(manifestPath)
+{
+    if (fs::exists(_path)) {
+        try {
+            load();
+        } catch (const std::exception& e) {
+            Log::warn("Ignoring invalid spatial pattern manifest ({})", e.what());
+            _directories.clear();
+        }
+    }
+}
+
+std::vector<PatternFilenameInfo> SpatialPatternManifest::list_directory(const fs::path& dir, PatternFileType type)
+{
+    const auto stamp = directory_stamp(dir);
+    const auto key   = str::from_u8(dir.generic_u8string());
+
+    {
+        std::scoped_lock lock(_mutex);
+        if (auto iter = _directories.find(key); iter != _directories.end() && iter->second.type == type && iter->second.stamp == stamp) {
+            return iter->second.files;
+        }
+    }
+
+    DirectoryListing listing;
+    listing.type  = type;
+    listing.stamp = stamp;
+    listing.files = scan_directory(dir, type);
+
+    auto files = listing.files;
+
+    std::scoped_lock lock(_mutex);
+    _directories.insert_or_assign(key, std::move(listing));
+    _modified = true;
+    return files;
+}
+
+void SpatialPatternManifest::save() const
+{
+    std::scoped_lock lock(_mutex);
+    if (_path.empty() || !_modified) {
+        return;
+    }
+
+    std::string contents(s_manifestHeader);
+    contents += '\n';
+
+    for (const auto& [dir, listing] : _directories) {
+        contents += fmt::format("dir\t{}\t{}\t{}\t{}\n", static_cast<int>(listing.type), listing.stamp.modificationTime, listing.stamp.size, dir);
+        for (const auto& file : listing.files) {
+            contents += fmt::format("file\t{}\t{}\t{}\n", file.filename, file.pollutant, file.sector);
+        }
+    }
+
+    // write to a temporary file that replaces the manifest, an interrupted run never leaves a partially written manifest behind
+    auto tempPath = _path;
+    tempPath += ".tmp";
+
+    try {
+        // the manifest is only a cache, failing to store it should not abort the run
+        fs::create_directories(_path.parent_path());
+        file::write_as_text(tempPath, contents);
+        fs::rename(tempPath, _path);
+    } catch (const std::exception& e) {
+        Log::warn("Failed to write the spatial pattern manifest: {}", e.what());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+    }
+}
+
+void SpatialPatternManifest::load()
+{
+    const auto contents = file::read_as_text(_path);
+
+    std::string_view remaining(contents);
+    auto next_line = [&remaining]() {
+        const auto pos  = remaining.find('\n');
+        const auto line = remaining.substr(0, pos);
+        remaining       = pos == std::string_view::npos ? std::string_view() : remaining.substr(pos + 1);
+        return line;
+    };
+
+    if (next_line() != s_manifestHeader) {
+        throw RuntimeError("Unsupported manifest version");
+    }
+
+    DirectoryListing* currentListing = nullptr;
+    while (!remaining.empty()) {
+        const auto line = next_line();
+        if (line.empty()) {
+            continue;
+        }
+
+        const auto fields = split_fields(line);
+        if (fields.front() == "dir" && fields.size() == 5) {
+            DirectoryListing listing;
+            listing.type                   = static_cast<PatternFileType>(str::to_int32_value(fields[1]));
+            listing.stamp.modificationTime = str::to_int64_value(fields[2]);
+            listing.stamp.size             = str::to_int64_value(fields[3]);
+            currentListing                 = &_directories.insert_or_assign(std::string(fields[4]), std::move(listing)).first->second;
+        } else if (fields.front() == "file" && fields.size() == 4 && currentListing != nullptr) {
+            currentListing->files.push_back(PatternFilenameInfo{std::string(fields[1]), std::string(fields[2]), std::string(fields[3])});
+        } else {
+            throw RuntimeError("Invalid manifest line: {}", line);
+        }
+    }
+}
+
+SpatialPatternManifest::DirectoryStamp SpatialPatternManifest::directory_stamp(const fs::path& dir)
+{
+    // The modification time of a directory changes when files are added, removed or renamed
+    DirectoryStamp stamp;
+    stamp.modificationTime = fs::last_write_time(dir).time_since_epoch().count();
+
+    VSIStatBufL statBuf;
+    if (VSIStatL(str::from_u8(dir.u8string()).c_str(), &statBuf) == 0) {
+        stamp.size = static_cast<int64_t>(statBuf.st_size);
+    }
+
+    return stamp;
+}
+
+std::vector<PatternFilenameInfo> SpatialPatternManifest::scan_directory(const fs::path& dir, PatternFileType type)
+{
+    std::vector<PatternFilenameInfo> result;
+
+    const auto extension = pattern_file_extension(type);
+    for (const auto& dirEntry : fs::directory_iterator(dir)) {
+        if (dirEntry.is_regular_file() && dirEntry.path().extension() == extension) {
+            if (auto info = identify_pattern_filename(type, dirEntry.path().stem().string()); info.has_value()) {
+                info->filename = file::u8string(dirEntry.path().filename());
+                result.push_back(std::move(*info));
+            }
+        }
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "infra/filesystem.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace emap {
+
+enum class PatternFileType
+{
+    Cams,
+    Ceip,
+    FlandersTable,
+};
+
+// The pollutant and sector names as they appear in the filename of a spatial pattern
+struct PatternFilenameInfo
+{
+    std::string filename;
+    std::string pollutant;
+    std::string sector; // empty for the flanders tables, they contain all the sectors
+};
+
+std::optional<PatternFilenameInfo> identify_pattern_filename(PatternFileType type, std::string_view filename);
+
+/* Persisted listing of the identified spatial pattern files per directory
+ * A listing is reused as long as the modification time and the size of the directory did not change */
+class SpatialPatternManifest
+{
+public:
+    SpatialPatternManifest() = default;
+    // Loads the existing manifest, an invalid or outdated manifest is ignored
+    explicit SpatialPatternManifest(const fs::path& manifestPath);
+
+    // Returns the identified pattern files in the directory, the directory is only scanned if the stored listing is outdated
+    // Can be called concurrently for different directories
+    std::vector<PatternFilenameInfo> list_directory(const fs::path& dir, PatternFileType type);
+
+    // Writes the manifest if any of the listings was updated
+    void save() const;
+
+private:
+    struct DirectoryStamp
+    {
+        int64_t modificationTime = 0;
+        int64_t size             = 0;
+
+        bool operator==(const DirectoryStamp& other) const noexcept
+        {
+            return modificationTime == other.modificationTime && size == other.size;
+        }
+    };
+
+    struct DirectoryListing
+    {
+        PatternFileType type = PatternFileType::Cams;
+        DirectoryStamp stamp;
+        std::vector<PatternFilenameInfo> files;
+    };
+
+    static DirectoryStamp directory_stamp(const fs::path& dir);
+    static std::vector<PatternFilenameInfo> scan_directory(const fs::path& dir, PatternFileType type);
+
+    void load();
+
+    fs::path _path;
+    mutable std::mutex _mutex;
+    bool _modified = false;
+    std::unordered_map<std::string, DirectoryListing> _directories;
+};
+
+}
@@ -3,6 +3,7 @@
 #include "emap/configurationparser.h"
 #include "emap/scalingfactors.h"
 
+#include "emissioninventorysnapshot.h"
 #include "infra/tempdir.h"
 #include "runsummary.h"
 #include "testconfig.h"
@@ -16,13 +17,13 @@ using namespace inf;
 using namespace doctest;
 using namespace date::literals;
 
-static RunConfiguration create_config(const SectorInventory& sectorInv, const PollutantInventory& pollutantInv, const CountryInventory& countryInv)
+static RunConfiguration create_config(const SectorInventory& sectorInv, const PollutantInventory& pollutantInv, const CountryInventory& countryInv, const fs::path& dataPath = "./data")
 {
     RunConfiguration::Output outputConfig;
     outputConfig.path            = "./out";
     outputConfig.outputLevelName = "GNFR";
 
-    return RunConfiguration("./data", {}, {}, {}, {}, ModelGrid::ChimereCams, ValidationType::NoValidation, 2016_y, 2021_y, "test", true, 90.0, {}, sectorInv, pollutantInv, countryInv, outputConfig);
+    return RunConfiguration(dataPath, {}, {}, {}, {}, ModelGrid::ChimereCams, ValidationType::NoValidation, 2016_y, 2021_y, "test", true, 90.0, {}, sectorInv, pollutantInv, countryInv, outputConfig);
 }
 
 static void create_empty_point_source_file(const fs::path& path)
@@ -297,6 +298,109 @@ TEST_CASE("Emission inventory")
         checkEmission(inv, EmissionIdentifier(countries::BEF, EmissionSector(sectors::nfr::Nfr1A3bi), pollutants::PMcoarse), 120.0, 30.0);
         checkEmission(inv, EmissionIdentifier(countries::BEW, EmissionSector(sectors::nfr::Nfr1A3bi), pollutants::PMcoarse), 200.0 - 50.0 /* 150 */, 50.0);
     }
+
+    SUBCASE("Snapshot")
+    {
+        TempDir temp("inventorysnapshot");
+        const auto snapshotPath = temp.path() / "emission_inventory.snapshot";
+
+        const EmissionIdentifier pointId(countries::BEF, EmissionSector(sectors::nfr::Nfr1A3bi), pollutants::PM10);
+        const EmissionIdentifier gnfrId(countries::FR, EmissionSector(sectors::gnfr::Shipping), pollutants::NOx);
+
+        EmissionEntry pointSource(pointId, EmissionValue(50.0), Coordinate(10, 20));
+        pointSource.set_source_id("src");
+        pointSource.set_height(12.0);
+        pointSource.set_dv(3);
+
+        EmissionInventoryEntry pointEntry(pointId, 100.0, {pointSource});
+        pointEntry.set_point_auto_scaling(0.5);
+        pointEntry.set_diffuse_user_scaling(2.0);
+
+        const EmissionInventory inventory(2019_y, {pointEntry, EmissionInventoryEntry(gnfrId, 25.0)});
+
+        RunSummary buildSummary;
+        buildSummary.add_totals_source("totals.txt");
+        buildSummary.add_gnfr_correction(gnfrId, 10.0, 20.0, 0.5);
+        save_emission_inventory_snapshot(snapshotPath, 42, inventory, buildSummary);
+
+        SUBCASE("Identical inputs")
+        {
+            RunSummary loadedSummary;
+            const auto loaded = load_emission_inventory_snapshot(snapshotPath, 42, cfg, loadedSummary);
+            REQUIRE(loaded.has_value());
+            CHECK(loaded->year() == 2019_y);
+            CHECK(loaded->size() == 2);
+            checkEmission(*loaded, pointId, 200.0, 25.0);
+            checkEmission(*loaded, gnfrId, 25.0, 0.0);
+
+            const auto emissions = loaded->emissions_with_id(pointId);
+            REQUIRE(emissions.front().point_emissions().size() == 1);
+            const auto loadedPointSource = emissions.front().point_emissions()[0];
+            CHECK(loadedPointSource.source_id() == "src");
+            CHECK(loadedPointSource.height() == 12.0);
+            CHECK(loadedPointSource.dv() == 3);
+            CHECK(loadedPointSource.coordinate()->x == 10.0);
+            CHECK(loadedPointSource.coordinate()->y == 20.0);
+
+            CHECK(loadedSummary.used_totals_sources().count("totals.txt") == 1);
+            REQUIRE(loadedSummary.gnfr_corrections().size() == 1);
+            CHECK(loadedSummary.gnfr_corrections().front().id == gnfrId);
+            CHECK(loadedSummary.gnfr_corrections().front().correction == 0.5);
+        }
+
+        SUBCASE("Modified inputs")
+        {
+            RunSummary loadedSummary;
+            CHECK_FALSE(load_emission_inventory_snapshot(snapshotPath, 43, cfg, loadedSummary).has_value());
+            CHECK(loadedSummary.used_totals_sources().empty());
+        }
+    }
+
+    SUBCASE("Snapshot fingerprint of the fallback totals")
+    {
+        TempDir temp("inventoryfingerprint");
+        const auto dataCfg = create_config(sectorInventory, pollutantInventory, countryInventory, temp.path());
+
+        // Totals of older reporting years that are read when the data of the reporting year (2021) is missing
+        // they are stored next to the totals of the reporting year
+        const auto gnfrFallbackPath = dataCfg.total_emissions_path_gnfr(2020_y);
+        const auto nfrFallbackPath  = dataCfg.total_emissions_path_nfr(2016_y, 2012_y);
+        CHECK(gnfrFallbackPath.filename() == "gnfr_allyears_2020.txt");
+        CHECK(nfrFallbackPath.filename() == "nfr_2016_2012.txt");
+        CHECK(gnfrFallbackPath.parent_path() == dataCfg.total_emissions_path_gnfr(dataCfg.reporting_year()).parent_path());
+        CHECK(nfrFallbackPath.parent_path() == gnfrFallbackPath.parent_path());
+        fs::create_directories(gnfrFallbackPath.parent_path());
+        file::write_as_text(gnfrFallbackPath, "# gnfr");
+        file::write_as_text(nfrFallbackPath, "# nfr");
+
+        const auto fingerprint = emission_inventory_fingerprint(dataCfg);
+        CHECK(emission_inventory_fingerprint(dataCfg) == fingerprint);
+
+        file::write_as_text(gnfrFallbackPath, "# modified gnfr");
+        const auto gnfrModifiedFingerprint = emission_inventory_fingerprint(dataCfg);
+        CHECK(gnfrModifiedFingerprint != fingerprint);
+
+        file::write_as_text(nfrFallbackPath, "# modified nfr");
+        CHECK(emission_inventory_fingerprint(dataCfg) != gnfrModifiedFingerprint);
+    }
+}
+
+TEST_CASE("Emission key")
+{
+    const EmissionIdentifier id(countries::FR, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::NOx);
+
+    CHECK(id.key() == EmissionIdentifier(countries::FR, EmissionSector(sectors::nfr::Nfr1A1a), Pollutant("NOx", "Other label")).key());
+    CHECK(id.key() != id.with_pollutant(pollutants::CO).key());
+    CHECK(id.key() != id.with_sector(EmissionSector(sectors::nfr::Nfr1A2a)).key());
+    CHECK(id.key() != EmissionIdentifier(countries::AT, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::NOx).key());
+
+    // the key is ordered by country, sector and pollutant
+    CHECK(EmissionIdentifier(countries::AT, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO).key() < id.key());
+    CHECK(id.key() < id.with_sector(EmissionSector(sectors::nfr::Nfr1A2a)).key());
+
+    // nfr and gnfr sectors with the same id are different sectors
+    const NfrSector nfr("1A1a", NfrId(601), sectors::gnfr::PublicPower, "", EmissionDestination::Land);
+    CHECK(id.with_sector(EmissionSector(nfr)).key() != id.with_sector(EmissionSector(sectors::gnfr::PublicPower)).key());
 }
 
 }
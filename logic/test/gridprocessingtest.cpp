@@ -207,6 +207,38 @@ TEST_CASE("Add to raster")
     }
 }
 
+TEST_CASE("Add to raster sub area")
+{
+    constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+    GeoMetadata resultMeta(10, 10, 10000, 15000, 100, nan);
+    GeoMetadata subMeta(2, 3, 10300, 15200, 100, nan);
+
+    const gdx::DenseRaster<double> subArea(subMeta, std::vector<double>{{1.0, nan, 3.0,
+                                                                         4.0, 5.0, nan}});
+
+    gdx::DenseRaster<double> collected(resultMeta, nan);
+    collected[Cell(6, 3)] = 2.0;
+    collected[Cell(6, 4)] = 2.0;
+    collected[Cell(9, 9)] = 2.0;
+
+    add_to_raster(collected, subArea);
+    CHECK(collected[Cell(6, 3)] == 3.0);
+    CHECK(collected[Cell(6, 4)] == 2.0);
+    CHECK(collected[Cell(6, 5)] == 3.0);
+    CHECK(collected[Cell(7, 3)] == 4.0);
+    CHECK(collected[Cell(7, 4)] == 5.0);
+    CHECK(std::isnan(collected[Cell(7, 5)]));
+    CHECK(std::isnan(collected[Cell(5, 3)]));
+    CHECK(collected[Cell(9, 9)] == 2.0);
+
+    gdx::DenseRaster<double> ras(resultMeta, 1.0);
+    CHECK(erase_area_in_raster_and_sum_erased_values(ras, subMeta) == 6.0);
+    CHECK(std::isnan(ras[Cell(6, 3)]));
+    CHECK(std::isnan(ras[Cell(7, 5)]));
+    CHECK(ras[Cell(7, 6)] == 1.0);
+    CHECK(gdx::sum(ras) == 94.0);
+}
+
 TEST_CASE("create_country_coverages BEW 1km")
 {
     // The cutout was one line too big causing emission loss
@@ -13,7 +13,9 @@
 #include "testconstants.h"
 #include "testprinters.h"
 
+#include <array>
 #include <doctest/doctest.h>
+#include <functional>
 
 namespace emap::test {
 
@@ -93,6 +95,45 @@ TEST_CASE("Input parsers")
             CHECK(em.value().unit() == "Gg");
         }
 
+        SUBCASE("byte order mark")
+        {
+            auto emissions = parse_emissions(EmissionSector::Type::Gnfr, file::u8path(TEST_DATA_DIR) / "totals_bom.txt", 1990_y, cfg, RespectIgnoreList::Yes);
+            REQUIRE(emissions.size() == 2);
+            CHECK(emissions.emission_with_id(EmissionIdentifier(countries::TR, EmissionSector(sectors::gnfr::PublicPower), pollutants::CO)).value().amount().value() == Approx(1.82364));
+        }
+
+        SUBCASE("chunk boundaries")
+        {
+            const auto path = file::u8path(TEST_DATA_DIR) / "_input" / "01_data_emissions" / "inventory" / "reporting_2021" / "totals" / "nfr_1990_2021.txt";
+
+            const auto expected = parse_emissions(EmissionSector::Type::Nfr, path, 1990_y, cfg, RespectIgnoreList::Yes);
+            REQUIRE(expected.size() == 9);
+
+            // every line in its own chunk, and chunks that end in the middle of a line
+            for (size_t chunkSize : {size_t(1), size_t(16), size_t(100)}) {
+                const auto emissions = parse_emissions(EmissionSector::Type::Nfr, path, 1990_y, cfg, RespectIgnoreList::Yes, chunkSize);
+                REQUIRE(emissions.size() == expected.size());
+                for (const auto& em : expected) {
+                    CHECK_MESSAGE(emissions.emission_with_id(em.id()).value().amount() == em.value().amount(), fmt::format("{} (chunk size {})", em.id(), chunkSize));
+                }
+            }
+        }
+
+        SUBCASE("chunk boundaries line numbers")
+        {
+            const auto path = file::u8path(TEST_DATA_DIR) / "totals_invalid_line.txt";
+            for (size_t chunkSize : {size_t(1), size_t(16), DefaultParseChunkSize}) {
+                std::string error;
+                try {
+                    parse_emissions(EmissionSector::Type::Gnfr, path, 1990_y, cfg, RespectIgnoreList::Yes, chunkSize);
+                } catch (const std::exception& e) {
+                    error = e.what();
+                }
+
+                CHECK_MESSAGE(error.find("Invalid number of columns on line 5") != std::string::npos, error);
+            }
+        }
+
         SUBCASE("Belgian emissions xlsx (Brussels)")
         {
             auto emissions = parse_emissions_belgium(file::u8path(TEST_DATA_DIR) / "_input" / "01_data_emissions" / "inventory" / "reporting_2021" / "totals" / "BEB_2021.xlsx", date::year(2019), cfg);
@@ -175,6 +216,32 @@ TEST_CASE("Input parsers")
             CHECK(emissions.emission_with_id(EmissionIdentifier(countries::BEW, EmissionSector(sectors::nfr::Nfr1A3biv), pollutants::Hg)).value().amount() == Approx(0.000000167979106942408)); // only present with fuel used
             CHECK(emissions.emissions_with_id(EmissionIdentifier(countries::BEF, EmissionSector(sectors::nfr::Nfr5C1bii), pollutants::NMVOC)).empty());                                         // empty cell
         }
+
+        SUBCASE("Belgian emissions xlsx multiple years")
+        {
+            // all the requested years are read from the same workbook, the result matches reading the years separately
+            const auto path                      = file::u8path(TEST_DATA_DIR) / "_input" / "01_data_emissions" / "inventory" / "reporting_2021" / "totals" / "BEF_2021.xlsx";
+            const std::array<date::year, 2> years = {date::year(2019), date::year(2018)};
+
+            auto emissions = parse_emissions_belgium(path, years, cfg);
+            REQUIRE(emissions.size() == years.size());
+
+            for (size_t i = 0; i < years.size(); ++i) {
+                CHECK(emissions[i].year() == years[i]);
+
+                const auto expected = parse_emissions_belgium(path, years[i], cfg);
+                REQUIRE(emissions[i].size() == expected.size());
+                for (auto& em : expected) {
+                    CHECK(emissions[i].emission_with_id(em.id()).value().amount() == em.value().amount());
+                }
+            }
+
+            CHECK(emissions[0].emission_with_id(EmissionIdentifier(countries::BEF, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::SOx)).value().amount() == Approx(0.476353773));
+
+            // a year without a sheet in the workbook
+            const std::array<date::year, 2> missingYear = {date::year(2019), date::year(1980)};
+            CHECK_THROWS_AS(parse_emissions_belgium(path, missingYear, cfg), RuntimeError);
+        }
     }
 
     SUBCASE("Load point source emissions")
@@ -195,6 +262,8 @@ TEST_CASE("Input parsers")
             {
                 EmissionIdentifier emId(country::BEF, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::NOx);
                 REQUIRE(emissions.emissions_with_id(emId).size() == 2);
+                REQUIRE(emissions.emission_range_with_id(emId).size() == 2);
+                CHECK(emissions.emission_range_with_id(emId.with_pollutant(pollutants::PCBs)).empty());
                 REQUIRE(emissions.emissions_with_id_at_coordinate(emId, Coordinate(148450, 197211)).size() == 1);
                 REQUIRE(emissions.emissions_with_id_at_coordinate(emId, Coordinate(95820, 173080)).size() == 1);
             }
@@ -373,6 +442,26 @@ TEST_CASE("Input parsers")
         const auto spatialPattern = parse_spatial_pattern_flanders(file::u8path(TEST_DATA_DIR) / "_input" / "03_spatial_disaggregation" / "bef" / "reporting_2021" / "2019" / "Emissies per km2 excl puntbrongegevens_2019_NH3.xlsx", EmissionSector(sectors::nfr::Nfr3B1a), cfg);
         CHECK(gdx::sum(spatialPattern) == Approx(18.0750674).epsilon(1e-4));
     }
+
+    SUBCASE("Invalid emission value in spatial pattern")
+    {
+        // the emission of row 3 is not a number, the error mentions the file, row and column
+        const auto path = file::u8path(TEST_DATA_DIR) / "spatial_pattern_flanders_invalid_emission.xlsx";
+
+        auto checkError = [&](const std::function<void()>& parse) {
+            try {
+                parse();
+                FAIL("Expected a parse error");
+            } catch (const RuntimeError& e) {
+                const std::string_view msg(e.what());
+                CHECK(msg.find("spatial_pattern_flanders_invalid_emission.xlsx") != std::string_view::npos);
+                CHECK(msg.find("row 3, column F: 'n/a'") != std::string_view::npos);
+            }
+        };
+
+        checkError([&]() { parse_spatial_pattern_flanders(path, cfg); });
+        checkError([&]() { parse_spatial_pattern_flanders(path, EmissionSector(sectors::nfr::Nfr1A1a), cfg); });
+    }
 }
 
 }
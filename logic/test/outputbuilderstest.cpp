@@ -1,18 +1,34 @@
 ﻿#include "emap/configurationparser.h"
 #include "emap/outputbuilderfactory.h"
+#include "emap/griddefinition.h"
+#include "emap/pointsourcetable.h"
+#include "emap/sparseraster.h"
 
+#include "infra/cast.h"
 #include "infra/test/tempdir.h"
 #include "testconfig.h"
 #include "testconstants.h"
 
 #include <doctest/doctest.h>
 
+#include <array>
+#include <limits>
+
 namespace emap::test {
 
 using namespace inf;
 using namespace date;
 using namespace doctest;
 
+// The output builders read the point sources from a point source table
+static void add_point_output_entries(IOutputBuilder& builder, const std::vector<EmissionEntry>& entries)
+{
+    const PointSourceTable points(entries);
+    for (const auto point : points) {
+        builder.add_point_output_entry(point);
+    }
+}
+
 static RunConfiguration create_config(const SectorInventory& sectorInv, const PollutantInventory& pollutantInv, const CountryInventory& countryInv, ModelGrid grid, const fs::path& outputDir, bool poinSourcesSeparate)
 {
     RunConfiguration::Output outputConfig;
@@ -42,6 +58,57 @@ TEST_CASE("Output builders")
         outputBuilder->flush(IOutputBuilder::WriteMode::Create);
     }
 
+    SUBCASE("Vlops diffuse raster")
+    {
+        // The raster entries have to result in the same output as adding the cells one by one
+        const auto cellDir   = tempDir.path() / "cells";
+        const auto rasterDir = tempDir.path() / "raster";
+        fs::create_directories(cellDir);
+        fs::create_directories(rasterDir);
+
+        const auto cellCfg   = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Vlops1km, cellDir, true);
+        const auto rasterCfg = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Vlops1km, rasterDir, true);
+
+        const auto& meta = grid_data(grids_for_model_grid(ModelGrid::Vlops1km).front()).meta;
+        SparseRaster raster(meta);
+        raster.add_to_cells({
+            {Cell(10, 10), 2.0},
+            {Cell(10, 11), 3.0},
+            {Cell(20, 5), 0.0},
+            {Cell(30, 40), 0.5},
+        });
+
+        // the same cells are added for two sectors and for another country
+        const std::array<EmissionIdentifier, 3> ids = {
+            EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO),
+            EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO),
+            EmissionIdentifier(countries::BEF, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO),
+        };
+
+        auto cellBuilder   = make_output_builder(cellCfg);
+        auto rasterBuilder = make_output_builder(rasterCfg);
+        for (const auto& id : ids) {
+            for (size_t i = 0; i < raster.size(); ++i) {
+                if (raster.value(i) == 0.0) {
+                    continue;
+                }
+
+                const auto cellCenter = meta.convert_cell_centre_to_xy(raster.cell(i));
+                cellBuilder->add_diffuse_output_entry(id, Point<double>(cellCenter.x, cellCenter.y), raster.value(i), truncate<int32_t>(meta.cell_size_x()));
+            }
+
+            rasterBuilder->add_diffuse_output_entries(id, raster);
+        }
+
+        cellBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
+        rasterBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
+
+        const auto cellOutput   = file::read_as_text(cellDir / "CO_OPS_2016.brn");
+        const auto rasterOutput = file::read_as_text(rasterDir / "CO_OPS_2016.brn");
+        CHECK(!rasterOutput.empty());
+        CHECK(rasterOutput == cellOutput);
+    }
+
     SUBCASE("Chimere separate points")
     {
         const auto cfg     = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Chimere05deg, tempDir.path(), true);
@@ -49,7 +116,7 @@ TEST_CASE("Output builders")
 
         outputBuilder->add_diffuse_output_entry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), Point<double>(5.0, 35.0), 2.0, 1000);
         outputBuilder->add_diffuse_output_entry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO), Point<double>(5.0, 36.0), 3.0, 1000);
-        outputBuilder->add_point_output_entry(EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), EmissionValue(4.0), Point<double>(5.0, 36.0)));
+        add_point_output_entries(*outputBuilder, {EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), EmissionValue(4.0), Point<double>(5.0, 36.0))});
 
         outputBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
         outputBuilder->flush(IOutputBuilder::WriteMode::Create);
@@ -76,6 +143,61 @@ TEST_CASE("Output builders")
         CHECK(pointLines[2].empty());
     }
 
+    SUBCASE("Chimere diffuse raster")
+    {
+        const auto cfg     = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Chimere05deg, tempDir.path(), true);
+        auto outputBuilder = make_output_builder(cfg);
+
+        const auto& meta = grid_data(grids_for_model_grid(cfg.model_grid()).front()).meta;
+        SparseRaster raster(meta);
+        raster.add_to_cells({
+            {meta.convert_point_to_cell(Point<double>(5.0, 35.0)), 2.0},
+            {meta.convert_point_to_cell(Point<double>(5.0, 36.0)), 3.0},
+            {meta.convert_point_to_cell(Point<double>(6.0, 36.0)), 0.0},
+        });
+
+        outputBuilder->add_diffuse_output_entries(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), raster);
+        outputBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
+
+        auto diffuseLines = file::read_lines(tempDir.path() / "output_Chimere_05deg_CO_2016.dat");
+        REQUIRE(diffuseLines.size() == 3);
+
+        auto hasLineStartingWith = [&](std::string_view prefix) {
+            return std::any_of(diffuseLines.begin(), diffuseLines.end(), [prefix](const std::string& line) {
+                return line.starts_with(prefix);
+            });
+        };
+
+        // the cell with a zero value is not written
+        CHECK(hasLineStartingWith("   1   32    1  2.000e+03  0.000e+00"));
+        CHECK(hasLineStartingWith("   1   32    3  3.000e+03  0.000e+00"));
+        CHECK(diffuseLines[2].empty());
+    }
+
+    SUBCASE("Chimere diffuse raster outside of the grid")
+    {
+        const auto cfg     = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Chimere05deg, tempDir.path(), true);
+        auto outputBuilder = make_output_builder(cfg);
+
+        // a country without chimere country mapping, all of its cells are outside of the chimere grid
+        const Country unmappedCountry(CountryId(99), "XX", "Unmapped", true);
+        const GeoMetadata meta(2, 2, 150.0, -60.0, 0.5, std::numeric_limits<double>::quiet_NaN());
+        REQUIRE(!grid_data(grids_for_model_grid(cfg.model_grid()).front()).meta.is_on_map(meta.convert_cell_centre_to_xy(Cell(0, 0))));
+
+        SparseRaster raster(meta);
+        raster.add_to_cells({
+            {Cell(0, 0), 2.0},
+            {Cell(1, 1), 3.0},
+        });
+
+        CHECK_NOTHROW(outputBuilder->add_diffuse_output_entries(EmissionIdentifier(unmappedCountry, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), raster));
+        CHECK_NOTHROW(outputBuilder->add_diffuse_output_entry(EmissionIdentifier(unmappedCountry, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), Point<double>(150.25, -59.75), 2.0, 1000));
+        outputBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
+
+        // there are no diffuse emissions to write
+        CHECK(!fs::exists(tempDir.path() / "output_Chimere_05deg_CO_2016.dat"));
+    }
+
     SUBCASE("Chimere merged points")
     {
         const auto cfg     = create_config(sectorInventory, pollutantInventory, countryInventory, ModelGrid::Chimere05deg, tempDir.path(), false);
@@ -83,8 +205,7 @@ TEST_CASE("Output builders")
 
         outputBuilder->add_diffuse_output_entry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), Point<double>(5.0, 35.0), 2.0, 1000);
         outputBuilder->add_diffuse_output_entry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO), Point<double>(5.0, 36.0), 3.0, 1000);
-        outputBuilder->add_point_output_entry(EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), EmissionValue(4.0), Point<double>(5.0, 36.0)));
-        outputBuilder->add_point_output_entry(EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO), EmissionValue(5.0), Point<double>(5.0, 36.0)));
+        add_point_output_entries(*outputBuilder, {EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::CO), EmissionValue(4.0), Point<double>(5.0, 36.0)), EmissionEntry(EmissionIdentifier(countries::AL, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::CO), EmissionValue(5.0), Point<double>(5.0, 36.0))});
 
         outputBuilder->flush_pollutant(pollutants::CO, IOutputBuilder::WriteMode::Create);
         outputBuilder->flush(IOutputBuilder::WriteMode::Create);
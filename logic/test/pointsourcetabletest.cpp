@@ -0,0 +1,99 @@
+#include "emap/pointsourcetable.h"
+
+#include "testconstants.h"
+
+#include <doctest/doctest.h>
+
+namespace emap::test {
+
+using namespace inf;
+using namespace doctest;
+
+TEST_CASE("Point source table")
+{
+    const EmissionIdentifier id(countries::BEF, EmissionSector(sectors::nfr::Nfr1A3bi), pollutants::PM10);
+
+    EmissionEntry entry1(id, EmissionValue(2.0), Coordinate(100.0, 200.0));
+    entry1.set_source_id("src1");
+    entry1.set_height(10.0);
+    entry1.set_diameter(1.5);
+    entry1.set_temperature(80.0);
+    entry1.set_warmth_contents(0.5);
+    entry1.set_flow_rate(12.0);
+    entry1.set_dv(4);
+
+    EmissionEntry entry2(id, EmissionValue(), Coordinate(300.0, 400.0));
+    entry2.set_source_id("src2");
+
+    EmissionEntry entry3(id, EmissionValue(3.0), Coordinate(100.0, 200.0));
+    entry3.set_source_id("src1");
+
+    const PointSourceTable table(std::vector<EmissionEntry>{entry1, entry2, entry3});
+    REQUIRE(table.size() == 3);
+    CHECK(!table.empty());
+    CHECK(table.amount_sum() == 5.0);
+
+    SUBCASE("Row access")
+    {
+        const auto row = table[0];
+        CHECK(row.id() == id);
+        CHECK(row.value().amount() == 2.0);
+        CHECK(row.coordinate() == Coordinate(100.0, 200.0));
+        CHECK(row.height() == 10.0);
+        CHECK(row.diameter() == 1.5);
+        CHECK(row.temperature() == 80.0);
+        CHECK(row.warmth_contents() == 0.5);
+        CHECK(row.flow_rate() == 12.0);
+        CHECK(row.dv() == 4);
+        CHECK(row.source_id() == "src1");
+
+        CHECK(!table[1].value().amount().has_value());
+        CHECK(!table[1].dv().has_value());
+        CHECK(table[1].source_id() == "src2");
+        CHECK(table[2].source_id() == "src1");
+
+        const auto entry = table[0].to_entry();
+        CHECK(entry.id() == id);
+        CHECK(entry.source_id() == "src1");
+        CHECK(entry.height() == 10.0);
+        CHECK(entry.dv() == 4);
+    }
+
+    SUBCASE("Iterate")
+    {
+        double sum = 0.0;
+        size_t count = 0;
+        for (const auto row : table) {
+            sum += row.value().amount().value_or(0.0);
+            ++count;
+        }
+
+        CHECK(count == 3);
+        CHECK(sum == 5.0);
+    }
+
+    SUBCASE("Scaled")
+    {
+        const auto scaled = table.scaled(0.5);
+        CHECK(scaled.amount_sum() == 2.5);
+        CHECK(scaled[0].value().amount() == 1.0);
+        // missing amounts become 0
+        CHECK(scaled[1].value().amount() == 0.0);
+        CHECK(scaled[2].source_id() == "src1");
+        // the original table is not modified
+        CHECK(table[0].value().amount() == 2.0);
+    }
+
+    SUBCASE("Copy rows")
+    {
+        PointSourceTable copy;
+        copy.push_back(table[2]);
+        copy.push_back(table[0]);
+        REQUIRE(copy.size() == 2);
+        CHECK(copy[0].source_id() == "src1");
+        CHECK(copy[0].value().amount() == 3.0);
+        CHECK(copy[1].height() == 10.0);
+        CHECK(copy.amount_sum() == 5.0);
+    }
+}
+}
@@ -0,0 +1,230 @@
+#include "rasterwriter.h"
+#include "runsummary.h"
+#include "xlsxreader.h"
+
+#include "gdx/denserasterio.h"
+#include "infra/string.h"
+#include "infra/test/tempdir.h"
+
+#include <doctest/doctest.h>
+#include <gdal.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace emap::test {
+
+using namespace inf;
+using namespace doctest;
+
+static std::string image_structure_metadata(GDALDatasetH ds, const char* name)
+{
+    const char* value = GDALGetMetadataItem(ds, name, "IMAGE_STRUCTURE");
+    return value == nullptr ? std::string() : std::string(value);
+}
+
+static gdx::DenseRaster<double> create_raster(double value)
+{
+    return gdx::DenseRaster<double>(GeoMetadata(4, 5, 10000, 15000, 100, std::numeric_limits<double>::quiet_NaN()), value);
+}
+
+TEST_CASE("Raster writer")
+{
+    TempDir tempDir("rasterwriter");
+    RunSummary summary;
+
+    constexpr size_t producerCount       = 4;
+    constexpr size_t rastersPerProducer  = 5;
+    constexpr size_t writerThreadCount   = 3;
+    constexpr size_t writerQueueCapacity = 1;
+
+    auto rasterPath = [&](size_t producer, size_t index) {
+        return tempDir.path() / fmt::format("raster_{}_{}.tif", producer, index);
+    };
+
+    auto checkRasters = [&]() {
+        for (size_t producer = 0; producer < producerCount; ++producer) {
+            for (size_t i = 0; i < rastersPerProducer; ++i) {
+                const auto path = rasterPath(producer, i);
+                REQUIRE_MESSAGE(fs::is_regular_file(path), str::from_u8(path.u8string()));
+                CHECK(gdx::read_dense_raster<double>(path)[Cell(3, 4)] == double(producer * rastersPerProducer + i));
+            }
+        }
+    };
+
+    // Multiple threads queue rasters concurrently, with a queue capacity of 1 the writes block until a writer thread takes the queued raster
+    auto writeRasters = [&](RasterWriter& writer) {
+        std::vector<std::thread> producers;
+        for (size_t producer = 0; producer < producerCount; ++producer) {
+            producers.emplace_back([&, producer]() {
+                for (size_t i = 0; i < rastersPerProducer; ++i) {
+                    writer.write(create_raster(double(producer * rastersPerProducer + i)), rasterPath(producer, i));
+                }
+            });
+        }
+
+        for (auto& producer : producers) {
+            producer.join();
+        }
+    };
+
+    SUBCASE("Wait until done")
+    {
+        RasterWriter writer(summary, RasterOutputOptions(), writerThreadCount, writerQueueCapacity);
+        writeRasters(writer);
+        writer.wait_until_done();
+
+        checkRasters();
+        CHECK(summary.raster_write_errors().empty());
+    }
+
+    SUBCASE("Destructor writes the queued rasters")
+    {
+        {
+            RasterWriter writer(summary, RasterOutputOptions(), writerThreadCount, writerQueueCapacity);
+            writeRasters(writer);
+        }
+
+        checkRasters();
+        CHECK(summary.raster_write_errors().empty());
+    }
+
+    SUBCASE("Write failure")
+    {
+        // the parent of the output path is a file, the raster can not be written
+        const auto blockingFile = tempDir.path() / "not_a_directory";
+        file::write_as_text(blockingFile, "");
+        const auto invalidPath = blockingFile / "raster.tif";
+        const auto validPath   = tempDir.path() / "raster.tif";
+
+        RasterWriter writer(summary, RasterOutputOptions(), writerThreadCount, writerQueueCapacity);
+        CHECK_NOTHROW(writer.write(create_raster(1.0), invalidPath));
+        CHECK_NOTHROW(writer.write(create_raster(2.0), validPath));
+        writer.wait_until_done();
+
+        // the other rasters are still written
+        CHECK(fs::is_regular_file(validPath));
+
+        REQUIRE(summary.raster_write_errors().size() == 1);
+        CHECK(summary.raster_write_errors().front().first == invalidPath);
+        CHECK(!summary.raster_write_errors().front().second.empty());
+
+        summary.write_summary(tempDir.path());
+
+        const xl::WorkBookReader workbook(tempDir.path() / "summary.xlsx");
+        const auto& sheets = workbook.sheet_names();
+        REQUIRE(std::find(sheets.begin(), sheets.end(), "raster write errors") != sheets.end());
+
+        std::vector<std::string> errorPaths;
+        workbook.read_sheet(
+            "raster write errors",
+            [](const xl::Row& /*header*/) {},
+            [&](const xl::Row& row) {
+                errorPaths.emplace_back(row.as_string_view(0));
+            });
+
+        REQUIRE(errorPaths.size() == 1);
+        CHECK(errorPaths.front() == str::from_u8(invalidPath.u8string()));
+    }
+}
+
+TEST_CASE("Raster creation options")
+{
+    RasterOutputOptions options;
+    CHECK(geotiff_creation_options(options, 4).empty());
+
+    SUBCASE("Tiled")
+    {
+        options.tiled    = true;
+        options.tileSize = 512;
+        CHECK(geotiff_creation_options(options, 4) == std::vector<std::string>{"TILED=YES", "BLOCKXSIZE=512", "BLOCKYSIZE=512"});
+    }
+
+    SUBCASE("Compressed")
+    {
+        options.compression = RasterCompression::Deflate;
+        CHECK(geotiff_creation_options(options, 4) == std::vector<std::string>{"COMPRESS=DEFLATE", "NUM_THREADS=4", "BIGTIFF=IF_SAFER"});
+
+        options.compression = RasterCompression::Zstd;
+        options.predictor   = true;
+        options.tiled       = true;
+        CHECK(geotiff_creation_options(options, 2) == std::vector<std::string>{"TILED=YES", "BLOCKXSIZE=256", "BLOCKYSIZE=256", "COMPRESS=ZSTD", "PREDICTOR=3", "NUM_THREADS=2", "BIGTIFF=IF_SAFER"});
+    }
+
+    SUBCASE("Cloud optimized")
+    {
+        options.cloudOptimized = true;
+        options.compression    = RasterCompression::Deflate;
+        options.predictor      = true;
+        CHECK(cog_creation_options(options, 3) == std::vector<std::string>{"BLOCKSIZE=256", "COMPRESS=DEFLATE", "PREDICTOR=FLOATING_POINT", "OVERVIEWS=AUTO", "OVERVIEW_RESAMPLING=AVERAGE", "NUM_THREADS=3", "BIGTIFF=IF_SAFER"});
+
+        options.compression = RasterCompression::None;
+        options.predictor   = false;
+        CHECK(cog_creation_options(options, 1) == std::vector<std::string>{"BLOCKSIZE=256", "COMPRESS=NONE", "OVERVIEWS=AUTO", "OVERVIEW_RESAMPLING=AVERAGE", "NUM_THREADS=1", "BIGTIFF=IF_SAFER"});
+    }
+}
+
+TEST_CASE("Raster writer output options")
+{
+    TempDir tempDir("rasterwriteroptions");
+    RunSummary summary;
+
+    RasterOutputOptions options;
+    options.compression = RasterCompression::Deflate;
+    options.predictor   = true;
+    options.tiled       = true;
+    options.tileSize    = 16;
+
+    SUBCASE("Tiled with overviews")
+    {
+        options.overviews = true;
+    }
+
+    SUBCASE("Cloud optimized")
+    {
+        options.cloudOptimized = true;
+        options.overviews      = true;
+    }
+
+    const auto path = tempDir.path() / "raster.tif";
+    {
+        RasterWriter writer(summary, options, 1, 1);
+        writer.write(gdx::DenseRaster<double>(GeoMetadata(40, 50, 10000, 15000, 100, std::numeric_limits<double>::quiet_NaN()), 3.0), path);
+    }
+
+    CHECK(summary.raster_write_errors().empty());
+    REQUIRE(fs::is_regular_file(path));
+    CHECK(gdx::read_dense_raster<double>(path)[Cell(39, 49)] == 3.0);
+
+    {
+        // verify that the creation options were applied to the written file
+        auto* ds = GDALOpen(str::from_u8(path.u8string()).c_str(), GA_ReadOnly);
+        REQUIRE(ds != nullptr);
+
+        CHECK(image_structure_metadata(ds, "COMPRESSION") == "DEFLATE");
+        CHECK(image_structure_metadata(ds, "PREDICTOR") == "3");
+        if (options.cloudOptimized) {
+            CHECK(image_structure_metadata(ds, "LAYOUT") == "COG");
+        }
+
+        auto* band     = GDALGetRasterBand(ds, 1);
+        int blockXSize = 0;
+        int blockYSize = 0;
+        GDALGetBlockSize(band, &blockXSize, &blockYSize);
+        CHECK(blockXSize == 16);
+        CHECK(blockYSize == 16);
+        CHECK(GDALGetOverviewCount(band) > 0);
+
+        GDALClose(ds);
+    }
+
+    // the temporary file of the cloud optimized output is removed
+    auto tempPath = path;
+    tempPath += ".tmp.tif";
+    CHECK(!fs::exists(tempPath));
+}
+
+}
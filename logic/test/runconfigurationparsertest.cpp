@@ -1,4 +1,5 @@
 ﻿#include "emap/configurationparser.h"
+#include "emap/ignoredname.h"
 #include "emap/runconfiguration.h"
 #include "infra/exception.h"
 #include "testconstants.h"
@@ -7,6 +8,9 @@
 
 #include <doctest/doctest.h>
 
+#include <algorithm>
+#include <array>
+
 namespace emap::test {
 
 using namespace inf;
@@ -56,11 +60,44 @@ TEST_CASE("Parse run configuration")
 
         CHECK(config.output_path() == expectedOutput);
         CHECK(config.validation_type() == ValidationType::SumValidation);
+        CHECK(config.output_raster_options().is_default());
+        CHECK(config.single_precision_spatial_patterns() == false);
 
         CHECK(config.included_pollutants() == container_as_vector(config.pollutants().list()));
 
         CHECK(config.sectors().nfr_sector_from_string("1A3di(ii)").destination() == EmissionDestination::Eez);
         CHECK(config.sectors().nfr_sector_from_string("1A3di(ii)").has_land_destination());
+
+        // pollutant codes are case insensitive, country codes have to match exactly
+        CHECK(config.pollutants().pollutant_from_string("nox") == pollutants::NOx);
+        CHECK(config.pollutants().pollutant_from_string("pm10") == pollutants::PM10);
+        CHECK(config.countries().try_country_from_string("BEF") == countries::BEF);
+        CHECK(!config.countries().try_country_from_string("bef").has_value());
+        CHECK(!config.sectors().try_nfr_sector_from_string("not a sector").has_value());
+
+        // the names in names_to_be_ignored.xlsx, no country exceptions are configured
+        CHECK(config.sectors().is_ignored_nfr_sector("1A3ai(ii)", countries::BEF));
+        CHECK(config.sectors().is_ignored_nfr_sector("1a5C", countries::FR));
+        CHECK(config.sectors().is_ignored_nfr_sector("11C", countries::TR));
+        CHECK(!config.sectors().is_ignored_nfr_sector("1A1a", countries::BEF));
+        CHECK(!config.sectors().is_ignored_nfr_sector("1A3di(ii)", countries::BEF));
+        CHECK(config.sectors().is_ignored_gnfr_sector("z_memo", countries::DE));
+        CHECK(config.sectors().is_ignored_gnfr_sector("P_IntShipping", countries::NL));
+        CHECK(!config.sectors().is_ignored_gnfr_sector("A_PublicPower", countries::NL));
+        CHECK(config.pollutants().is_ignored_pollutant("pmcoarse", countries::BEF));
+        CHECK(!config.pollutants().is_ignored_pollutant("PM10", countries::BEF));
+
+        // the precompiled ignore rules of the configured sectors match the ignore list
+        constexpr std::array<std::string_view, 8> ignoredNfrCodes = {"1A3ai(ii)", "1A3aii(ii)", "1A3di(i)", "1A5c", "6B", "11A", "11B", "11C"};
+        for (const auto& sector : config.sectors().nfr_sectors()) {
+            const bool expected = std::any_of(ignoredNfrCodes.begin(), ignoredNfrCodes.end(), [&](std::string_view code) {
+                return str::iequals(code, sector.code());
+            });
+
+            for (const auto& country : config.countries().list()) {
+                CHECK_MESSAGE(config.sectors().is_ignored_nfr_sector(sector, country) == expected, std::string(sector.code()));
+            }
+        }
     }
 
     SUBCASE("valid file with specified pollutants")
@@ -133,6 +170,77 @@ TEST_CASE("Parse run configuration")
         CHECK(config.total_emissions_path_nfr(1990_y, config.reporting_year()) == expectedDataRoot / "01_data_emissions" / "inventory" / "reporting_2021" / "totals" / "nfr_1990_2021.txt");
     }
 
+    SUBCASE("single precision spatial patterns")
+    {
+        constexpr std::string_view tomlConfig = R"toml(
+            [model]
+                grid = "vlops1km"
+                datapath = "_input"
+                year = 2020
+                report_year = 2018
+
+            [output]
+                path = "/temp"
+                sector_level = "GNFR"
+
+            [options]
+                single_precision_spatial_patterns = true
+        )toml";
+
+        const auto config = parse_run_configuration(tomlConfig, file::u8path(TEST_DATA_DIR));
+        CHECK(config.single_precision_spatial_patterns());
+        CHECK(config.validation_type() == ValidationType::NoValidation);
+    }
+
+    SUBCASE("raster output options")
+    {
+        constexpr std::string_view tomlConfig = R"toml(
+            [model]
+                grid = "vlops1km"
+                datapath = "_input"
+                year = 2020
+                report_year = 2018
+
+            [output]
+                path = "/temp"
+                sector_level = "GNFR"
+                raster_compression = "ZSTD"
+                raster_tile_size = 512
+                raster_predictor = true
+                cloud_optimized_rasters = true
+        )toml";
+
+        const auto config = parse_run_configuration(tomlConfig, file::u8path(TEST_DATA_DIR));
+
+        const auto& options = config.output_raster_options();
+        CHECK(options.compression == RasterCompression::Zstd);
+        CHECK(options.tileSize == 512);
+        CHECK(options.predictor);
+        CHECK(options.cloudOptimized);
+        // the cloud optimized layout implies tiles and overviews
+        CHECK(options.tiled);
+        CHECK(options.overviews);
+        CHECK(!options.is_default());
+    }
+
+    SUBCASE("invalid file: raster compression")
+    {
+        constexpr std::string_view tomlConfig = R"toml(
+            [model]
+                grid = "vlops1km"
+                datapath = "_input"
+                year = 2020
+                report_year = 2018
+
+            [output]
+                path = "/temp"
+                sector_level = "GNFR"
+                raster_compression = "lzw"
+        )toml";
+
+        CHECK_THROWS_WITH_AS(parse_run_configuration(tomlConfig, file::u8path(TEST_DATA_DIR)), "Invalid raster compression: 'lzw' (possible values: \"none\", \"deflate\", \"zstd\")", RuntimeError);
+    }
+
     SUBCASE("invalid file: empty")
     {
         CHECK_THROWS_AS(parse_run_configuration("", file::u8path(TEST_DATA_DIR)), RuntimeError);
@@ -202,4 +310,41 @@ TEST_CASE("Parse run configuration")
         CHECK_THROWS_WITH_AS(parse_run_configuration(fmt::format(tomlConfig, str::from_u8(scaleFactors.generic_u8string())), file::u8path(TEST_DATA_DIR)), "'scenario' key value in 'model' section should be a quoted string (e.g. scenario = \"value\")", RuntimeError);
     }
 }
+
+TEST_CASE("Ignored names")
+{
+    const CountryId otherCountry(300);
+
+    // The same name can be configured multiple times, the name is ignored when one of the rules ignores it
+    const IgnoredNames ignored(std::vector<IgnoredName>{
+        IgnoredName("1A1a", {countries::FR.id(), countries::DE.id()}),
+        IgnoredName("1a1A", {countries::DE.id(), countries::NL.id()}),
+        IgnoredName("1A2a", {}),
+        IgnoredName("1A3b", {CountryId(200)}),
+    });
+
+    CHECK(ignored.is_ignored_for_country("1A1a", countries::FR.id()));
+    CHECK(!ignored.is_ignored_for_country("1A1A", countries::DE.id()));
+    CHECK(ignored.is_ignored_for_country("1a1a", countries::NL.id()));
+    CHECK(ignored.is_ignored_for_country("1A1a", countries::TR.id()));
+    CHECK(ignored.is_ignored_for_country("1A1a", otherCountry));
+
+    CHECK(ignored.is_ignored_for_country("1A2a", countries::DE.id()));
+    CHECK(ignored.is_ignored_for_country("1A2a", otherCountry));
+
+    CHECK(!ignored.is_ignored_for_country("1A3b", CountryId(200)));
+    CHECK(ignored.is_ignored_for_country("1A3b", CountryId(199)));
+    CHECK(ignored.is_ignored_for_country("1A3b", countries::FR.id()));
+    CHECK(ignored.is_ignored_for_country("1A3b", otherCountry));
+
+    CHECK(!ignored.is_ignored_for_country("1A4", countries::FR.id()));
+    CHECK(!ignored.row("1A4").has_value());
+
+    // the rows refer to the same bits as the names
+    REQUIRE(ignored.row("1A1A").has_value());
+    CHECK(ignored.row("1A1A") == ignored.row("1a1a"));
+    CHECK(!ignored.is_ignored_for_country(*ignored.row("1A1a"), countries::DE.id()));
+    CHECK(ignored.is_ignored_for_country(*ignored.row("1A1a"), countries::NL.id()));
+    CHECK(!ignored.is_ignored_for_country(*ignored.row("1A3b"), CountryId(200)));
+}
 }
@@ -0,0 +1,128 @@
+#include "emap/gridprocessing.h"
+#include "emap/sparseraster.h"
+
+#include "gdx/algo/sum.h"
+#include "gdx/denseraster.h"
+
+#include <doctest/doctest.h>
+
+namespace emap::test {
+
+using namespace inf;
+using namespace doctest;
+
+TEST_CASE("Sparse raster")
+{
+    constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+    GeoMetadata meta(3, 4, 10000, 15000, 100, nan);
+
+    gdx::DenseRaster<double> dense(meta, std::vector<double>{{1.0, nan, nan, 2.0,
+                                                              nan, 3.0, nan, nan,
+                                                              nan, nan, 0.0, 4.0}});
+
+    SparseRaster raster(dense);
+    CHECK(!raster.empty());
+    CHECK(raster.size() == 5);
+    CHECK(raster.sum() == 10.0);
+    CHECK(raster.cell(1) == Cell(0, 3));
+    CHECK(raster.value(1) == 2.0);
+
+    SUBCASE("Convert to dense")
+    {
+        const auto result = raster.to_dense();
+        REQUIRE(result.size() == dense.size());
+        for (int32_t r = 0; r < meta.rows; ++r) {
+            for (int32_t c = 0; c < meta.cols; ++c) {
+                CHECK(result.is_nodata(Cell(r, c)) == dense.is_nodata(Cell(r, c)));
+                if (!dense.is_nodata(Cell(r, c))) {
+                    CHECK(result[Cell(r, c)] == dense[Cell(r, c)]);
+                }
+            }
+        }
+    }
+
+    SUBCASE("Add to cells")
+    {
+        raster.add_to_cells({{Cell(2, 3), 1.0}, {Cell(0, 1), 5.0}, {Cell(0, 1), 1.0}});
+        CHECK(raster.size() == 6);
+        CHECK(raster.sum() == 17.0);
+        CHECK(raster.cell(1) == Cell(0, 1));
+        CHECK(raster.value(1) == 6.0);
+        CHECK(raster.value(5) == 5.0);
+
+        CHECK_THROWS(raster.add_to_cells({{Cell(3, 0), 1.0}}));
+    }
+
+    SUBCASE("Normalize")
+    {
+        normalize_raster(raster);
+        CHECK(raster.sum() == Approx(1.0));
+        CHECK(raster.value(0) == Approx(0.1));
+    }
+
+    SUBCASE("Sub raster")
+    {
+        // bottom right 2x2 cells
+        const auto sub = raster.sub_raster(GeoMetadata(2, 2, 10200, 15000, 100, nan));
+        CHECK(sub.size() == 2);
+        CHECK(sub.cell(0) == Cell(1, 0));
+        CHECK(sub.sum() == 4.0);
+    }
+
+    SUBCASE("Erase area")
+    {
+        // the top 2 rows, the extent is larger than the raster
+        CHECK(erase_area_in_raster_and_sum_erased_values(raster, GeoMetadata(4, 6, 9800, 15100, 100, nan)) == 6.0);
+        CHECK(raster.size() == 2);
+        CHECK(raster.sum() == 4.0);
+        CHECK(erase_area_in_raster_and_sum_erased_values(raster, GeoMetadata(2, 2, 20000, 20000, 100, nan)) == 0.0);
+    }
+
+    SUBCASE("Add to dense raster")
+    {
+        GeoMetadata gridMeta(10, 10, 9800, 14800, 100, nan);
+        gdx::DenseRaster<double> grid(gridMeta, nan);
+        grid[Cell(5, 2)] = 1.0;
+
+        add_to_raster(grid, raster);
+        add_to_raster(grid, raster);
+        CHECK(gdx::sum(grid) == 21.0);
+        CHECK(grid[Cell(5, 2)] == 3.0);
+        CHECK(grid[Cell(7, 5)] == 8.0);
+        CHECK(grid.is_nodata(Cell(5, 3)));
+    }
+
+    SUBCASE("Single precision")
+    {
+        raster.set_precision(SparseRaster::Precision::Single);
+        CHECK(raster.precision() == SparseRaster::Precision::Single);
+        CHECK(raster.size() == 5);
+        CHECK(raster.sum() == 10.0);
+
+        raster *= 0.1;
+        CHECK(raster.value(0) == Approx(0.1).epsilon(1e-7));
+        CHECK(raster.sub_raster(GeoMetadata(2, 2, 10200, 15000, 100, nan)).precision() == SparseRaster::Precision::Single);
+
+        raster.add_to_cells({{Cell(0, 1), 1.0}});
+        CHECK(raster.size() == 6);
+        CHECK(raster.sum() == Approx(2.0).epsilon(1e-6));
+
+        gdx::DenseRaster<float> denseFloat(meta, std::vector<float>{{1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f}});
+        SparseRaster fromFloat(denseFloat);
+        CHECK(fromFloat.precision() == SparseRaster::Precision::Single);
+        CHECK(fromFloat.sum() == 78.0);
+    }
+
+    SUBCASE("Empty")
+    {
+        SparseRaster empty;
+        CHECK(empty.empty());
+        CHECK(empty.contains_only_nodata());
+
+        SparseRaster noData(meta);
+        CHECK(!noData.empty());
+        CHECK(noData.contains_only_nodata());
+        CHECK(noData.to_dense().contains_only_nodata());
+    }
+}
+}
@@ -1,12 +1,17 @@
 ﻿#include "spatialpatterninventory.h"
+#include "spatialpatternmanifest.h"
 #include "emap/configurationparser.h"
 #include "emap/countryborders.h"
 #include "emap/gridprocessing.h"
+#include "infra/test/tempdir.h"
 #include "testconfig.h"
 #include "testconstants.h"
 #include "testprinters.h"
 
+#include <algorithm>
+#include <chrono>
 #include <doctest/doctest.h>
+#include <unordered_map>
 
 namespace emap::test {
 
@@ -269,4 +274,232 @@ TEST_CASE("Spatial pattern selection test")
     }
 }
 
+
+TEST_CASE("Spatial pattern contents key")
+{
+    const auto path = file::u8path(TEST_DATA_DIR) / "spatialinventory" / "bef" / "reporting_2021" / "2019" / "Emissies per km2 excl puntbrongegevens_2019_NH3.xlsx";
+    const EmissionIdentifier id(countries::BEF, EmissionSector(sectors::nfr::Nfr1A1a), pollutants::NH3);
+
+    CountryCellCoverage coverage;
+    coverage.country             = countries::BEF;
+    coverage.outputSubgridExtent = grid_data(GridDefinition::Flanders1km).meta;
+
+    // the same flanders table, once selected as regular pattern and once via an exception
+    const auto regular   = SpatialPatternSource::create_from_flanders(path, id, id, 2019_y, false);
+    const auto exception = SpatialPatternSource::create_from_flanders(path, id, id, 2019_y, true);
+
+    for (bool includeGrid : {true, false}) {
+        const auto regularKey   = pattern_contents_key(regular, coverage, includeGrid);
+        const auto exceptionKey = pattern_contents_key(exception, coverage, includeGrid);
+
+        CHECK(regularKey == pattern_contents_key(regular, coverage, includeGrid));
+        CHECK(regularKey.isException == false);
+        CHECK(exceptionKey.isException);
+        CHECK(!(regularKey == exceptionKey));
+
+        std::unordered_map<PatternContentsKey, bool, PatternContentsKeyHash> contents;
+        contents.emplace(regularKey, false);
+        contents.emplace(exceptionKey, true);
+        REQUIRE(contents.size() == 2);
+        CHECK(contents.at(regularKey) == false);
+        CHECK(contents.at(exceptionKey) == true);
+    }
+
+    // the same file used as a raster is a different pattern
+    const auto raster = SpatialPatternSource::create_from_raster(path, id, id, false);
+    CHECK(!(pattern_contents_key(raster, coverage, true) == pattern_contents_key(regular, coverage, true)));
+}
+
+TEST_CASE("Spatial pattern filename identification")
+{
+    {
+        const auto info = identify_pattern_filename(PatternFileType::Cams, "CAMS_emissions_REG-APv5.1_2016_co_B_Industry");
+        REQUIRE(info.has_value());
+        CHECK(info->pollutant == "co");
+        CHECK(info->sector == "B_Industry");
+    }
+
+    {
+        const auto info = identify_pattern_filename(PatternFileType::Ceip, "BaP_A_PublicPower_2017_GRID_2015");
+        REQUIRE(info.has_value());
+        CHECK(info->pollutant == "BaP");
+        CHECK(info->sector == "A_PublicPower");
+    }
+
+    {
+        const auto info = identify_pattern_filename(PatternFileType::FlandersTable, "Emissies per km2 excl puntbrongegevens_2000_NOx");
+        REQUIRE(info.has_value());
+        CHECK(info->pollutant == "NOx");
+        CHECK(info->sector.empty());
+    }
+
+    CHECK_FALSE(identify_pattern_filename(PatternFileType::Cams, "BaP_A_PublicPower_2017_GRID_2015").has_value());
+    CHECK_FALSE(identify_pattern_filename(PatternFileType::Ceip, "CAMS_emissions_REG-APv5.1_2016_co_B_Industry").has_value());
+}
+
+static void check_same_listing(const std::vector<PatternFilenameInfo>& actual, const std::vector<PatternFilenameInfo>& expected)
+{
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        CHECK(actual[i].filename == expected[i].filename);
+        CHECK(actual[i].pollutant == expected[i].pollutant);
+        CHECK(actual[i].sector == expected[i].sector);
+    }
+}
+
+TEST_CASE("Spatial pattern manifest")
+{
+    const auto manifestPath = file::u8path("./out") / "cache" / "spatial_patterns.manifest";
+    fs::remove(manifestPath);
+
+    auto tempManifestPath = manifestPath;
+    tempManifestPath += ".tmp";
+
+    SUBCASE("Cached listings match a directory scan")
+    {
+        // nfr and gnfr sector names, flanders tables with both filename forms
+        const auto camsDir     = file::u8path(TEST_DATA_DIR) / "spatialinventory" / "rest" / "reporting_2021" / "CAMS" / "2016";
+        const auto flandersDir = file::u8path(TEST_DATA_DIR) / "spatialinventory" / "bef" / "reporting_2021" / "2019";
+
+        std::vector<PatternFilenameInfo> scannedCams, scannedFlanders;
+        {
+            SpatialPatternManifest manifest(manifestPath);
+            scannedCams     = manifest.list_directory(camsDir, PatternFileType::Cams);
+            scannedFlanders = manifest.list_directory(flandersDir, PatternFileType::FlandersTable);
+            manifest.save();
+        }
+
+        REQUIRE(fs::exists(manifestPath));
+        CHECK_FALSE(fs::exists(tempManifestPath));
+
+        CHECK(std::any_of(scannedCams.begin(), scannedCams.end(), [](const PatternFilenameInfo& info) {
+            return info.pollutant == "pm2_5" && info.sector == "5C2";
+        }));
+        CHECK(std::any_of(scannedFlanders.begin(), scannedFlanders.end(), [](const PatternFilenameInfo& info) {
+            return info.filename == "Emissie per km2_met NFR_As 2019_juli 2021.xlsx" && info.pollutant == "As";
+        }));
+
+        SpatialPatternManifest manifest(manifestPath);
+        check_same_listing(manifest.list_directory(camsDir, PatternFileType::Cams), scannedCams);
+        check_same_listing(manifest.list_directory(flandersDir, PatternFileType::FlandersTable), scannedFlanders);
+    }
+
+    SUBCASE("Listing is updated when the directory changes")
+    {
+        TempDir temp("patternmanifest");
+        const auto patternDir = temp.path() / "CAMS";
+        fs::create_directories(patternDir);
+        file::write_as_text(patternDir / "CAMS_emissions_REG-APv5.1_2016_co_B_Industry.tif", "");
+
+        {
+            SpatialPatternManifest manifest(manifestPath);
+            CHECK(manifest.list_directory(patternDir, PatternFileType::Cams).size() == 1);
+            manifest.save();
+        }
+
+        // a listing that is still valid is not written again
+        {
+            SpatialPatternManifest manifest(manifestPath);
+            fs::remove(manifestPath);
+            CHECK(manifest.list_directory(patternDir, PatternFileType::Cams).size() == 1);
+            manifest.save();
+            CHECK_FALSE(fs::exists(manifestPath));
+        }
+
+        SUBCASE("File added")
+        {
+            {
+                SpatialPatternManifest manifest(manifestPath);
+                manifest.list_directory(patternDir, PatternFileType::Cams);
+                manifest.save();
+            }
+
+            file::write_as_text(patternDir / "CAMS_emissions_REG-APv5.1_2016_pm2_5_5C2.tif", "");
+
+            SpatialPatternManifest manifest(manifestPath);
+            const auto files = manifest.list_directory(patternDir, PatternFileType::Cams);
+            REQUIRE(files.size() == 2);
+            CHECK(std::any_of(files.begin(), files.end(), [](const PatternFilenameInfo& info) {
+                return info.pollutant == "pm2_5" && info.sector == "5C2";
+            }));
+        }
+
+        SUBCASE("Modification time changed")
+        {
+            {
+                SpatialPatternManifest manifest(manifestPath);
+                manifest.list_directory(patternDir, PatternFileType::Cams);
+                manifest.save();
+            }
+
+            fs::last_write_time(patternDir, fs::last_write_time(patternDir) + std::chrono::hours(1));
+
+            // the directory is scanned again, so the updated listing is written
+            SpatialPatternManifest manifest(manifestPath);
+            fs::remove(manifestPath);
+            CHECK(manifest.list_directory(patternDir, PatternFileType::Cams).size() == 1);
+            manifest.save();
+            CHECK(fs::exists(manifestPath));
+        }
+    }
+}
+
+TEST_CASE("Spatial pattern manifest pattern selection")
+{
+    const auto parametersPath = file::u8path(TEST_DATA_DIR) / "_input" / "05_model_parameters";
+    CountryInventory countryInventory(std::vector<Country>({countries::NL, countries::BEF}));
+    const auto sectorInventory    = parse_sectors(parametersPath / "id_nummers.xlsx", parametersPath / "code_conversions.xlsx", parametersPath / "names_to_be_ignored.xlsx", countryInventory);
+    const auto pollutantInventory = parse_pollutants(parametersPath / "id_nummers.xlsx", parametersPath / "code_conversions.xlsx", parametersPath / "names_to_be_ignored.xlsx", countryInventory);
+
+    auto exceptionsPath = file::u8path(TEST_DATA_DIR) / "spatialinventory" / "exceptions_spatial_disaggregation.xlsx";
+    auto cfg            = create_config(sectorInventory, pollutantInventory, countryInventory, exceptionsPath);
+
+    auto grid60km = grid_data(GridDefinition::Vlops60km);
+    auto grid1km  = grid_data(GridDefinition::Vlops1km);
+    CountryBorders borders60km(file::u8path(TEST_DATA_DIR) / "_input" / "03_spatial_disaggregation" / "boundaries" / "boundaries.gpkg", "Code3", grid60km.meta, countryInventory);
+    CountryBorders borders1km(file::u8path(TEST_DATA_DIR) / "_input" / "03_spatial_disaggregation" / "boundaries" / "boundaries.gpkg", "Code3", grid1km.meta, countryInventory);
+    const auto coverage60km = borders60km.create_country_coverages(grid60km.meta, CoverageMode::AllCountryCells, nullptr);
+    const auto coverage1km  = borders1km.create_country_coverages(grid1km.meta, CoverageMode::AllCountryCells, nullptr);
+
+    const auto& nlCoverage  = inf::find_in_container_required(coverage60km, [](auto& cov) { return cov.country == countries::NL; });
+    const auto& befCoverage = inf::find_in_container_required(coverage1km, [](auto& cov) { return cov.country == countries::BEF; });
+
+    const auto manifestPath = file::u8path("./out") / "cache" / "spatial_patterns_selection.manifest";
+    fs::remove(manifestPath);
+
+    SpatialPatternInventory scanned(cfg);
+    scanned.scan_dir(2021_y, 2016_y, file::u8path(TEST_DATA_DIR) / "spatialinventory");
+
+    // the first inventory creates the manifest, the second one uses the cached listings
+    SpatialPatternInventory created(cfg);
+    created.scan_dir(2021_y, 2016_y, file::u8path(TEST_DATA_DIR) / "spatialinventory", manifestPath);
+    REQUIRE(fs::exists(manifestPath));
+
+    SpatialPatternInventory cached(cfg);
+    cached.scan_dir(2021_y, 2016_y, file::u8path(TEST_DATA_DIR) / "spatialinventory", manifestPath);
+
+    auto checkSameSource = [&](const EmissionIdentifier& id, const CountryCellCoverage& coverage, const fs::path& expectedPath) {
+        const auto expected = scanned.get_spatial_pattern(id, coverage);
+        CHECK(expected.source.path == expectedPath);
+
+        for (auto* inv : {&created, &cached}) {
+            const auto sp = inv->get_spatial_pattern(id, coverage);
+            CHECK(sp.source.path == expected.source.path);
+            CHECK(sp.source.type == expected.source.type);
+            CHECK(sp.source.year == expected.source.year);
+            CHECK(sp.source.emissionId == expected.source.emissionId);
+            CHECK(sp.source.usedEmissionId == expected.source.usedEmissionId);
+        }
+    };
+
+    // nfr sector in the filename
+    checkSameSource(EmissionIdentifier(countries::NL, EmissionSector(sectors::nfr::Nfr5C2), pollutants::PM2_5),
+                    nlCoverage,
+                    file::u8path(TEST_DATA_DIR) / "spatialinventory" / "rest" / "reporting_2021" / "CAMS" / "2016" / "CAMS_emissions_REG-APv5.1_2016_pm2_5_5C2.tif");
+
+    // flanders table with the 'Emissie per km2_met NFR' filename form
+    checkSameSource(EmissionIdentifier(countries::BEF, EmissionSector(sectors::nfr::Nfr1A2a), pollutants::As),
+                    befCoverage,
+                    file::u8path(TEST_DATA_DIR) / "spatialinventory" / "bef" / "reporting_2021" / "2019" / "Emissie per km2_met NFR_As 2019_juli 2021.xlsx");
+}
 }
@@ -0,0 +1,114 @@
+#include "xlsxreader.h"
+
+#include "infra/exception.h"
+
+#include "testconfig.h"
+
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+
+namespace emap::test {
+
+using namespace inf;
+using namespace doctest;
+
+TEST_CASE("Xlsx reader")
+{
+    const xl::WorkBookReader workbook(file::u8path(TEST_DATA_DIR) / "xlsxreader.xlsx");
+
+    SUBCASE("Sheet names")
+    {
+        CHECK(workbook.sheet_names() == std::vector<std::string>{"Values", "Second Sheet"});
+    }
+
+    SUBCASE("Cell values")
+    {
+        std::vector<int32_t> rowNumbers;
+        workbook.read_sheet(
+            "Values",
+            [](const xl::Row& header) {
+                CHECK(header.row_number() == 1);
+                REQUIRE(header.column_count() == 3);
+                CHECK(header.as_string_view(0) == "name");    // shared string
+                CHECK(header.as_string_view(1) == "value");   // shared string
+                CHECK(header.as_string_view(2) == "comment"); // inline string
+
+                CHECK(xl::column_index(header, "VALUE") == 1);
+                CHECK(xl::column_index(header, "missing") == -1);
+                CHECK_THROWS_AS(xl::required_column_index(header, "missing"), RuntimeError);
+            },
+            [&](const xl::Row& row) {
+                rowNumbers.push_back(row.row_number());
+
+                switch (row.row_number()) {
+                case 2:
+                    CHECK(row.as_string_view(0) == "first");
+                    CHECK(row.as_double(1) == 1.5);
+                    CHECK(xl::required_double(row, 1) == 1.5);
+                    CHECK(row.as_string_view(2) == "inline text");
+                    CHECK(!row.as_double(2).has_value());
+                    break;
+                case 3:
+                    // rich text shared string consisting of multiple runs
+                    CHECK(row.as_string_view(0) == "rich text");
+                    CHECK(row.as_int(1) == 42);
+                    CHECK(xl::required_int(row, 1) == 42);
+                    // C3 has no value and D3 is not present in the sheet
+                    CHECK(row.column_count() == 5);
+                    CHECK(row.is_empty(2));
+                    CHECK(row.is_empty(3));
+                    CHECK(row.as_int(4) == 7);
+                    // out of range columns are empty
+                    CHECK(row.is_empty(10));
+                    CHECK(!row.as_double(10).has_value());
+                    break;
+                case 5:
+                    CHECK(row.as_string_view(1) == "n/a");
+                    CHECK_THROWS_WITH_AS(xl::required_double(row, 1), "Invalid number on row 5, column B: 'n/a'", RuntimeError);
+                    CHECK_THROWS_WITH_AS(xl::required_int(row, 2), "Invalid number on row 5, column C: ''", RuntimeError);
+                    break;
+                default:
+                    FAIL("Unexpected row " << row.row_number());
+                }
+            });
+
+        // the empty row 4 is not present in the sheet
+        CHECK(rowNumbers == std::vector<int32_t>{2, 3, 5});
+    }
+
+    SUBCASE("Sheet lookup")
+    {
+        int32_t rowCount = 0;
+        auto countRows   = [&](const xl::Row& row) {
+            ++rowCount;
+            CHECK(row.as_int(0) == 1);
+        };
+
+        // exact name, case insensitive name and index
+        workbook.read_sheet("Second Sheet", countRows);
+        workbook.read_sheet("second sheet", countRows);
+        workbook.read_sheet(1, countRows);
+        CHECK(rowCount == 3);
+
+        CHECK_THROWS_AS(workbook.read_sheet("Third Sheet", countRows), RuntimeError);
+        CHECK_THROWS_AS(workbook.read_sheet(2, countRows), RuntimeError);
+    }
+
+    SUBCASE("Column names")
+    {
+        CHECK(xl::column_name(0) == "A");
+        CHECK(xl::column_name(25) == "Z");
+        CHECK(xl::column_name(26) == "AA");
+        CHECK(xl::column_name(27) == "AB");
+        CHECK(xl::column_name(701) == "ZZ");
+        CHECK(xl::column_name(702) == "AAA");
+    }
+}
+
+TEST_CASE("Xlsx reader missing workbook")
+{
+    CHECK_THROWS_AS(xl::WorkBookReader(file::u8path(TEST_DATA_DIR) / "does_not_exist.xlsx"), RuntimeError);
+}
+
+}
@@ -1,7 +1,8 @@
 #include "vlopsoutputbuilder.h"
 
 #include "emap/constants.h"
-#include "emap/emissions.h"
+#include "emap/pointsourcetable.h"
+#include "emap/sparseraster.h"
 #include "infra/cast.h"
 #include "infra/log.h"
 #include "outputwriters.h"
@@ -33,7 +34,7 @@ static std::string_view vlops_pollutant_name(const Pollutant& pol)
     return pol.code().substr(0, 5);
 }
 
-void VlopsOutputBuilder::add_point_output_entry(const EmissionEntry& emission)
+void VlopsOutputBuilder::add_point_output_entry(const PointSourceRow& emission)
 {
     assert(emission.coordinate().has_value());
     assert(emission.value().amount().has_value());
@@ -76,6 +77,29 @@ void VlopsOutputBuilder::add_diffuse_output_entry(const EmissionIdentifier& id,
     current.cellSize = cellSizeInM;
 }
 
+void VlopsOutputBuilder::add_diffuse_output_entries(const EmissionIdentifier& id, const SparseRaster& emissions)
+{
+    assert(id.sector.type() == EmissionSector::Type::Nfr);
+    const auto& meta            = emissions.metadata();
+    const auto cellSizeInM      = truncate<int32_t>(meta.cell_size_x());
+    const auto mappedSectorName = _cfg.sectors().map_nfr_to_output_name(id.sector.nfr_sector());
+
+    std::scoped_lock lock(_mutex);
+    auto& locationData = _diffuseSources[id.pollutant][mappedSectorName][id.country.id()];
+    locationData.reserve(locationData.size() + emissions.size());
+
+    for (size_t i = 0; i < emissions.size(); ++i) {
+        if (emissions.value(i) == 0.0) {
+            continue;
+        }
+
+        const auto cellCenter = meta.convert_cell_centre_to_xy(emissions.cell(i));
+        auto& current         = locationData[Point<double>(cellCenter.x, cellCenter.y)];
+        current.value += emissions.value(i);
+        current.cellSize = cellSizeInM;
+    }
+}
+
 static fs::path create_vlops_output_name(const Pollutant& pol, date::year year, std::string_view suffix)
 {
     auto filename = fmt::format("{}_OPS_{}", pol.code(), static_cast<int32_t>(year));
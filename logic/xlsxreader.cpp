@@ -0,0 +1,592 @@
+#include "xlsxreader.h"
+
+#include "infra/exception.h"
+#include "infra/string.h"
+
+#include <algorithm>
+#include <cpl_vsi.h>
+#include <exception>
+#include <expat.h>
+#include <unordered_map>
+
+namespace emap {
+namespace xl {
+
+using namespace inf;
+
+// strips the namespace prefix of element and attribute names (e.g. x:row -> row)
+static std::string_view local_name(const XML_Char* name) noexcept
+{
+    std::string_view str(name);
+    if (auto pos = str.find_last_of(':'); pos != std::string_view::npos) {
+        return str.substr(pos + 1);
+    }
+
+    return str;
+}
+
+static std::string_view attribute_value(const XML_Char** attrs, std::string_view name) noexcept
+{
+    for (int i = 0; attrs[i] != nullptr; i += 2) {
+        if (local_name(attrs[i]) == name) {
+            return attrs[i + 1];
+        }
+    }
+
+    return {};
+}
+
+// Converts the column part of a cell reference to a 0-based column index (e.g. AB12 -> 27)
+static int32_t column_from_reference(std::string_view ref) noexcept
+{
+    int32_t col = 0;
+    for (auto c : ref) {
+        if (c < 'A' || c > 'Z') {
+            break;
+        }
+
+        col = col * 26 + (c - 'A' + 1);
+    }
+
+    return col - 1;
+}
+
+class XmlHandler
+{
+public:
+    virtual ~XmlHandler() = default;
+
+    virtual void start_element(std::string_view name, const XML_Char** attrs) = 0;
+    virtual void end_element(std::string_view name)                           = 0;
+    virtual void character_data(std::string_view /*data*/)
+    {
+    }
+};
+
+struct XmlParseContext
+{
+    XML_Parser parser = nullptr;
+    XmlHandler* handler = nullptr;
+    // exceptions are not allowed to propagate through the expat c code, they are rethrown after parsing
+    std::exception_ptr error;
+};
+
+static void XMLCALL on_start_element(void* userData, const XML_Char* name, const XML_Char** attrs)
+{
+    auto* ctx = static_cast<XmlParseContext*>(userData);
+    try {
+        ctx->handler->start_element(local_name(name), attrs);
+    } catch (...) {
+        ctx->error = std::current_exception();
+        XML_StopParser(ctx->parser, XML_FALSE);
+    }
+}
+
+static void XMLCALL on_end_element(void* userData, const XML_Char* name)
+{
+    auto* ctx = static_cast<XmlParseContext*>(userData);
+    try {
+        ctx->handler->end_element(local_name(name));
+    } catch (...) {
+        ctx->error = std::current_exception();
+        XML_StopParser(ctx->parser, XML_FALSE);
+    }
+}
+
+static void XMLCALL on_character_data(void* userData, const XML_Char* data, int length)
+{
+    auto* ctx = static_cast<XmlParseContext*>(userData);
+    try {
+        ctx->handler->character_data(std::string_view(data, length));
+    } catch (...) {
+        ctx->error = std::current_exception();
+        XML_StopParser(ctx->parser, XML_FALSE);
+    }
+}
+
+/* Streams the xml entry from the xlsx archive through the handler, returns false if the entry is not present */
+static bool parse_archive_entry(const fs::path& archive, std::string_view entry, XmlHandler& handler)
+{
+    const auto vsiPath = fmt::format("/vsizip/{{{}}}/{}", str::from_u8(archive.generic_u8string()), entry);
+
+    VSILFILE* fp = VSIFOpenL(vsiPath.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+
+    XmlParseContext ctx;
+    ctx.handler = &handler;
+    ctx.parser  = XML_ParserCreate(nullptr);
+    if (ctx.parser == nullptr) {
+        VSIFCloseL(fp);
+        throw RuntimeError("Failed to create xml parser");
+    }
+
+    XML_SetUserData(ctx.parser, &ctx);
+    XML_SetElementHandler(ctx.parser, on_start_element, on_end_element);
+    XML_SetCharacterDataHandler(ctx.parser, on_character_data);
+
+    constexpr int bufferSize = 256 * 1024;
+
+    std::string errorMsg;
+    for (;;) {
+        auto* buffer = XML_GetBuffer(ctx.parser, bufferSize);
+        if (buffer == nullptr) {
+            errorMsg = "out of memory";
+            break;
+        }
+
+        const auto bytesRead = static_cast<int>(VSIFReadL(buffer, 1, bufferSize, fp));
+        const bool lastChunk = bytesRead < bufferSize;
+        if (XML_ParseBuffer(ctx.parser, bytesRead, lastChunk ? XML_TRUE : XML_FALSE) == XML_STATUS_ERROR) {
+            if (!ctx.error) {
+                errorMsg = fmt::format("{} (line {})", XML_ErrorString(XML_GetErrorCode(ctx.parser)), XML_GetCurrentLineNumber(ctx.parser));
+            }
+            break;
+        }
+
+        if (lastChunk) {
+            break;
+        }
+    }
+
+    XML_ParserFree(ctx.parser);
+    VSIFCloseL(fp);
+
+    if (ctx.error) {
+        std::rethrow_exception(ctx.error);
+    }
+
+    if (!errorMsg.empty()) {
+        throw RuntimeError("Failed to parse {} in {}: {}", entry, archive, errorMsg);
+    }
+
+    return true;
+}
+
+class SharedStringsParser : public XmlHandler
+{
+public:
+    void start_element(std::string_view name, const XML_Char** /*attrs*/) override
+    {
+        if (name == "si") {
+            _current.clear();
+        } else if (name == "rPh") {
+            // phonetic hints are not part of the cell text
+            _inPhonetic = true;
+        } else if (name == "t" && !_inPhonetic) {
+            _inText = true;
+        }
+    }
+
+    void end_element(std::string_view name) override
+    {
+        if (name == "si") {
+            strings.push_back(std::move(_current));
+            _current = std::string();
+        } else if (name == "rPh") {
+            _inPhonetic = false;
+        } else if (name == "t") {
+            _inText = false;
+        }
+    }
+
+    void character_data(std::string_view data) override
+    {
+        if (_inText) {
+            _current.append(data);
+        }
+    }
+
+    std::vector<std::string> strings;
+
+private:
+    std::string _current;
+    bool _inText     = false;
+    bool _inPhonetic = false;
+};
+
+class WorkbookParser : public XmlHandler
+{
+public:
+    void start_element(std::string_view name, const XML_Char** attrs) override
+    {
+        if (name == "sheet") {
+            sheets.emplace_back(attribute_value(attrs, "name"), attribute_value(attrs, "id"));
+        }
+    }
+
+    void end_element(std::string_view /*name*/) override
+    {
+    }
+
+    // sheet name, relationship id
+    std::vector<std::pair<std::string, std::string>> sheets;
+};
+
+class RelationshipsParser : public XmlHandler
+{
+public:
+    void start_element(std::string_view name, const XML_Char** attrs) override
+    {
+        if (name == "Relationship") {
+            targets.emplace(attribute_value(attrs, "Id"), attribute_value(attrs, "Target"));
+        }
+    }
+
+    void end_element(std::string_view /*name*/) override
+    {
+    }
+
+    std::unordered_map<std::string, std::string> targets;
+};
+
+class SheetParser : public XmlHandler
+{
+public:
+    SheetParser(const std::vector<std::string>& sharedStrings, const std::function<void(const Row&)>& rowCb)
+    : _sharedStrings(sharedStrings)
+    , _rowCb(rowCb)
+    {
+    }
+
+    void start_element(std::string_view name, const XML_Char** attrs) override
+    {
+        if (name == "row") {
+            auto rowNr = str::to_int32(attribute_value(attrs, "r"));
+            _row._rowNr = rowNr.value_or(_row._rowNr + 1);
+            _lastCol    = -1;
+            _buffer.clear();
+            _cells.clear();
+        } else if (name == "c") {
+            if (auto ref = attribute_value(attrs, "r"); !ref.empty()) {
+                _lastCol = column_from_reference(ref);
+            } else {
+                ++_lastCol;
+            }
+
+            _cellType     = cell_type(attribute_value(attrs, "t"));
+            _cellStart    = _buffer.size();
+            _cellHasValue = false;
+        } else if (name == "v") {
+            _collect = true;
+        } else if (name == "is") {
+            _inInlineString = true;
+        } else if (name == "rPh") {
+            _inPhonetic = true;
+        } else if (name == "t" && _inInlineString && !_inPhonetic) {
+            _collect = true;
+        }
+    }
+
+    void end_element(std::string_view name) override
+    {
+        if (name == "v" || (name == "t" && _collect)) {
+            _collect      = false;
+            _cellHasValue = true;
+        } else if (name == "is") {
+            _inInlineString = false;
+        } else if (name == "rPh") {
+            _inPhonetic = false;
+        } else if (name == "c") {
+            end_cell();
+        } else if (name == "row") {
+            end_row();
+        }
+    }
+
+    void character_data(std::string_view data) override
+    {
+        if (_collect) {
+            _buffer.append(data);
+        }
+    }
+
+private:
+    enum class CellType
+    {
+        Value,
+        SharedString,
+        Error,
+    };
+
+    struct CellRef
+    {
+        int32_t col = 0;
+        const std::string* sharedString = nullptr;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    static CellType cell_type(std::string_view type) noexcept
+    {
+        if (type == "s") {
+            return CellType::SharedString;
+        } else if (type == "e") {
+            return CellType::Error;
+        }
+
+        // numbers, booleans, inline and formula strings are all stored as text in the cell
+        return CellType::Value;
+    }
+
+    void end_cell()
+    {
+        if (!_cellHasValue || _lastCol < 0) {
+            return;
+        }
+
+        CellRef ref;
+        ref.col = _lastCol;
+
+        switch (_cellType) {
+        case CellType::SharedString: {
+            const auto index = str::to_int32(std::string_view(_buffer).substr(_cellStart));
+            _buffer.resize(_cellStart);
+            if (!index.has_value() || *index < 0 || *index >= int32_t(_sharedStrings.size())) {
+                throw RuntimeError("Invalid shared string reference on row {}", _row._rowNr);
+            }
+            ref.sharedString = &_sharedStrings[*index];
+            break;
+        }
+        case CellType::Error:
+            // error values are treated as empty cells
+            _buffer.resize(_cellStart);
+            return;
+        case CellType::Value:
+            ref.offset = _cellStart;
+            ref.length = _buffer.size() - _cellStart;
+            break;
+        }
+
+        _cells.push_back(ref);
+    }
+
+    void end_row()
+    {
+        // the row buffer is complete, so the string views can be created safely
+        int32_t columnCount = 0;
+        for (auto& ref : _cells) {
+            columnCount = std::max(columnCount, ref.col + 1);
+        }
+
+        _row._cells.assign(columnCount, std::string_view());
+        for (auto& ref : _cells) {
+            if (ref.sharedString != nullptr) {
+                _row._cells[ref.col] = *ref.sharedString;
+            } else {
+                _row._cells[ref.col] = std::string_view(_buffer).substr(ref.offset, ref.length);
+            }
+        }
+
+        _rowCb(_row);
+    }
+
+    const std::vector<std::string>& _sharedStrings;
+    const std::function<void(const Row&)>& _rowCb;
+
+    Row _row;
+    std::string _buffer;
+    std::vector<CellRef> _cells;
+    int32_t _lastCol     = -1;
+    CellType _cellType   = CellType::Value;
+    size_t _cellStart    = 0;
+    bool _cellHasValue   = false;
+    bool _collect        = false;
+    bool _inInlineString = false;
+    bool _inPhonetic     = false;
+};
+
+int32_t Row::row_number() const noexcept
+{
+    return _rowNr;
+}
+
+int32_t Row::column_count() const noexcept
+{
+    return int32_t(_cells.size());
+}
+
+bool Row::is_empty(int32_t col) const noexcept
+{
+    return as_string_view(col).empty();
+}
+
+std::string_view Row::as_string_view(int32_t col) const noexcept
+{
+    if (col < 0 || col >= column_count()) {
+        return {};
+    }
+
+    return _cells[col];
+}
+
+std::optional<double> Row::as_double(int32_t col) const noexcept
+{
+    return str::to_double(str::trimmed_view(as_string_view(col)));
+}
+
+std::optional<int32_t> Row::as_int(int32_t col) const noexcept
+{
+    if (auto value = as_double(col); value.has_value()) {
+        return static_cast<int32_t>(*value);
+    }
+
+    return {};
+}
+
+WorkBookReader::WorkBookReader(const fs::path& path)
+: _path(path)
+{
+    if (!fs::is_regular_file(path)) {
+        throw RuntimeError("Workbook does not exist: {}", path);
+    }
+
+    WorkbookParser workbook;
+    if (!parse_archive_entry(path, "xl/workbook.xml", workbook)) {
+        throw RuntimeError("Invalid xlsx file, no workbook present: {}", path);
+    }
+
+    RelationshipsParser relationships;
+    parse_archive_entry(path, "xl/_rels/workbook.xml.rels", relationships);
+
+    for (auto& [name, relId] : workbook.sheets) {
+        auto iter = relationships.targets.find(relId);
+        if (iter == relationships.targets.end()) {
+            throw RuntimeError("Invalid xlsx file, no sheet data for sheet '{}': {}", name, path);
+        }
+
+        std::string_view target = iter->second;
+        _sheetNames.push_back(name);
+        if (str::starts_with(target, "/")) {
+            // absolute path in the archive
+            _sheetEntries.emplace_back(target.substr(1));
+        } else {
+            _sheetEntries.push_back("xl/" + iter->second);
+        }
+    }
+
+    // workbooks without any text cells do not contain shared strings
+    SharedStringsParser sharedStrings;
+    parse_archive_entry(path, "xl/sharedStrings.xml", sharedStrings);
+    _sharedStrings = std::move(sharedStrings.strings);
+}
+
+const std::vector<std::string>& WorkBookReader::sheet_names() const noexcept
+{
+    return _sheetNames;
+}
+
+void WorkBookReader::read_sheet(int32_t index, const std::function<void(const Row&)>& rowCb) const
+{
+    if (index < 0 || index >= int32_t(_sheetEntries.size())) {
+        throw RuntimeError("Invalid sheet index {} for {}", index, _path);
+    }
+
+    SheetParser parser(_sharedStrings, rowCb);
+    if (!parse_archive_entry(_path, _sheetEntries[index], parser)) {
+        throw RuntimeError("Sheet '{}' not present in {}", _sheetNames[index], _path);
+    }
+}
+
+void WorkBookReader::read_sheet(std::string_view name, const std::function<void(const Row&)>& rowCb) const
+{
+    if (auto index = sheet_index(name); index.has_value()) {
+        read_sheet(*index, rowCb);
+    } else {
+        throw RuntimeError("No sheet named '{}' in {}", name, _path);
+    }
+}
+
+void WorkBookReader::read_sheet(int32_t index, const std::function<void(const Row&)>& headerCb, const std::function<void(const Row&)>& rowCb) const
+{
+    bool headerRead = false;
+    read_sheet(index, [&](const Row& row) {
+        if (!headerRead) {
+            headerRead = true;
+            headerCb(row);
+        } else {
+            rowCb(row);
+        }
+    });
+
+    if (!headerRead) {
+        headerCb(Row());
+    }
+}
+
+void WorkBookReader::read_sheet(std::string_view name, const std::function<void(const Row&)>& headerCb, const std::function<void(const Row&)>& rowCb) const
+{
+    if (auto index = sheet_index(name); index.has_value()) {
+        read_sheet(*index, headerCb, rowCb);
+    } else {
+        throw RuntimeError("No sheet named '{}' in {}", name, _path);
+    }
+}
+
+std::optional<int32_t> WorkBookReader::sheet_index(std::string_view name) const noexcept
+{
+    auto iter = std::find(_sheetNames.begin(), _sheetNames.end(), name);
+    if (iter == _sheetNames.end()) {
+        iter = std::find_if(_sheetNames.begin(), _sheetNames.end(), [name](const std::string& sheetName) {
+            return str::iequals(sheetName, name);
+        });
+    }
+
+    if (iter == _sheetNames.end()) {
+        return {};
+    }
+
+    return int32_t(std::distance(_sheetNames.begin(), iter));
+}
+
+int32_t column_index(const Row& header, std::string_view name) noexcept
+{
+    for (int32_t i = 0; i < header.column_count(); ++i) {
+        if (str::iequals(str::trimmed_view(header.as_string_view(i)), name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+std::string column_name(int32_t col)
+{
+    std::string name;
+    for (++col; col > 0; col = (col - 1) / 26) {
+        name.insert(name.begin(), char('A' + (col - 1) % 26));
+    }
+
+    return name;
+}
+
+int32_t required_column_index(const Row& header, std::string_view name)
+{
+    if (auto index = column_index(header, name); index >= 0) {
+        return index;
+    }
+
+    throw RuntimeError("Missing column '{}'", name);
+}
+
+int32_t required_int(const Row& row, int32_t col)
+{
+    if (auto value = row.as_int(col); value.has_value()) {
+        return *value;
+    }
+
+    throw RuntimeError("Invalid number on row {}, column {}: '{}'", row.row_number(), column_name(col), row.as_string_view(col));
+}
+
+double required_double(const Row& row, int32_t col)
+{
+    if (auto value = row.as_double(col); value.has_value()) {
+        return *value;
+    }
+
+    throw RuntimeError("Invalid number on row {}, column {}: '{}'", row.row_number(), column_name(col), row.as_string_view(col));
+}
+
+}
+}
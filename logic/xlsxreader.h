@@ -0,0 +1,77 @@
+#pragma once
+
+#include "infra/filesystem.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace emap {
+namespace xl {
+
+/* A single worksheet row, only valid for the duration of the row callback */
+class Row
+{
+public:
+    // 1-based row number as used in the sheet
+    int32_t row_number() const noexcept;
+    // Number of columns up to the last non empty cell
+    int32_t column_count() const noexcept;
+
+    bool is_empty(int32_t col) const noexcept;
+
+    // The cell contents as stored in the sheet, numeric cells are not formatted
+    std::string_view as_string_view(int32_t col) const noexcept;
+    std::optional<double> as_double(int32_t col) const noexcept;
+    std::optional<int32_t> as_int(int32_t col) const noexcept;
+
+private:
+    friend class SheetParser;
+
+    int32_t _rowNr = 0;
+    std::vector<std::string_view> _cells;
+};
+
+/* Streaming reader for xlsx workbooks
+ * The sheet xml is processed with a SAX parser, so the sheet contents are never kept in memory as a whole.
+ * Reading sheets is thread safe, different sheets can be processed in parallel */
+class WorkBookReader
+{
+public:
+    explicit WorkBookReader(const fs::path& path);
+
+    const std::vector<std::string>& sheet_names() const noexcept;
+
+    void read_sheet(int32_t index, const std::function<void(const Row&)>& rowCb) const;
+    // Sheet names are matched case insensitive when there is no exact match
+    void read_sheet(std::string_view name, const std::function<void(const Row&)>& rowCb) const;
+
+    // The first row of the sheet contains the column headers, the header callback is invoked once before the other rows are passed to the row callback
+    // For an empty sheet the header callback is invoked with an empty row
+    void read_sheet(int32_t index, const std::function<void(const Row&)>& headerCb, const std::function<void(const Row&)>& rowCb) const;
+    void read_sheet(std::string_view name, const std::function<void(const Row&)>& headerCb, const std::function<void(const Row&)>& rowCb) const;
+
+private:
+    std::optional<int32_t> sheet_index(std::string_view name) const noexcept;
+
+    fs::path _path;
+    std::vector<std::string> _sheetNames;
+    std::vector<std::string> _sheetEntries;
+    std::vector<std::string> _sharedStrings;
+};
+
+// Column index in the header row, matches case insensitive, returns -1 when not present
+int32_t column_index(const Row& header, std::string_view name) noexcept;
+int32_t required_column_index(const Row& header, std::string_view name);
+// Column name as shown in the sheet for a 0-based column index (e.g. 27 -> AB)
+std::string column_name(int32_t col);
+
+// Cell values that have to be present, throw when the cell does not contain a number, the error mentions the row and column
+int32_t required_int(const Row& row, int32_t col);
+double required_double(const Row& row, int32_t col);
+
+}
+}